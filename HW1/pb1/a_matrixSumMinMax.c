@@ -5,7 +5,8 @@
              and prints them to the standard output
 
    usage under Linux:
-gcc -o SumMinMax a_matrixSumMinMax.c -lpthread && ./SumMinMax 9 3
+gcc -o SumMinMax a_matrixSumMinMax.c ../../lib/topology.c -lpthread && ./SumMinMax 9 3
+   AFFINITY=compact|scatter|core|numa pins the workers (lib/topology.h)
 
 */
 #ifndef _REENTRANT 
@@ -17,6 +18,7 @@ gcc -o SumMinMax a_matrixSumMinMax.c -lpthread && ./SumMinMax 9 3
 #include <stdbool.h>
 #include <time.h>
 #include <sys/time.h>
+#include "../../lib/topology.h"
 #include <limits.h> // for INT_MAX and INT_MIN
 
 #define MAXSIZE 10000  /* maximum matrix size */
@@ -158,6 +160,7 @@ void *Worker(void *arg) {
   int strip_max_row, strip_max_col; 
 
   printf("\nWorker %ld (pthread id %ld) has started\n", myid, pthread_self());
+  topo_pin(TOPO_DEFAULT, (int)myid, NULL);
 
   /*start printing strip matrix of this worker */
   printf("[");
@@ -5,7 +5,8 @@
              and prints them to the standard output
 
    usage under Linux:
-gcc -o noBarriersNoArray b_noBarriersNoArray.c -lpthread && ./noBarriersNoArray 9 3
+gcc -o noBarriersNoArray b_noBarriersNoArray.c ../../lib/topology.c -lpthread && ./noBarriersNoArray 9 3
+   AFFINITY=compact|scatter|core|numa pins the workers (lib/topology.h)
 
 */
 #ifndef _REENTRANT 
@@ -17,6 +18,7 @@ gcc -o noBarriersNoArray b_noBarriersNoArray.c -lpthread && ./noBarriersNoArray
 #include <stdbool.h>
 #include <time.h>
 #include <sys/time.h>
+#include "../../lib/topology.h"
 #include <limits.h> // for INT_MAX and INT_MIN
 
 #define MAXSIZE 10000  /* maximum matrix size */
@@ -162,6 +164,7 @@ void *Worker(void *arg) {
     int my_max_row = 0, my_max_col = 0;
     int i, j, first, last;
 
+    topo_pin(TOPO_DEFAULT, (int)myid, NULL);
     printf("\nWorker %ld (pthread id %ld) has started\n", myid, pthread_self());
 
     /* determine first and last rows of my strip */
@@ -5,7 +5,8 @@
              and prints them to the standard output
 
    usage under Linux:
-    gcc -o bagOfTasks c_bagOfTasks.c -lpthread && ./bagOfTasks 9 3
+    gcc -o bagOfTasks c_bagOfTasks.c ../../lib/topology.c -lpthread && ./bagOfTasks 9 3
+    AFFINITY=compact|scatter|core|numa pins the workers (lib/topology.h)
 
 */
 #ifndef _REENTRANT 
@@ -17,6 +18,7 @@
 #include <stdbool.h>
 #include <time.h>
 #include <sys/time.h>
+#include "../../lib/topology.h"
 #include <limits.h> // for INT_MAX and INT_MIN
 
 #define MAXSIZE 10000  /* maximum matrix size */
@@ -155,6 +157,7 @@ void *Worker(void *arg) {
     long myid = (long) arg;
 
     printf("\nWorker %ld (pthread id %ld) has started\n", myid, pthread_self());
+    topo_pin(TOPO_DEFAULT, (int)myid, NULL);
     while (true){
         int row = __sync_fetch_and_add(&row_counter, 1);
         if (row >= size) {
@@ -0,0 +1,352 @@
+/* cache-blocked parallel integer matrix multiply using pthreads
+
+   features: computes C = A x B with the loop nest of BLIS-style GEMM. B is
+             packed into KC x NC panels of NR-wide slivers that all workers
+             share, each worker packs MC x KC blocks of A into MR-tall
+             slivers, and a MR x NR micro-kernel written with GCC vector
+             extensions keeps the C tile in registers. Rows of C are handed
+             out either as static strips (like matrixSum.c) or from a bag of
+             row blocks (like c_bagOfTasks.c). While the last K panel is
+             stored, every worker also folds its tiles into a partial sum,
+             min and max, so the reduction of C costs no extra sweep.
+             Workers meet at a barrier around every shared B panel.
+             With AFFINITY set (see lib/topology.h) workers are pinned and
+             each clears its own strip of C, so its pages sit on the node
+             of the worker that writes them.
+
+   usage under Linux:
+     gcc -O3 -march=native -o matrixMul matrixMul.c ../../lib/topology.c -lpthread
+     ./matrixMul size numWorkers [strips|bag]
+   it runs once with 1 worker and once with numWorkers and reports GOPS
+   (2 n^3 integer operations) and the scaling efficiency. values are
+   rand()%99 so no entry of C overflows an int below size 200000
+*/
+#ifndef _REENTRANT
+#define _REENTRANT
+#endif
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <limits.h>
+#include "../../lib/topology.h"
+
+#define MAXSIZE 10000  /* maximum matrix size */
+#define MAXWORKERS 64  /* maximum number of workers */
+
+#define MR 6      /* rows of the micro-kernel tile */
+#define NR 16     /* columns of the micro-kernel tile, two 8-int vectors */
+#define MC 96     /* rows of a packed A block, MC x KC ints stay in L2 */
+#define KC 256    /* depth of a panel, a KC x NR sliver of B stays in L1 */
+#define NC 4096   /* columns of a packed B panel, shared through L3 */
+
+typedef int vint __attribute__((vector_size(32)));
+
+/* partial result of the fused reduction */
+typedef struct {
+    long long sum;
+    int min, minRow, minCol;
+    int max, maxRow, maxCol;
+} partial_t;
+
+pthread_mutex_t barrier;  /* mutex lock for the barrier */
+pthread_cond_t go;        /* condition variable for leaving */
+int numArrived = 0;       /* number who have arrived */
+int generation = 0;       /* barrier round, guards against spurious wakeups */
+
+int size, numWorkers;
+bool useBag;
+int *A, *B, *C;
+int *packedB;             /* shared KC x NC panel of B */
+int nextBlock;            /* bag of tasks: next MC row block of the panel */
+partial_t partials[MAXWORKERS];
+
+/* a reusable counter barrier */
+void Barrier() {
+    pthread_mutex_lock(&barrier);
+    int myGeneration = generation;
+    numArrived++;
+    if (numArrived == numWorkers) {
+        numArrived = 0;
+        generation++;
+        pthread_cond_broadcast(&go);
+    } else {
+        while (myGeneration == generation)
+            pthread_cond_wait(&go, &barrier);
+    }
+    pthread_mutex_unlock(&barrier);
+}
+
+/* timer */
+double read_timer() {
+    static bool initialized = false;
+    static struct timeval start;
+    struct timeval end;
+    if( !initialized )
+    {
+        gettimeofday( &start, NULL );
+        initialized = true;
+    }
+    gettimeofday( &end, NULL );
+    return (end.tv_sec - start.tv_sec) + 1.0e-6 * (end.tv_usec - start.tv_usec);
+}
+
+/* ties keep the first position in row-major order */
+bool before(int r1, int c1, int r2, int c2) {
+    return r1 < r2 || (r1 == r2 && c1 < c2);
+}
+void partialInit(partial_t *p) {
+    p->sum = 0;
+    p->min = INT_MAX; p->minRow = INT_MAX; p->minCol = INT_MAX;
+    p->max = INT_MIN; p->maxRow = INT_MAX; p->maxCol = INT_MAX;
+}
+void partialMerge(partial_t *into, const partial_t *p) {
+    into->sum += p->sum;
+    if (p->min < into->min || (p->min == into->min && before(p->minRow, p->minCol, into->minRow, into->minCol))) {
+        into->min = p->min; into->minRow = p->minRow; into->minCol = p->minCol;
+    }
+    if (p->max > into->max || (p->max == into->max && before(p->maxRow, p->maxCol, into->maxRow, into->maxCol))) {
+        into->max = p->max; into->maxRow = p->maxRow; into->maxCol = p->maxCol;
+    }
+}
+
+/* PACKING */
+
+/* sliver s of the panel: rows pc..pc+kc of B, columns jc+s*NR..+NR, zero
+   padded past the matrix edge, stored k-major */
+void packBSliver(int s, int pc, int kc, int jc, int nc) {
+    int *dst = packedB + (size_t)s * kc * NR;
+    int col = jc + s * NR;
+    int w = (nc - s * NR < NR) ? nc - s * NR : NR;
+    for (int k = 0; k < kc; k++) {
+        const int *src = B + (size_t)(pc + k) * size + col;
+        int j = 0;
+        for (; j < w; j++) dst[k * NR + j] = src[j];
+        for (; j < NR; j++) dst[k * NR + j] = 0;
+    }
+}
+
+/* rows ic..ic+mc, columns pc..pc+kc of A as MR-tall slivers, k-major */
+void packA(int *dst, int ic, int mc, int pc, int kc) {
+    for (int ir = 0; ir < mc; ir += MR) {
+        int h = (mc - ir < MR) ? mc - ir : MR;
+        for (int k = 0; k < kc; k++) {
+            int i = 0;
+            for (; i < h; i++) dst[k * MR + i] = A[(size_t)(ic + ir + i) * size + pc + k];
+            for (; i < MR; i++) dst[k * MR + i] = 0;
+        }
+        dst += MR * kc;
+    }
+}
+
+/* MICRO-KERNEL */
+
+/* C[row..row+h][col..col+w] += a * b over kc; on the last panel the
+   finished tile is also folded into p */
+void microKernel(int kc, const int *a, const int *b, int row, int col, int h, int w, bool last, partial_t *p) {
+    vint acc[MR][2];
+    memset(acc, 0, sizeof(acc));
+    for (int k = 0; k < kc; k++) {
+        vint b0, b1;
+        memcpy(&b0, b + k * NR, sizeof(vint));
+        memcpy(&b1, b + k * NR + 8, sizeof(vint));
+        for (int i = 0; i < MR; i++) {
+            int ai = a[k * MR + i];
+            acc[i][0] += ai * b0;
+            acc[i][1] += ai * b1;
+        }
+    }
+
+    int tile[MR][NR];
+    memcpy(tile, acc, sizeof(tile));
+    for (int i = 0; i < h; i++) {
+        int *c = C + (size_t)(row + i) * size + col;
+        for (int j = 0; j < w; j++)
+            c[j] += tile[i][j];
+        if (last) {
+            for (int j = 0; j < w; j++) {
+                int val = c[j];
+                p->sum += val;
+                if (val < p->min || (val == p->min && before(row + i, col + j, p->minRow, p->minCol))) {
+                    p->min = val; p->minRow = row + i; p->minCol = col + j;
+                }
+                if (val > p->max || (val == p->max && before(row + i, col + j, p->maxRow, p->maxCol))) {
+                    p->max = val; p->maxRow = row + i; p->maxCol = col + j;
+                }
+            }
+        }
+    }
+}
+
+/* rows ic..ic+mc of C against the packed panel */
+void computeBlock(int *packedA, int ic, int mc, int pc, int kc, int jc, int nc, partial_t *p) {
+    bool last = (pc + kc == size);
+    packA(packedA, ic, mc, pc, kc);
+    for (int jr = 0; jr < nc; jr += NR) {
+        const int *b = packedB + (size_t)(jr / NR) * kc * NR;
+        int w = (nc - jr < NR) ? nc - jr : NR;
+        for (int ir = 0; ir < mc; ir += MR) {
+            int h = (mc - ir < MR) ? mc - ir : MR;
+            microKernel(kc, packedA + (size_t)(ir / MR) * kc * MR, b, ic + ir, jc + jr, h, w, last, p);
+        }
+    }
+}
+
+/* Each worker packs its share of every B panel, waits at the barrier,
+   multiplies its rows of C (a static strip or blocks from the bag) and
+   waits again before the panel is replaced */
+void *Worker(void *arg) {
+    long myid = (long) arg;
+    int *packedA = aligned_alloc(64, MC * KC * sizeof(int));
+    if (packedA == NULL) {
+        /* the others would wait for this worker at the barrier */
+        perror("malloc");
+        exit(1);
+    }
+    partial_t *p = &partials[myid];
+    partialInit(p);
+
+    /* static strip of rows, a multiple of MR so tiles do not straddle */
+    int stripSize = ((size + numWorkers - 1) / numWorkers + MR - 1) / MR * MR;
+    int first = (int)myid * stripSize;
+    int last = (first + stripSize < size) ? first + stripSize : size;
+    int numBlocks = (size + MC - 1) / MC;
+
+    /* clear my strip of C; the barrier after the first B panel orders it
+       before any tile is stored */
+    topo_pin(TOPO_DEFAULT, (int)myid, NULL);
+    if (first < last)
+        memset(C + (size_t)first * size, 0, (size_t)(last - first) * size * sizeof(int));
+
+    for (int jc = 0; jc < size; jc += NC) {
+        int nc = (size - jc < NC) ? size - jc : NC;
+        int slivers = (nc + NR - 1) / NR;
+        for (int pc = 0; pc < size; pc += KC) {
+            int kc = (size - pc < KC) ? size - pc : KC;
+            if (myid == 0)
+                nextBlock = 0;
+            for (int s = (int)myid; s < slivers; s += numWorkers)
+                packBSliver(s, pc, kc, jc, nc);
+            Barrier();
+
+            if (useBag) {
+                while (true) {
+                    int block = __sync_fetch_and_add(&nextBlock, 1);
+                    if (block >= numBlocks)
+                        break;
+                    int ic = block * MC;
+                    int mc = (size - ic < MC) ? size - ic : MC;
+                    computeBlock(packedA, ic, mc, pc, kc, jc, nc, p);
+                }
+            } else {
+                for (int ic = first; ic < last; ic += MC) {
+                    int mc = (last - ic < MC) ? last - ic : MC;
+                    computeBlock(packedA, ic, mc, pc, kc, jc, nc, p);
+                }
+            }
+            Barrier();
+        }
+    }
+    free(packedA);
+    return NULL;
+}
+
+/* multiply with the given number of workers and return the wall time */
+double multiply(int workers, partial_t *result) {
+    pthread_attr_t attr;
+    pthread_t workerid[MAXWORKERS];
+    numWorkers = workers;
+    numArrived = 0;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM);
+    double start_time = read_timer();
+    for (long w = 0; w < numWorkers; w++)
+        pthread_create(&workerid[w], &attr, Worker, (void *) w);
+    for (int w = 0; w < numWorkers; w++)
+        pthread_join(workerid[w], NULL);
+    double end_time = read_timer();
+
+    partialInit(result);
+    for (int w = 0; w < numWorkers; w++)
+        partialMerge(result, &partials[w]);
+    return end_time - start_time;
+}
+
+int main(int argc, char *argv[]) {
+    size = (argc > 1) ? atoi(argv[1]) : 1000;
+    int workers = (argc > 2) ? atoi(argv[2]) : 4;
+    useBag = (argc > 3) && strcmp(argv[3], "bag") == 0;
+    if (size > MAXSIZE) size = MAXSIZE;
+    if (size < 1) size = 1;
+    if (workers > MAXWORKERS) workers = MAXWORKERS;
+    if (workers < 1) workers = 1;
+
+    pthread_mutex_init(&barrier, NULL);
+    pthread_cond_init(&go, NULL);
+
+    size_t bytes = (size_t)size * size * sizeof(int);
+    A = malloc(bytes);
+    B = malloc(bytes);
+    C = malloc(bytes);
+    packedB = aligned_alloc(64, (size_t)KC * ((NC + NR - 1) / NR * NR) * sizeof(int));
+    if (A == NULL || B == NULL || C == NULL || packedB == NULL) {
+        perror("malloc");
+        return 1;
+    }
+    srand(time(NULL));
+    for (size_t k = 0; k < (size_t)size * size; k++) {
+        A[k] = rand() % 99;
+        B[k] = rand() % 99;
+    }
+
+    printf("Matrix size : %d x %d, %s scheduling\n", size, size, useBag ? "bag of tasks" : "static strips");
+    partial_t one, par;
+    double t1 = multiply(1, &one);
+    double tp = multiply(workers, &par);
+    double ops = 2.0 * size * (double)size * size;
+
+    /* check sampled entries of C against a plain dot product and the fused
+       reduction against a separate sweep of C */
+    int errors = 0;
+    for (int s = 0; s < 200; s++) {
+        int i = rand() % size, j = rand() % size;
+        int dot = 0;
+        for (int k = 0; k < size; k++)
+            dot += A[(size_t)i * size + k] * B[(size_t)k * size + j];
+        errors += dot != C[(size_t)i * size + j];
+    }
+    partial_t sweep;
+    partialInit(&sweep);
+    for (int i = 0; i < size; i++) {
+        for (int j = 0; j < size; j++) {
+            int val = C[(size_t)i * size + j];
+            sweep.sum += val;
+            if (val < sweep.min) { sweep.min = val; sweep.minRow = i; sweep.minCol = j; }
+            if (val > sweep.max) { sweep.max = val; sweep.maxRow = i; sweep.maxCol = j; }
+        }
+    }
+    if (sweep.sum != par.sum || sweep.min != par.min || sweep.max != par.max ||
+        sweep.minRow != par.minRow || sweep.minCol != par.minCol ||
+        sweep.maxRow != par.maxRow || sweep.maxCol != par.maxCol)
+        errors++;
+
+    printf("\n======RESULTS======\n");
+    printf("The total of C is %lld\n", par.sum);
+    printf("The min of C is %d at (%d,%d)\n", par.min, par.minRow, par.minCol);
+    printf("The max of C is %d at (%d,%d)\n", par.max, par.maxRow, par.maxCol);
+    printf("1 worker: %g sec, %g GOPS\n", t1, ops / t1 / 1e9);
+    printf("%d workers: %g sec, %g GOPS\n", workers, tp, ops / tp / 1e9);
+    printf("Speedup %g, scaling efficiency %.1f%%\n", t1 / tp, 100.0 * t1 / (tp * workers));
+    printf("Verification: %s\n", errors ? "FAILED" : "ok");
+    printf("=====================\n");
+
+    free(A);
+    free(B);
+    free(C);
+    free(packedB);
+    return errors != 0;
+}
@@ -3,9 +3,12 @@ matrix summation using pthreads
 features: uses a barrier; the Worker[0] computes
 the total sum from partial sums computed by Workers
 and prints the total sum to the standard output
+each worker fills its own strip after being pinned, so with AFFINITY set
+(compact, scatter, core or numa, see lib/topology.h) the pages of a strip
+are first touched on the node of the worker that sums it
 usage under Linux:
-gcc matrixSum.c -lpthread
-a.out size numWorkers
+gcc matrixSum.c ../../lib/topology.c -lpthread
+AFFINITY=scatter a.out size numWorkers
 */
 #ifndef _REENTRANT
 #define _REENTRANT
@@ -16,23 +19,28 @@ a.out size numWorkers
 #include <stdbool.h>
 #include <time.h>
 #include <sys/time.h>
+#include "../../lib/topology.h"
 #define MAXSIZE 10000 /* maximum matrix size */
 #define MAXWORKERS 10 /* maximum number of workers */
 pthread_mutex_t barrier; /* mutex lock for the barrier */
 pthread_cond_t go; /* condition variable for leaving */
 int numWorkers; /* number of workers */
 int numArrived = 0; /* number who have arrived */
+int generation = 0; /* barrier round, guards against spurious wakeups */
 /* a reusable counter barrier */ /* barriers are a point that all processes must reach before any can proceed. A counter barrier is centralized, and ut yses a shared counter to count processes arrived at the barrier*/
 
 void Barrier() {
     pthread_mutex_lock(&barrier);
+    int myGeneration = generation;
     numArrived++;
     if (numArrived == numWorkers) {
         numArrived = 0;
+        generation++;
         pthread_cond_broadcast(&go);
     } else {
+        while (myGeneration == generation)
             pthread_cond_wait(&go, &barrier);
-            }
+    }
     pthread_mutex_unlock(&barrier);
 }
 
@@ -57,13 +65,13 @@ int minRow[MAXWORKERS], minCol[MAXWORKERS];
 int maxRow[MAXWORKERS], maxCol[MAXWORKERS];
 
 int matrix[MAXSIZE][MAXSIZE]; /* matrix */
+unsigned int seed; /* base seed, each worker adds its id */
 
 void *Worker(void *);
 /* read command line, initialize, and create threads */
 
 
 int main(int argc, char *argv[]) {
-    int i, j;
     long l; /* use long in case of a 64-bit system */
     pthread_attr_t attr;
     pthread_t workerid[MAXWORKERS];
@@ -83,25 +91,9 @@ int main(int argc, char *argv[]) {
     if (numWorkers > MAXWORKERS) numWorkers = MAXWORKERS;
     stripSize = size/numWorkers;
 
-    /* initialize the matrix */
-    srand(time(NULL));
-    for (i = 0; i < size; i++) {
-        for (j = 0; j < size; j++) {
-            matrix[i][j] = rand() %99; //rand()%99;
-        }
-    }
-    /* print the matrix */
-    #ifdef DEBUG
-    for (i = 0; i < size; i++) {
-    printf("[ ");
-    for (j = 0; j < size; j++) {
-        printf(" %d", matrix[i][j]);
-    }
-    printf(" ]\n");
-    }
-    #endif
+    /* the workers initialize the matrix, each its own strip */
+    seed = time(NULL);
     /* do the parallel work: create the workers */
-    start_time = read_timer();
     for (l = 0; l < numWorkers; l++)
         pthread_create(&workerid[l], &attr, Worker, (void *) l);
         pthread_exit(NULL);
@@ -116,13 +108,38 @@ void *Worker(void *arg) {
     long myid = (long) arg;
 
     int total, i, j, first, last;
+    unsigned int mySeed = seed + (unsigned int)myid;
     #ifdef DEBUG
     printf("worker %d (pthread id %d) has started\n", myid, pthread_self());
     #endif
+    topo_pin(TOPO_DEFAULT, (int)myid, NULL);
 
     /* determine first and last rows of my strip */
     first = (int)myid*stripSize;
     last = (myid == numWorkers - 1) ? (size - 1) : (first + stripSize - 1);
+
+    /* initialize my strip; first touch places its pages near this worker */
+    for (i = first; i <= last; i++) {
+        for (j = 0; j < size; j++) {
+            matrix[i][j] = rand_r(&mySeed) %99;
+        }
+    }
+    Barrier();
+    if (myid == 0) {
+        /* print the matrix */
+        #ifdef DEBUG
+        for (i = 0; i < size; i++) {
+        printf("[ ");
+        for (j = 0; j < size; j++) {
+            printf(" %d", matrix[i][j]);
+        }
+        printf(" ]\n");
+        }
+        #endif
+        start_time = read_timer();
+    }
+    Barrier();
+
     /* sum values in my strip */
     total = 0;
     int localMin = matrix[first][0];
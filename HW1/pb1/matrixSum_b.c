@@ -3,8 +3,9 @@ features: uses a mutex lock to protect shared variables; the Worker[0] computes
 the total sum from partial sums computed by Workers
 and prints the total sum to the standard output
 usage under Linux:
-gcc matrixSum.c -lpthread
+gcc matrixSum.c ../../lib/topology.c -lpthread
 a.out size numWorkers
+AFFINITY=compact|scatter|core|numa pins the workers (lib/topology.h)
 */
 #ifndef _REENTRANT
 #define _REENTRANT
@@ -15,6 +16,7 @@ a.out size numWorkers
 #include <stdbool.h>
 #include <time.h>
 #include <sys/time.h>
+#include "../../lib/topology.h"
 #define MAXSIZE 10000 /* maximum matrix size */
 #define MAXWORKERS 10 /* maximum number of workers */
 pthread_mutex_t lock; /* mutex lock to protect shared globals*/
@@ -114,6 +116,7 @@ void *Worker(void *arg) {
     #ifdef DEBUG
     printf("worker %d (pthread id %d) has started\n", myid, pthread_self());
     #endif
+    topo_pin(TOPO_DEFAULT, (int)myid, NULL);
 
     /* determine first and last rows of my strip. computes which rows of the matrix it is responsible for based on its workerId and stripSize;*/
     first = (int)myid*stripSize;
@@ -1,4 +1,5 @@
-/* modified b part of the assignment with bag of tasks concept. a shared row counter is initialized and workers continuiously fetch/increment to dinamycally decide which row to process next */
+/* modified b part of the assignment with bag of tasks concept. a shared row counter is initialized and workers continuiously fetch/increment to dinamycally decide which row to process next
+usage: gcc matrixSum_c.c ../../lib/topology.c -lpthread && AFFINITY=scatter ./a.out size numWorkers */
 #ifndef _REENTRANT
 #define _REENTRANT
 #endif
@@ -9,6 +10,7 @@
 #include <stdbool.h>
 #include <time.h>
 #include <sys/time.h>
+#include "../../lib/topology.h"
 #include <limits.h>
 
 #define MAXSIZE 10000 /* max matrix size*/
@@ -111,7 +113,7 @@ int main(int argc, char *argv[]) {
 
 /* worker: repeatedly pull a row index from the bag and process it. */
 void *Worker(void *arg) {
-    (void)arg;
+    topo_pin(TOPO_DEFAULT, (int)(long)arg, NULL);
 
     while (1) {
         int row;
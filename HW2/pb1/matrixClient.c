@@ -0,0 +1,175 @@
+/* client for matrixServer.c
+
+   usage with gcc:
+     gcc -O2 -o matrixClient matrixClient.c
+     ./matrixClient socket info
+     ./matrixClient socket query ops row col rows cols [bins]
+     ./matrixClient socket bench numQueries batchSize [ops]
+   ops is any combination of the letters s (sum), n (min), x (max) and
+   h (histogram), e.g. snx
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "matrixProtocol.h"
+
+static void terminate(const char *msg) {
+  perror(msg);
+  exit(1);
+}
+
+double read_timer() {
+  static bool initialized = false;
+  static struct timeval start;
+  struct timeval end;
+  if( !initialized ) {
+    gettimeofday( &start, NULL );
+    initialized = true;
+  }
+  gettimeofday( &end, NULL );
+  return (end.tv_sec - start.tv_sec) + 1.0e-6 * (end.tv_usec - start.tv_usec);
+}
+
+static void readAll(int fd, void *buf, size_t len) {
+  char *p = buf;
+  while (len > 0) {
+    ssize_t n = read(fd, p, len);
+    if (n <= 0)
+      terminate("read");
+    p += n;
+    len -= n;
+  }
+}
+
+static void writeAll(int fd, const void *buf, size_t len) {
+  const char *p = buf;
+  while (len > 0) {
+    ssize_t n = write(fd, p, len);
+    if (n <= 0)
+      terminate("write");
+    p += n;
+    len -= n;
+  }
+}
+
+static uint32_t parseOps(const char *s) {
+  uint32_t ops = 0;
+  for (; *s; s++) {
+    if (*s == 's') ops |= MQ_SUM;
+    else if (*s == 'n') ops |= MQ_MIN;
+    else if (*s == 'x') ops |= MQ_MAX;
+    else if (*s == 'h') ops |= MQ_HIST;
+  }
+  return ops;
+}
+
+static mq_info_t info(int fd) {
+  uint32_t count = 0;
+  mq_info_t in;
+  writeAll(fd, &count, sizeof(count));
+  readAll(fd, &count, sizeof(count));
+  readAll(fd, &in, sizeof(in));
+  return in;
+}
+
+/* sends one batch and reads its answers, histograms go to hists if it is
+   not NULL (MQ_MAXBINS per query) */
+static void roundTrip(int fd, const mq_query_t *queries, uint32_t count, mq_answer_t *answers, uint64_t *hists) {
+  uint64_t skip[MQ_MAXBINS];
+  writeAll(fd, &count, sizeof(count));
+  writeAll(fd, queries, count * sizeof(mq_query_t));
+  readAll(fd, &count, sizeof(count));
+  for (uint32_t q = 0; q < count; q++) {
+    readAll(fd, &answers[q], sizeof(mq_answer_t));
+    if (answers[q].bins > 0)
+      readAll(fd, hists ? hists + (size_t)q * MQ_MAXBINS : skip, answers[q].bins * sizeof(uint64_t));
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s socket info|query|bench ...\n", argv[0]);
+    return 1;
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    terminate("socket");
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, argv[1], sizeof(addr.sun_path) - 1);
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    terminate(argv[1]);
+
+  mq_info_t in = info(fd);
+  if (strcmp(argv[2], "info") == 0) {
+    printf("matrix %d x %d, values in [%d, %d]\n", in.rows, in.cols, in.min, in.max);
+
+  } else if (strcmp(argv[2], "query") == 0 && argc > 7) {
+    mq_query_t q = { parseOps(argv[3]), atoi(argv[4]), atoi(argv[5]), atoi(argv[6]), atoi(argv[7]),
+                     (argc > 8) ? atoi(argv[8]) : 10 };
+    mq_answer_t a;
+    uint64_t hist[MQ_MAXBINS];
+    roundTrip(fd, &q, 1, &a, hist);
+    if (a.status != 0) {
+      printf("error: %s\n", strerror(a.status));
+      return 1;
+    }
+    if (q.ops & MQ_SUM) printf("The total is %lld\n", (long long)a.sum);
+    if (q.ops & MQ_MIN) printf("The min is %d at (%d,%d)\n", a.min, a.minRow, a.minCol);
+    if (q.ops & MQ_MAX) printf("The max is %d at (%d,%d)\n", a.max, a.maxRow, a.maxCol);
+    if (q.ops & MQ_HIST) {
+      long width = ((long)in.max - in.min) / a.bins + 1;
+      for (uint32_t b = 0; b < a.bins; b++)
+        printf("[%ld, %ld]: %llu\n", in.min + b * width, in.min + (b + 1) * width - 1,
+               (unsigned long long)hist[b]);
+    }
+
+  } else if (strcmp(argv[2], "bench") == 0 && argc > 4) {
+    int numQueries = atoi(argv[3]);
+    int batchSize = atoi(argv[4]);
+    uint32_t ops = (argc > 5) ? parseOps(argv[5]) : (MQ_SUM | MQ_MIN | MQ_MAX);
+    if (batchSize < 1) batchSize = 1;
+    if (batchSize > MQ_MAXBATCH) batchSize = MQ_MAXBATCH;
+    mq_query_t *queries = malloc(batchSize * sizeof(mq_query_t));
+    mq_answer_t *answers = malloc(batchSize * sizeof(mq_answer_t));
+    if (queries == NULL || answers == NULL)
+      terminate("malloc");
+    srand(time(NULL));
+    int errors = 0;
+    double start_time = read_timer();
+    for (int done = 0; done < numQueries; done += batchSize) {
+      int n = numQueries - done < batchSize ? numQueries - done : batchSize;
+      for (int q = 0; q < n; q++) {
+        queries[q].ops = ops;
+        queries[q].row = rand() % in.rows;
+        queries[q].col = rand() % in.cols;
+        queries[q].rows = 1 + rand() % (in.rows - queries[q].row);
+        queries[q].cols = 1 + rand() % (in.cols - queries[q].col);
+        queries[q].bins = 16;
+      }
+      roundTrip(fd, queries, n, answers, NULL);
+      for (int q = 0; q < n; q++)
+        errors += answers[q].status != 0;
+    }
+    double elapsed = read_timer() - start_time;
+    printf("%d queries in batches of %d: %g sec, %g us/query, %g queries/sec, %d errors\n",
+           numQueries, batchSize, elapsed, 1e6 * elapsed / numQueries, numQueries / elapsed, errors);
+    free(queries);
+    free(answers);
+
+  } else {
+    fprintf(stderr, "unknown command %s\n", argv[2]);
+    return 1;
+  }
+  close(fd);
+  return 0;
+}
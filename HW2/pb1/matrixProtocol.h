@@ -0,0 +1,44 @@
+/* wire format between matrixServer.c and matrixClient.c
+
+   Both ends are on the same host, so everything is in host byte order.
+   A request is a uint32 count followed by count mq_query_t records. The
+   reply is a uint32 count followed, for every query in order, by an
+   mq_answer_t and, when MQ_HIST was asked, bins uint64 bin counts.
+   A request with count 0 is answered by the uint32 0 and an mq_info_t.
+*/
+#ifndef MATRIX_PROTOCOL_H
+#define MATRIX_PROTOCOL_H
+
+#include <stdint.h>
+
+#define MQ_SUM  1
+#define MQ_MIN  2
+#define MQ_MAX  4
+#define MQ_HIST 8
+
+#define MQ_MAXBATCH 4096    /* queries per request */
+#define MQ_MAXBINS 256      /* histogram bins per query */
+
+/* rectangle rows [row, row+rows) x cols [col, col+cols). the histogram has
+   bins equal-width bins over the whole matrix's [min, max] */
+typedef struct {
+    uint32_t ops;
+    int32_t row, col, rows, cols;
+    int32_t bins;
+} mq_query_t;
+
+/* status is 0 or an errno value */
+typedef struct {
+    int32_t status;
+    uint32_t bins;
+    int64_t sum;
+    int32_t min, minRow, minCol;
+    int32_t max, maxRow, maxCol;
+} mq_answer_t;
+
+typedef struct {
+    int32_t rows, cols;
+    int32_t min, max;
+} mq_info_t;
+
+#endif
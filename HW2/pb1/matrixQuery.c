@@ -0,0 +1,104 @@
+/* rectangle sum, min and max queries on a summed-area table
+
+   Builds the summed-area table and block min/max summaries of a random
+   matrix once in parallel, then answers random sub-rectangle queries from
+   them. Every answer is checked against a direct scan of the same
+   rectangle with mr_reduce().
+
+   usage with gcc:
+     gcc -O2 -fopenmp -o query matrixQuery.c ../../lib/summedArea.c ../../lib/matrixReduce.c ../../lib/topology.c -lpthread
+     ./query [size] [numQueries] [numWorkers] [blockSize]
+*/
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../../lib/matrixReduce.h"
+#include "../../lib/summedArea.h"
+
+#define MAXSIZE 10000   /* maximum matrix size */
+#define MAXWORKERS 8    /* maximum number of workers */
+
+int main(int argc, char *argv[]) {
+  int size = (argc > 1) ? atoi(argv[1]) : 4000;
+  int numQueries = (argc > 2) ? atoi(argv[2]) : 10000;
+  int numWorkers = (argc > 3) ? atoi(argv[3]) : MAXWORKERS;
+  int blockSize = (argc > 4) ? atoi(argv[4]) : 0;
+  if (size > MAXSIZE) size = MAXSIZE;
+  if (size < 1) size = 1;
+  if (numWorkers > MAXWORKERS) numWorkers = MAXWORKERS;
+
+  int *matrix = malloc((size_t)size * size * sizeof(int));
+  int *rects = malloc((size_t)numQueries * 4 * sizeof(int));
+  if (matrix == NULL || rects == NULL) {
+    perror("malloc");
+    return 1;
+  }
+  srand(time(NULL));
+  for (size_t k = 0; k < (size_t)size * size; k++)
+    matrix[k] = rand() % 999;
+  for (int q = 0; q < numQueries; q++) {
+    int *r = &rects[4 * q];
+    r[0] = rand() % size;
+    r[1] = rand() % size;
+    r[2] = 1 + rand() % (size - r[0]);
+    r[3] = 1 + rand() % (size - r[1]);
+  }
+
+  mr_view_t view = mr_view(matrix, size, size);
+  sa_table_t table;
+  double start_time = omp_get_wtime();
+  if (sa_build(&table, view, blockSize, numWorkers) != 0) {
+    perror("sa_build");
+    return 1;
+  }
+  double build_time = omp_get_wtime() - start_time;
+
+  /* answer every query from the tables */
+  mr_result_t *answers = malloc((size_t)numQueries * sizeof(mr_result_t));
+  if (answers == NULL) {
+    perror("malloc");
+    return 1;
+  }
+  start_time = omp_get_wtime();
+  for (int q = 0; q < numQueries; q++) {
+    int *r = &rects[4 * q];
+    sa_query(&table, r[0], r[1], r[2], r[3], MR_ALL, &answers[q]);
+  }
+  double query_time = omp_get_wtime() - start_time;
+
+  /* same rectangles with a full scan each */
+  int mismatches = 0;
+  start_time = omp_get_wtime();
+  for (int q = 0; q < numQueries; q++) {
+    int *r = &rects[4 * q];
+    mr_request_t req = { mr_subview(view, r[0], r[1], r[2], r[3]), MR_ALL, { MR_SEQ, 1, MR_SCHED_NONE, 0 }, TOPO_DEFAULT };
+    mr_result_t scan;
+    mr_reduce(&req, &scan);
+    mr_result_t *a = &answers[q];
+    if (a->sum != scan.sum || a->min != scan.min || a->max != scan.max ||
+        a->minRow != r[0] + scan.minRow || a->minCol != r[1] + scan.minCol ||
+        a->maxRow != r[0] + scan.maxRow || a->maxCol != r[1] + scan.maxCol) {
+      if (mismatches++ < 5)
+        printf("query %d (%d,%d %dx%d) mismatch: sum %lld/%lld min %d/%d max %d/%d\n", q, r[0], r[1], r[2], r[3],
+               a->sum, scan.sum, a->min, scan.min, a->max, scan.max);
+    }
+  }
+  double scan_time = omp_get_wtime() - start_time;
+
+  printf("\n==============SUMMED-AREA QUERIES==============\n");
+  printf("Matrix %d x %d, %d workers, block %d\n", size, size, numWorkers, table.blockSize);
+  printf("Build time %g sec\n", build_time);
+  printf("%d queries in %g sec (%g us/query)\n", numQueries, query_time, 1e6 * query_time / numQueries);
+  printf("%d scans in %g sec (%g us/query)\n", numQueries, scan_time, 1e6 * scan_time / numQueries);
+  printf("Speedup per query: %g\n", scan_time / query_time);
+  printf("Mismatches: %d\n", mismatches);
+  printf("===============================================\n");
+
+  sa_free(&table);
+  free(answers);
+  free(rects);
+  free(matrix);
+  return mismatches != 0;
+}
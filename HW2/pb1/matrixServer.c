@@ -0,0 +1,407 @@
+/* resident matrix query server
+
+   Loads a matrix once, either by mapping a binary matrix file
+   (lib/matrixFile.h), by parsing a text/CSV file in parallel or by
+   generating it from a seed, builds its summed-area table and block
+   min/max summaries, and then answers
+   rectangle sum, min, max and histogram queries over a Unix domain socket
+   (wire format in matrixProtocol.h). Every client connection, up to
+   MAXCONNECTIONS at once, has its own thread that reads a batch of
+   queries, hands the whole batch to a shared pool of worker threads
+   through one queue push, waits for the batch to complete and writes the
+   answers back in order. AFFINITY=compact,
+   scatter, core or numa pins the pool and the OpenMP threads that load the
+   matrix and build the table (lib/topology.h).
+
+   usage with gcc:
+     gcc -O2 -fopenmp -o matrixServer matrixServer.c ../../lib/summedArea.c \
+         ../../lib/matrixReduce.c ../../lib/matrixFile.c ../../lib/topology.c -lpthread
+     ./matrixServer socket file matrix.bin [numWorkers]
+     ./matrixServer socket text matrix.csv [numWorkers]
+     ./matrixServer socket seed seed size [numWorkers] [save.bin]
+   stop it with Ctrl-C, the socket file is removed on exit
+*/
+#ifndef _REENTRANT
+#define _REENTRANT
+#endif
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <omp.h>
+
+#include "../../lib/matrixFile.h"
+#include "../../lib/summedArea.h"
+#include "../../lib/topology.h"
+#include "matrixProtocol.h"
+
+#define MAXWORKERS 64
+#define QUEUE_SIZE 65536   /* queued queries across all batches */
+#define MAXCONNECTIONS 64  /* clients served at once, the next wait in the listen backlog */
+
+/* one request of one client, completed by the pool */
+typedef struct {
+    int count;
+    mq_query_t *queries;
+    mq_answer_t *answers;
+    uint64_t **hists;       /* bin counts of each query, NULL without MQ_HIST */
+    int pending;            /* queries not answered yet */
+    pthread_mutex_t mutex;
+    pthread_cond_t done;
+} batch_t;
+
+typedef struct {
+    batch_t *batch;
+    int index;
+} job_t;
+
+/* bounded queue of queries shared by all connections */
+typedef struct {
+    job_t *buffer;
+    int size, head, tail, count;
+    pthread_mutex_t mutex;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+} queue_t;
+
+static mf_matrix_t matrix;
+static sa_table_t table;
+static int globalMin, globalMax;
+static queue_t queue;
+static volatile sig_atomic_t stopping = 0;
+static sem_t connectionSlots;   /* connections that may still be opened */
+
+static void terminate(const char *msg) {
+    perror(msg);
+    exit(1);
+}
+
+/* QUEUE */
+static void queue_init(queue_t *q, int size) {
+    q->buffer = malloc(size * sizeof(job_t));
+    if (q->buffer == NULL)
+        terminate("malloc");
+    q->size = size;
+    q->head = q->tail = q->count = 0;
+    pthread_mutex_init(&q->mutex, NULL);
+    pthread_cond_init(&q->notEmpty, NULL);
+    pthread_cond_init(&q->notFull, NULL);
+}
+
+/* pushes all queries of a batch, taking the lock once per run of free slots */
+static void queue_push_batch(queue_t *q, batch_t *b) {
+    int next = 0;
+    pthread_mutex_lock(&q->mutex);
+    while (next < b->count) {
+        while (q->count == q->size)
+            pthread_cond_wait(&q->notFull, &q->mutex);
+        while (next < b->count && q->count < q->size) {
+            q->buffer[q->tail].batch = b;
+            q->buffer[q->tail].index = next++;
+            q->tail = (q->tail + 1) % q->size;
+            q->count++;
+        }
+        pthread_cond_broadcast(&q->notEmpty);
+    }
+    pthread_mutex_unlock(&q->mutex);
+}
+
+static job_t queue_pop(queue_t *q) {
+    pthread_mutex_lock(&q->mutex);
+    while (q->count == 0)
+        pthread_cond_wait(&q->notEmpty, &q->mutex);
+    job_t job = q->buffer[q->head];
+    q->head = (q->head + 1) % q->size;
+    q->count--;
+    pthread_cond_signal(&q->notFull);
+    pthread_mutex_unlock(&q->mutex);
+    return job;
+}
+
+/* QUERIES */
+static void histogram(const mq_query_t *q, uint64_t *bins) {
+    long width = ((long)globalMax - globalMin) / q->bins + 1;
+    memset(bins, 0, q->bins * sizeof(uint64_t));
+    for (int i = q->row; i < q->row + q->rows; i++) {
+        const int *r = matrix.data + (size_t)i * matrix.cols;
+        for (int j = q->col; j < q->col + q->cols; j++)
+            bins[((long)r[j] - globalMin) / width]++;
+    }
+}
+
+static void answer(const mq_query_t *q, mq_answer_t *a, uint64_t *hist) {
+    memset(a, 0, sizeof(*a));
+    if ((q->ops & ~(MQ_SUM | MQ_MIN | MQ_MAX | MQ_HIST)) != 0 || q->ops == 0 ||
+        ((q->ops & MQ_HIST) && (q->bins < 1 || q->bins > MQ_MAXBINS))) {
+        a->status = EINVAL;
+        return;
+    }
+    unsigned ops = q->ops & (MQ_SUM | MQ_MIN | MQ_MAX);
+    mr_result_t res;
+    if (q->rows < 1 || q->cols < 1 || q->row < 0 || q->col < 0 ||
+        q->row > matrix.rows - q->rows || q->col > matrix.cols - q->cols) {
+        a->status = EINVAL;
+        return;
+    }
+    if (ops != 0) {
+        sa_query(&table, q->row, q->col, q->rows, q->cols, ops, &res);
+        a->sum = res.sum;
+        a->min = res.min; a->minRow = res.minRow; a->minCol = res.minCol;
+        a->max = res.max; a->maxRow = res.maxRow; a->maxCol = res.maxCol;
+    }
+    if (q->ops & MQ_HIST) {
+        a->bins = q->bins;
+        histogram(q, hist);
+    }
+}
+
+static void *worker(void *arg) {
+    topo_pin(TOPO_DEFAULT, (int)(long)arg, NULL);
+    while (true) {
+        job_t job = queue_pop(&queue);
+        batch_t *b = job.batch;
+        answer(&b->queries[job.index], &b->answers[job.index], b->hists[job.index]);
+        pthread_mutex_lock(&b->mutex);
+        if (--b->pending == 0)
+            pthread_cond_signal(&b->done);
+        pthread_mutex_unlock(&b->mutex);
+    }
+    return NULL;
+}
+
+/* CONNECTIONS */
+static bool readAll(int fd, void *buf, size_t len) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool writeAll(int fd, const void *buf, size_t len) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+/* whether answering q fills a histogram, which malformed bins do not */
+static bool wantsHist(const mq_query_t *q) {
+    return (q->ops & MQ_HIST) && q->bins >= 1 && q->bins <= MQ_MAXBINS;
+}
+
+/* serves one client until it disconnects, sends a malformed request or
+   there is no memory for its batch. histogram space grows to the largest
+   batch that asked for histograms */
+static void *connection(void *arg) {
+    int fd = (int)(long)arg;
+    batch_t b;
+    b.queries = malloc(MQ_MAXBATCH * sizeof(mq_query_t));
+    b.answers = malloc(MQ_MAXBATCH * sizeof(mq_answer_t));
+    b.hists = malloc(MQ_MAXBATCH * sizeof(uint64_t *));
+    uint64_t *histBuf = NULL;
+    size_t histSize = 0;
+    if (b.queries == NULL || b.answers == NULL || b.hists == NULL) {
+        perror("malloc");
+        free(b.queries);
+        free(b.answers);
+        free(b.hists);
+        close(fd);
+        sem_post(&connectionSlots);
+        return NULL;
+    }
+    pthread_mutex_init(&b.mutex, NULL);
+    pthread_cond_init(&b.done, NULL);
+
+    uint32_t count;
+    while (readAll(fd, &count, sizeof(count))) {
+        if (count == 0) {
+            mq_info_t info = { matrix.rows, matrix.cols, globalMin, globalMax };
+            if (!writeAll(fd, &count, sizeof(count)) || !writeAll(fd, &info, sizeof(info)))
+                break;
+            continue;
+        }
+        if (count > MQ_MAXBATCH || !readAll(fd, b.queries, count * sizeof(mq_query_t)))
+            break;
+        size_t bins = 0;
+        for (uint32_t q = 0; q < count; q++)
+            bins += wantsHist(&b.queries[q]) ? b.queries[q].bins : 0;
+        if (bins > histSize) {
+            uint64_t *bigger = realloc(histBuf, bins * sizeof(uint64_t));
+            if (bigger == NULL) {
+                perror("malloc");
+                break;
+            }
+            histBuf = bigger;
+            histSize = bins;
+        }
+        b.count = count;
+        b.pending = count;
+        bins = 0;
+        for (uint32_t q = 0; q < count; q++) {
+            b.hists[q] = wantsHist(&b.queries[q]) ? histBuf + bins : NULL;
+            bins += wantsHist(&b.queries[q]) ? b.queries[q].bins : 0;
+        }
+        queue_push_batch(&queue, &b);
+
+        pthread_mutex_lock(&b.mutex);
+        while (b.pending > 0)
+            pthread_cond_wait(&b.done, &b.mutex);
+        pthread_mutex_unlock(&b.mutex);
+
+        bool ok = writeAll(fd, &count, sizeof(count));
+        for (uint32_t q = 0; ok && q < count; q++) {
+            ok = writeAll(fd, &b.answers[q], sizeof(mq_answer_t));
+            if (ok && b.answers[q].bins > 0)
+                ok = writeAll(fd, b.hists[q], b.answers[q].bins * sizeof(uint64_t));
+        }
+        if (!ok)
+            break;
+    }
+    close(fd);
+    pthread_mutex_destroy(&b.mutex);
+    pthread_cond_destroy(&b.done);
+    free(b.queries);
+    free(b.answers);
+    free(b.hists);
+    free(histBuf);
+    sem_post(&connectionSlots);
+    return NULL;
+}
+
+static void onSignal(int sig) {
+    (void)sig;
+    stopping = 1;
+}
+
+/* MAIN THREAD */
+int main(int argc, char *argv[]) {
+    if (argc < 4) {
+        fprintf(stderr, "usage: %s socket file matrix.bin [numWorkers]\n"
+                        "       %s socket text matrix.csv [numWorkers]\n"
+                        "       %s socket seed seed size [numWorkers] [save.bin]\n", argv[0], argv[0], argv[0]);
+        return 1;
+    }
+    const char *path = argv[1];
+    int numWorkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    double start_time = omp_get_wtime();
+
+    if (strcmp(argv[2], "file") == 0) {
+        if (mf_map(argv[3], &matrix) != 0)
+            terminate(argv[3]);
+        if (argc > 4) numWorkers = atoi(argv[4]);
+    } else if (strcmp(argv[2], "text") == 0) {
+        long badLine = 0;
+        if (argc > 4) numWorkers = atoi(argv[4]);
+        topo_pin_omp_team(TOPO_DEFAULT, numWorkers > 0 ? numWorkers : 1);
+        if (mf_load_text(argv[3], &matrix, numWorkers, &badLine) != 0) {
+            fprintf(stderr, "%s:%ld: %s\n", argv[3], badLine, strerror(errno));
+            return 1;
+        }
+    } else if (strcmp(argv[2], "seed") == 0 && argc > 4) {
+        int size = atoi(argv[4]);
+        if (size < 1)
+            terminate("size");
+        int *data = malloc((size_t)size * size * sizeof(int));
+        if (data == NULL)
+            terminate("malloc");
+        unsigned seed = (unsigned)atoi(argv[3]);
+        for (size_t k = 0; k < (size_t)size * size; k++)
+            data[k] = rand_r(&seed) % 999;
+        matrix.data = data;
+        matrix.rows = matrix.cols = size;
+        matrix.map = NULL;
+        if (argc > 5) numWorkers = atoi(argv[5]);
+        if (argc > 6 && mf_save(argv[6], data, size, size) != 0)
+            terminate(argv[6]);
+    } else {
+        fprintf(stderr, "unknown source %s\n", argv[2]);
+        return 1;
+    }
+    if (numWorkers < 1) numWorkers = 1;
+    if (numWorkers > MAXWORKERS) numWorkers = MAXWORKERS;
+
+    /* precomputed summaries */
+    mr_view_t view = mr_view(matrix.data, matrix.rows, matrix.cols);
+    topo_pin_omp_team(TOPO_DEFAULT, numWorkers);
+    if (sa_build(&table, view, 0, numWorkers) != 0)
+        terminate("sa_build");
+    mr_result_t whole;
+    sa_query(&table, 0, 0, matrix.rows, matrix.cols, MR_MIN | MR_MAX, &whole);
+    globalMin = whole.min;
+    globalMax = whole.max;
+    printf("loaded %d x %d matrix in %g sec, %d workers\n", matrix.rows, matrix.cols,
+           omp_get_wtime() - start_time, numWorkers);
+
+    queue_init(&queue, QUEUE_SIZE);
+    pthread_t tid;
+    for (long w = 0; w < numWorkers; w++)
+        if (pthread_create(&tid, NULL, worker, (void *) w) != 0)
+            terminate("pthread_create");
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+        terminate("socket");
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    unlink(path);
+    if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, 64) != 0)
+        terminate(path);
+
+    /* no SA_RESTART so accept() returns on Ctrl-C */
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onSignal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("listening on %s\n", path);
+    fflush(stdout);
+    sem_init(&connectionSlots, 0, MAXCONNECTIONS);
+    while (!stopping) {
+        /* a slot first, so clients beyond the cap wait unaccepted */
+        if (sem_wait(&connectionSlots) != 0)
+            continue;
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) {
+            sem_post(&connectionSlots);
+            if (errno == EINTR)
+                continue;
+            terminate("accept");
+        }
+        if (pthread_create(&tid, NULL, connection, (void *)(long)fd) != 0) {
+            close(fd);
+            sem_post(&connectionSlots);
+            continue;
+        }
+        pthread_detach(tid);
+    }
+    close(listener);
+    unlink(path);
+    printf("stopped\n");
+    return 0;
+}
@@ -0,0 +1,104 @@
+/* matrix summation, min and max with an autotuned backend
+
+   The same reduction can be run with static pthread strips (matrixSum.c),
+   strips that merge under a mutex (b_noBarriersNoArray.c), a bag of rows
+   (c_bagOfTasks.c), an OpenMP parallel for (matrixSum-openmp.c) or recursive
+   quadrants on OpenMP tasks (matrixSum-openmp.c tasks). Which one
+   wins depends on the matrix size and on the machine, so "tune" mode times
+   every candidate configuration on this host and stores the fastest one per
+   size in a tuning table. Later runs look the size up in the table and
+   dispatch to that configuration. The backends live in lib/matrixReduce.c.
+
+   usage with gcc:
+     gcc -O2 -fopenmp -o autotune matrixSum-autotune.c ../../lib/matrixReduce.c ../../lib/topology.c -lpthread
+     ./autotune tune [maxSize]                  benchmark and write the table
+     ./autotune size                            run the tuned configuration
+     ./autotune size backend threads [schedule chunk]   force a configuration
+
+   backends: seq, strips, mutex, bag, omp, tasks
+   schedules (omp only): static, dynamic, guided, none for the others
+   chunk is the rows per fetch for bag, the schedule chunk for omp and the
+   elements of a leaf block for tasks
+   the table is read from and written to tuning.txt, or to the file named
+   by the MATRIXSUM_TUNING environment variable
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../lib/matrixReduce.h"
+
+#define MAXSIZE 10000   /* maximum matrix size */
+
+void printResult(const char *title, const mr_result_t *r) {
+  printf("\n==============%s==============\n", title);
+  printf("The total is %lld\n", r->sum);
+  printf("The global min is %d at (%d,%d)\n", r->min, r->minRow, r->minCol);
+  printf("The global max is %d at (%d,%d)\n", r->max, r->maxRow, r->maxCol);
+  printf("The execution time is %g sec\n", r->seconds);
+  printf("===============================================\n");
+}
+
+/* MAIN THREAD */
+int main(int argc, char *argv[]) {
+  if (argc > 1 && strcmp(argv[1], "tune") == 0) {
+    int maxSize = (argc > 2) ? atoi(argv[2]) : MAXSIZE;
+    if (maxSize > MAXSIZE) maxSize = MAXSIZE;
+    int n = mr_tune(maxSize, NULL, stdout);
+    if (n < 0) {
+      perror("tune");
+      return 1;
+    }
+    printf("wrote %d entries\n", n);
+    return 0;
+  }
+
+  int size = (argc > 1) ? atoi(argv[1]) : MAXSIZE;
+  if (size > MAXSIZE) size = MAXSIZE;
+  if (size < 1) size = 1;
+
+  mr_config_t config = { MR_AUTO, 0, MR_SCHED_NONE, 0 };
+  if (argc > 3) {
+    int b = mr_parse_backend(argv[2]);
+    int s = (argc > 4) ? mr_parse_schedule(argv[4]) : MR_SCHED_NONE;
+    if (b < 0 || s < 0) {
+      fprintf(stderr, "unknown backend or schedule\n");
+      return 1;
+    }
+    config.backend = (mr_backend_t)b;
+    config.threads = atoi(argv[3]);
+    config.schedule = (mr_schedule_t)s;
+    config.chunk = (argc > 5) ? atoi(argv[5]) : 0;
+  }
+
+  int *matrix = malloc((size_t)size * size * sizeof(int));
+  if (matrix == NULL) {
+    perror("malloc");
+    return 1;
+  }
+  srand(time(NULL));
+  for (size_t k = 0; k < (size_t)size * size; k++)
+    matrix[k] = rand() % 999;
+
+  mr_request_t req = { mr_view(matrix, size, size), MR_ALL, config, TOPO_DEFAULT };
+  mr_result_t result, check;
+  if (mr_reduce(&req, &result) != 0) {
+    perror("reduce");
+    return 1;
+  }
+  printf("backend %s, %d threads, schedule %s, chunk %d\n", mr_backend_name(result.used.backend),
+         result.used.threads, mr_schedule_name(result.used.schedule), result.used.chunk);
+  printResult("TUNED RESULTS", &result);
+
+  req.config.backend = MR_SEQ;
+  mr_reduce(&req, &check);
+  printResult("SEQUENTIAL RESULTS", &check);
+  if (check.sum != result.sum || check.min != result.min || check.max != result.max ||
+      check.minRow != result.minRow || check.maxRow != result.maxRow)
+    printf("MISMATCH between tuned and sequential results\n");
+  printf("Speedup: %g\n", check.seconds / result.seconds);
+
+  free(matrix);
+  return 0;
+}
@@ -1,9 +1,11 @@
 /* matrix summation using OpenMP
 
    usage with gcc (version 4.2 or higher required):
-     gcc -O -fopenmp -o m matrixSum-openmp.c 
+     gcc -O -fopenmp -o m matrixSum-openmp.c ../../lib/matrixReduce.c ../../lib/topology.c -lpthread
      ./m [size] [numWorkers] for full config and see results
+     ./m [size] [numWorkers] tasks to use the recursive task reduction
       ./m for storing results in results.txt
+     AFFINITY=compact|scatter|core|numa pins the threads (lib/topology.h)
 
 */
 
@@ -18,6 +20,10 @@ double start_time, end_time;
 #include <time.h> // for time
 #include <sys/time.h> 
 #include <limits.h> // for INT_MAX, INT_MIN
+#include <string.h> // for strcmp
+#include "../../lib/topology.h"
+#include "../../lib/benchmark.h"
+#include "../../lib/matrixReduce.h"
 #define MAXSIZE 10000  /* maximum matrix size */
 #define MAXWORKERS 8   /* maximum number of workers */
 
@@ -38,23 +44,6 @@ double read_timer() {
     gettimeofday( &end, NULL );
     return (end.tv_sec - start.tv_sec) + 1.0e-6 * (end.tv_usec - start.tv_usec);
 }
-int compare(const void *a, const void *b) {
-    return (*(int *)a - *(int *)b);  
-}
-double findMedian(double arr[], int n) {
-    qsort(arr, n, sizeof(int), compare);
-
-  	// If even, median is the average of the two
-  	// middle elements
-    if (n % 2 == 0) {
-        return (arr[n / 2 - 1] + arr[n / 2]) / 2.0;
-    }
-  
-  	// If odd, median is the middle element
-  	else {
-        return arr[n / 2];
-    }
-}
 
 /* WORK ON MATRIX*/
 double sequential(bool print, int matrix[MAXSIZE][MAXSIZE], int size){
@@ -103,6 +92,7 @@ double parallel(bool print, int matrix[MAXSIZE][MAXSIZE], int size, int numWorke
   int total = 0;
   int i, j;
   omp_set_num_threads(numWorkers);
+  topo_pin_omp_team(TOPO_DEFAULT, numWorkers);
   start_time = omp_get_wtime();
 
   #pragma omp parallel for reduction(max:global_max) reduction(min:global_min) reduction(+:total) private(j) collapse(2)
@@ -141,6 +131,30 @@ double parallel(bool print, int matrix[MAXSIZE][MAXSIZE], int size, int numWorke
 }
 
 
+/* RECURSIVE TASK REDUCTION: the quadrant reduction of lib/matrixReduce.c */
+double parallelTasks(bool print, int matrix[MAXSIZE][MAXSIZE], int size, int numWorkers){
+  mr_request_t req = { mr_subview(mr_view(&matrix[0][0], MAXSIZE, MAXSIZE), 0, 0, size, size), MR_ALL,
+                       { MR_TASKS, numWorkers, MR_SCHED_NONE, 0 }, TOPO_DEFAULT };
+  mr_result_t result;
+  start_time = omp_get_wtime();
+  if (mr_reduce(&req, &result) != 0) {
+    perror("mr_reduce");
+    exit(1);
+  }
+  end_time = omp_get_wtime();
+
+  if(print){
+    printf("\n===========PARALLEL TASK RESULTS==============\n");
+    printf("The total is %lld\n", result.sum);
+    printf("The global min is %d at (%d,%d)\n", result.min, result.minRow, result.minCol);
+    printf("The global max is %d at (%d,%d)\n", result.max, result.maxRow, result.maxCol);
+    printf("The execution time is %g sec\n", end_time - start_time);
+    printf("===============================================\n");
+  }
+  return end_time - start_time;
+}
+
+
 /* MAIN THREAD */
 int main(int argc, char *argv[]) {
   int i, j, total=0;
@@ -162,7 +176,9 @@ int main(int argc, char *argv[]) {
       //printf(" ]\n");
     }
     
-    double par = parallel(true, matrix, size, numWorkers);
+    bool tasks = (argc > 3) && strcmp(argv[3], "tasks") == 0;
+    double par = tasks ? parallelTasks(true, matrix, size, numWorkers)
+                       : parallel(true, matrix, size, numWorkers);
     double seq = sequential(true, matrix, size);
   }
 
@@ -174,7 +190,7 @@ int main(int argc, char *argv[]) {
   else{
     int matrixSize[] = {1000,2000,3000,4000,5000,6000,7000,8000,9000,10000};
     FILE *fp = fopen("results.txt", "w");
-    fprintf(fp, "Size \t NumWorkers \t MedParTime \t MedSeqTime \t Speedup\n");
+    fprintf(fp, "Size \t NumWorkers \t MedParTime \t MedSeqTime \t Speedup \t MedTaskTime \t TaskSpeedup\n");
     printf("opened file\n");
 
     //loop on matrix sizes
@@ -183,6 +199,7 @@ int main(int argc, char *argv[]) {
 
       double par_times[5];
       double seq_times[5];
+      double task_times[5];
 
       //loop on numworkers
       for (numWorkers = 1; numWorkers <= MAXWORKERS; numWorkers=numWorkers*2){
@@ -199,12 +216,16 @@ int main(int argc, char *argv[]) {
         double seq_time = sequential(false, matrix, size);
         par_times[run] = par_time;
         seq_times[run] = seq_time;
+        task_times[run] = parallelTasks(false, matrix, size, numWorkers);
       }
-      double med_seq_time = findMedian(seq_times, 5);
-      double med_par_time = findMedian(par_times, 5);
+      double med_seq_time = bm_median(seq_times, 5);
+      double med_par_time = bm_median(par_times, 5);
+
+      double med_task_time = bm_median(task_times, 5);
 
       double speedup = med_seq_time / med_par_time;
-      fprintf(fp, "%d & %d & %g & %g & %g \\\\ \n", size, numWorkers, med_par_time, med_seq_time, speedup);
+      fprintf(fp, "%d & %d & %g & %g & %g & %g & %g \\\\ \n", size, numWorkers, med_par_time, med_seq_time, speedup,
+              med_task_time, med_seq_time / med_task_time);
 
       }
       fprintf(fp, "\\hline \n");
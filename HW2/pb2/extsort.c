@@ -0,0 +1,109 @@
+/* external sort of key files
+
+   Sorts a binary file of 32-bit ints that may not fit in memory with
+   lib/externalSort.c, then reports the time, the runs and merge passes it
+   took and, reading the output back in blocks, whether it is sorted.
+   -g writes a test input of n random keys in [0, range), range 0 for the
+   full rand_r range.
+
+   usage with gcc:
+     gcc -O2 -fopenmp -o extsort extsort.c ../../lib/externalSort.c ../../lib/parallelSort.c ../../lib/radixSort.c ../../lib/workSteal.c ../../lib/topology.c -lpthread
+     ./extsort input output [memoryMB [numWorkers [tmpDir]]]
+     ./extsort -g file n [range [seed]]
+*/
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <limits.h>
+#include "../../lib/externalSort.h"
+
+#define BLOCK 65536     /* keys per read or write of the checks */
+
+/* writes n random keys to path */
+static int generate(const char *path, long n, int range, unsigned seed) {
+    FILE *f = fopen(path, "wb");
+    if (f == NULL)
+        return -1;
+    int *buf = malloc(BLOCK * sizeof(int));
+    if (buf == NULL) {
+        fclose(f);
+        return -1;
+    }
+    for (long done = 0; done < n; done += BLOCK) {
+        long m = n - done < BLOCK ? n - done : BLOCK;
+        for (long i = 0; i < m; i++)
+            buf[i] = range > 0 ? rand_r(&seed) % range : rand_r(&seed);
+        if (fwrite(buf, sizeof(int), m, f) != (size_t)m) {
+            free(buf);
+            fclose(f);
+            return -1;
+        }
+    }
+    free(buf);
+    return fclose(f);
+}
+
+/* whether the keys of path ascend, counted in *n */
+static bool isSortedFile(const char *path, long *n) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return false;
+    int *buf = malloc(BLOCK * sizeof(int));
+    bool sorted = buf != NULL;
+    int last = INT_MIN;
+    size_t m;
+    *n = 0;
+    while (sorted && (m = fread(buf, sizeof(int), BLOCK, f)) > 0) {
+        for (size_t i = 0; i < m; i++) {
+            sorted &= buf[i] >= last;
+            last = buf[i];
+        }
+        *n += m;
+    }
+    free(buf);
+    fclose(f);
+    return sorted;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 3 && strcmp(argv[1], "-g") == 0) {
+        long n = atol(argv[3]);
+        int range = (argc > 4) ? atoi(argv[4]) : 0;
+        unsigned seed = (argc > 5) ? (unsigned)atol(argv[5]) : (unsigned)time(NULL);
+        if (generate(argv[2], n, range, seed) != 0) {
+            perror(argv[2]);
+            return 1;
+        }
+        return 0;
+    }
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s input output [memoryMB [numWorkers [tmpDir]]]\n"
+                        "       %s -g file n [range [seed]]\n", argv[0], argv[0]);
+        return 1;
+    }
+    es_config_t config = { 0, 0, NULL };
+    if (argc > 3)
+        config.memory = (size_t)atol(argv[3]) << 20;
+    if (argc > 4)
+        config.threads = atoi(argv[4]);
+    if (argc > 5)
+        config.tmpDir = argv[5];
+
+    es_stats_t stats;
+    double start = omp_get_wtime();
+    if (es_sort_file(argv[1], argv[2], &config, &stats) != 0) {
+        perror("es_sort_file");
+        return 1;
+    }
+    double seconds = omp_get_wtime() - start;
+    printf("%ld keys, %d runs, %d merge passes\n", stats.keys, stats.runs, stats.passes);
+    printf("The execution time is %g sec, %.1f MB/s\n", seconds,
+           stats.keys * sizeof(int) / seconds / (1 << 20));
+    long n;
+    bool sorted = isSortedFile(argv[2], &n);
+    printf("Sorted: %s\n", sorted && n == stats.keys ? "yes" : "NO");
+    return 0;
+}
@@ -0,0 +1,178 @@
+/* partition kernel microbenchmark
+
+   Partitions random lists around their median value with each kernel of
+   lib/parallelSort.c (hoare, block, avx512) on one thread and reports
+   nanoseconds, branch misses and instructions per element, then a whole
+   sequential sort with each kernel. Branch misses come from the hardware
+   counters through perf_event_open(2); where the kernel refuses that (a
+   VM without a PMU, or kernel.perf_event_paranoid above 2) the counter
+   columns show n/a and only the times are reported.
+
+   usage with gcc:
+     gcc -O2 -fopenmp -o pbench partitionBench.c ../../lib/parallelSort.c ../../lib/radixSort.c ../../lib/workSteal.c ../../lib/topology.c -lpthread
+     ./pbench [size] [runs]
+*/
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "../../lib/parallelSort.h"
+
+#define NUMRUNS 5   /* default runs per kernel, the median is kept */
+#define MAXRUNS 101
+
+typedef struct {
+    int branchMisses, instructions;     /* perf fds, -1 if unavailable */
+} counters_t;
+
+typedef struct {
+    double seconds;
+    long long branchMisses, instructions;   /* -1 if unavailable */
+} sample_t;
+
+static int openCounter(unsigned long long config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void startCounters(const counters_t *c) {
+    if (c->branchMisses >= 0) {
+        ioctl(c->branchMisses, PERF_EVENT_IOC_RESET, 0);
+        ioctl(c->branchMisses, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    if (c->instructions >= 0) {
+        ioctl(c->instructions, PERF_EVENT_IOC_RESET, 0);
+        ioctl(c->instructions, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+static long long readCounter(int fd) {
+    long long value;
+    if (fd < 0)
+        return -1;
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd, &value, sizeof(value)) != sizeof(value))
+        return -1;
+    return value;
+}
+
+static int compare_sample(const void *a, const void *b) {
+    double da = ((const sample_t *)a)->seconds;
+    double db = ((const sample_t *)b)->seconds;
+    return (da > db) - (da < db);
+}
+
+/* the run with the median time */
+static sample_t findMedian(sample_t arr[], int n) {
+    qsort(arr, n, sizeof(sample_t), compare_sample);
+    return arr[n / 2];
+}
+
+static void fill(int *list, long size, unsigned seed) {
+    for (long i = 0; i < size; i++)
+        list[i] = rand_r(&seed);
+}
+
+static void printRow(const char *name, sample_t s, long size) {
+    printf("%-8s %10.3f", name, 1e9 * s.seconds / size);
+    if (s.branchMisses >= 0)
+        printf(" %14.4f", (double)s.branchMisses / size);
+    else
+        printf(" %14s", "n/a");
+    if (s.instructions >= 0)
+        printf(" %14.3f\n", (double)s.instructions / size);
+    else
+        printf(" %14s\n", "n/a");
+}
+
+int main(int argc, char *argv[]) {
+    long size = (argc > 1) ? atol(argv[1]) : 10000000;
+    int runs = (argc > 2) ? atoi(argv[2]) : NUMRUNS;
+    if (size < 64) size = 64;
+    if (runs < 1) runs = 1;
+    if (runs > MAXRUNS) runs = MAXRUNS;
+
+    int *list = malloc(size * sizeof(int));
+    if (list == NULL) {
+        perror("malloc");
+        return 1;
+    }
+    counters_t c;
+    c.branchMisses = openCounter(PERF_COUNT_HW_BRANCH_MISSES);
+    c.instructions = openCounter(PERF_COUNT_HW_INSTRUCTIONS);
+    if (c.branchMisses < 0)
+        perror("perf_event_open, no hardware counters");
+
+    ps_kernel_t kernels[] = { PS_KERNEL_HOARE, PS_KERNEL_BLOCK, PS_KERNEL_COMPRESS };
+    unsigned seed = (unsigned)time(NULL);
+    sample_t samples[MAXRUNS];
+
+    printf("%ld random values, median of %d runs\n", size, runs);
+    printf("\n======PARTITION PER ELEMENT======\n");
+    printf("%-8s %10s %14s %14s\n", "kernel", "ns", "branch-misses", "instructions");
+    for (int k = 0; k < 3; k++) {
+        if (ps_resolve_kernel(kernels[k]) != kernels[k]) {
+            printf("%-8s not supported on this cpu\n", ps_kernel_name(kernels[k]));
+            continue;
+        }
+        for (int run = 0; run < runs; run++) {
+            fill(list, size, seed + run);
+            /* rand_r values are uniform, so the middle of their range
+               splits them in half like a median pivot */
+            startCounters(&c);
+            double start = omp_get_wtime();
+            long lt = ps_partition_kernel(list, size, RAND_MAX / 2, kernels[k]);
+            samples[run].seconds = omp_get_wtime() - start;
+            samples[run].branchMisses = readCounter(c.branchMisses);
+            samples[run].instructions = readCounter(c.instructions);
+            if (lt < size / 4 || lt > size - size / 4) {
+                fprintf(stderr, "unexpected split %ld of %ld\n", lt, size);
+                return 1;
+            }
+        }
+        printRow(ps_kernel_name(kernels[k]), findMedian(samples, runs), size);
+    }
+
+    printf("\n======SEQUENTIAL SORT PER ELEMENT======\n");
+    printf("%-8s %10s %14s %14s\n", "kernel", "ns", "branch-misses", "instructions");
+    for (int k = 0; k < 3; k++) {
+        if (ps_resolve_kernel(kernels[k]) != kernels[k])
+            continue;
+        ps_config_t config = { 1, kernels[k], 0, PS_ALGO_QUICK, 0, NULL };
+        for (int run = 0; run < runs; run++) {
+            fill(list, size, seed + run);
+            startCounters(&c);
+            double start = omp_get_wtime();
+            ps_sort_with(list, size, &config);
+            samples[run].seconds = omp_get_wtime() - start;
+            samples[run].branchMisses = readCounter(c.branchMisses);
+            samples[run].instructions = readCounter(c.instructions);
+            for (long i = 1; i < size; i++) {
+                if (list[i - 1] > list[i]) {
+                    fprintf(stderr, "%s kernel did not sort\n", ps_kernel_name(kernels[k]));
+                    return 1;
+                }
+            }
+        }
+        printRow(ps_kernel_name(kernels[k]), findMedian(samples, runs), size);
+    }
+    printf("=======================================\n");
+    free(list);
+    return 0;
+}
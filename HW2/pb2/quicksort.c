@@ -18,9 +18,32 @@ number of threads (set the OMP_NUM_THREADS environment variable or use a call to
 
 /* quick sort algorithm using OpenMP
 
+   The list lives on the heap and is indexed with long, so sizes are only
+   limited by memory (10^9 ints take 4 GB). Inputs are generated in
+   parallel from a seed, one rand_r stream per block of BLOCK elements, so
+   the same seed rebuilds the identical list for the sequential run without
+   keeping a second copy. Values are uniform in [0, range), 0 meaning the
+   full rand_r range; a small range gives many duplicate keys. The sorts
+   themselves live in lib/parallelSort.c, which counting or radix sorts
+   lists when that is cheaper unless the algorithm is set to quick. The
+   single run also reports the peak resident memory, so the merge sort's
+   scratch array shows next to the quicksort, which sorts in place, and
+   for the parallel quicksort the tasks it made and the time every thread
+   spent sorting and idle (ps_sort_stats). Lists here are uniform;
+   sortSuite.c sweeps sorted, reverse, skewed and other inputs.
+
    usage with gcc (version 4.2 or higher required):
-     gcc -O -fopenmp -o q quicksort.c 
-     ./q size numWorkers
+     gcc -O2 -fopenmp -o q quicksort.c ../../lib/parallelSort.c ../../lib/radixSort.c ../../lib/workSteal.c ../../lib/topology.c -lpthread
+     ./q size numWorkers [range [kernel [cutoff [algorithm]]]]
+                                   one run, prints times and speedup; kernel
+                                   is the partition kernel, auto, hoare, block
+                                   or avx512, cutoff the leaf size, 0 for the
+                                   default, and algorithm auto, quick, radix,
+                                   count or merge (see lib/parallelSort.h)
+     ./q [maxSize]                 sweep 10^4, 10^5, ... up to maxSize
+                                   (default 10^9) into results.txt
+     AFFINITY=compact|scatter|core|numa pins the threads (lib/topology.h)
+   sizes that do not fit in physical memory are skipped by the sweep
 */
 
 #include <omp.h>
@@ -29,20 +52,28 @@ double start_time, end_time;
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <stdio.h>
 #include <stdbool.h>
 #include <time.h>
 #include <sys/time.h>
 #include <limits.h>
 #include <string.h> //for memcpy
+#include <unistd.h> //for sysconf
+#include <sys/resource.h> //for getrusage
+#include "../../lib/parallelSort.h"
+#include "../../lib/benchmark.h"
+#include "../../lib/topology.h"
 
-#define MAXSIZE 10000  /* maximum list size */
-#define MAXWORKERS 8   /* maximum number of workers */
-//#define SEQ_CUTOFF 32 //does improve performance on macOS
+#define MAXSWEEP 1000000000L  /* largest list of the default sweep */
+#define MAXWORKERS 64         /* maximum number of workers */
+#define NUMRUNS 5             /* runs per configuration, the median is kept */
+#define BLOCK 65536           /* elements per random stream of fillList */
 
 int numWorkers;
-int size; 
-int list[MAXSIZE];
+long size;
+int *list;
+ps_kernel_t kernel = PS_KERNEL_AUTO; /* partition kernel of both sorts */
+int cutoff = 0;                      /* leaf size of both sorts, 0 for the default */
+ps_algorithm_t algorithm = PS_ALGO_AUTO;
 
 /* HELPER FUNCTIONS */
 double read_timer() {
@@ -58,85 +89,48 @@ double read_timer() {
     return (end.tv_sec - start.tv_sec) + 1.0e-6 * (end.tv_usec - start.tv_usec);
 }
 
-int compare_double(const void *a, const void *b) { //compares double instead of int
-  double da = *(double *)a;
-  double db = *(double *)b;
-  return (da > db) - (da < db);
-
+/* fills arr with n values in [0, range), range 0 for the full rand_r
+   range. the result only depends on seed, not on the number of threads,
+   and each thread first touches the blocks it writes */
+void fillList(int arr[], long n, unsigned seed, int range) {
+  #pragma omp parallel for schedule(static)
+  for (long b = 0; b < (n + BLOCK - 1) / BLOCK; b++) {
+    unsigned s = seed ^ (unsigned)(b * 2654435761UL);
+    long last = (b + 1) * BLOCK < n ? (b + 1) * BLOCK : n;
+    for (long i = b * BLOCK; i < last; i++)
+      arr[i] = range > 0 ? rand_r(&s) % range : rand_r(&s);
+  }
 }
-double findMedian(double arr[], int n) {
-    qsort(arr, n, sizeof(double), compare_double); //adapted to compare_double
 
-  	// If even, median is the average of the two
-  	// middle elements
-    if (n % 2 == 0) {
-        return (arr[n / 2 - 1] + arr[n / 2]) / 2.0;
-    }
-  
-  	// If odd, median is the middle element
-  	else {
-        return arr[n / 2];
-    }
-}
-void swap (int* a, int* b) {
-    int t = *a;
-    *a = *b;
-    *b = t;
-}
-int split(int arr[], int low, int high) {
-  int pivotIdx = low + rand()%(high-low +1); //randomized pivot index
-  swap(&arr[pivotIdx], &arr[high]); //move pivot to end
-    int pivot = arr[high]; 
-    int i = (low-1);
-
-    for (int j=low;j<=high-1; j++) {
-        if (arr[j] < pivot) { //was <=
-            i++; 
-            swap(&arr[i], &arr[j]);
-        }
-    }
-    swap(&arr[i+1], &arr[high]);
-    return (i+1);
+bool isSorted(const int arr[], long n) {
+  long bad = 0;
+  #pragma omp parallel for reduction(+:bad)
+  for (long i = 1; i < n; i++)
+    bad += arr[i - 1] > arr[i];
+  return bad == 0;
 }
 
-/* QUICKSORTS */
-void seqQuickSort(int arr[], int low, int high) { //tail recursion elimination to prevent bus error/stack overflow on macOS for worst case partitions
-    while (low < high) {
-        int splitIdx = split(arr, low, high);//moved inside loop
-        //recurse on smaller side, loop on larger side to achieve log(n) stack
-        if(splitIdx-low<high-splitIdx){
-        seqQuickSort(arr, low, splitIdx-1); //single recursive call
-        low = splitIdx +1; //tail recursion eliminated
-        } else{
-        seqQuickSort(arr, splitIdx+1, high); //single recursive call
-        high = splitIdx -1;
-        }
-    }
+/* bytes of physical memory, 0 if unknown */
+size_t physicalMemory(void) {
+  long pages = sysconf(_SC_PHYS_PAGES);
+  long pageSize = sysconf(_SC_PAGESIZE);
+  return (pages > 0 && pageSize > 0) ? (size_t)pages * (size_t)pageSize : 0;
 }
-void parQuickSort(int arr[], int low, int high) { // with firstprivate to fetch indices for each task safely 
-    if (low < high) {
-     // if(high -low <SEQ_CUTOFF) { //avoid deep recurison on very small parts
-       // seqQuickSort(arr,low,high);
-        //return;
-     // }
-        int splitIdx = split(arr, low, high);
 
-        #pragma omp task shared(arr) firstprivate(low, splitIdx) if(high-low>1000)
-        parQuickSort(arr, low, splitIdx-1);
-
-        #pragma omp task shared(arr) firstprivate(high, splitIdx) if(high-low>1000)
-        parQuickSort(arr, splitIdx+1, high);
-
-        #pragma omp taskwait // wait for both tasks to finish
-    }
+/* most memory the process has held so far, in bytes */
+size_t peakMemory(void) {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+  return (size_t)usage.ru_maxrss * 1024; //ru_maxrss is in KB on Linux
 }
 
 /* WRAPPERS WITH TIMERS */
-double sequential(bool print, int list[], int size) {
+double sequential(bool print, int list[], long size) {
   /* SEQUENTIAL VERIFICATION OF RESULTS*/
   start_time = omp_get_wtime();
 
-  seqQuickSort(list, 0, size-1);
+  ps_config_t config = { 1, kernel, cutoff, algorithm, 0, NULL };
+  ps_sort_with(list, size, &config);
 
   end_time = omp_get_wtime();
 
@@ -147,127 +141,163 @@ double sequential(bool print, int list[], int size) {
   }
   return end_time - start_time;
 }
-double parallel(bool print, int list[], int size) {
+double parallel(bool print, int list[], long size) {
   /* PARALLELE WORK*/
+  topo_pin_omp_team(TOPO_DEFAULT, omp_get_max_threads());
   start_time = omp_get_wtime();
 
-  //create threads once
-  #pragma omp parallel  
-  {
-   //ensure only one thread starts the initial recursion
-    #pragma omp single
-    {
-        parQuickSort(list, 0, size-1);
-    }
-  }
+  //one team, a single thread starts the recursion and the others take tasks
+  ps_config_t config = { 0, kernel, cutoff, algorithm, 0, NULL };
+  ps_stats_t stats;
+  if (print)
+    ps_sort_stats(list, size, &config, &stats);
+  else
+    ps_sort_with(list, size, &config);
 
   end_time = omp_get_wtime();
 
   if(print){  
     printf("\n==============PARALLEL RESULTS================\n");
-    printf("The execution time is %g sec\n", end_time - start_time);
+    printf("The execution time is %g sec (%s)\n", end_time - start_time, ps_algorithm_name(stats.algorithm));
+    if (stats.algorithm == PS_ALGO_QUICK && stats.threads > 1) {
+      printf("Tasks: %ld created, %ld splits inline, cutoff %ld, max depth %d\n",
+             stats.tasksCreated, stats.tasksInline, stats.taskCutoff, stats.maxDepth);
+      for (int t = 0; t < stats.threads && t < PS_STATS_THREADS; t++)
+        printf("Thread %d: busy %g sec, idle %g sec\n", t, stats.busy[t], stats.seconds - stats.busy[t]);
+    }
     printf("===============================================\n"); 
   }
   return end_time - start_time;
 }
-void printEdges (int arr[], int size ) { //prints first 5 element and last 5 elements of the sorted arrays
-  int k = 5;
+void printEdges (int arr[], long size ) { //prints first 5 element and last 5 elements of the sorted arrays
+  long k = 5;
   if ( size <2 *k ) k = size /2;
-  printf("First %d elements: ", k);
-  for ( int i =0; i<k; i++) {
-    printf("%d", arr[i]);
+  printf("First %ld elements: ", k);
+  for ( long i =0; i<k; i++) {
+    printf(" %d", arr[i]);
 
   }
-  printf("\nLast %d elements: ", k);
-  for ( int i = size - k;i<size; i++) {
-    printf("%d", arr[i]);
+  printf("\nLast %ld elements: ", k);
+  for ( long i = size - k;i<size; i++) {
+    printf(" %d", arr[i]);
 
 }
 printf("\n");
 }
 /* MAIN THREAD */
 int main(int argc, char *argv[]) {
-  int i, j, total=0;
+  unsigned seed = (unsigned)time(NULL);
+  srand(seed);
 
   /* GIVE FULL CONFIG AND SEE ACTUAL RESULTS */
   if (argc > 2){
-    size = atoi(argv[1]);
-    numWorkers = (argc > 2)? atoi(argv[2]) : MAXWORKERS;
-    if (size > MAXSIZE) size = MAXSIZE;
-    if (numWorkers > MAXWORKERS) numWorkers = MAXWORKERS;
-
-    int list_copy[MAXSIZE]; // added to compare same input for seq/par
-
-    /* initialize the list sequentially*/
-    srand(time(NULL));
-    for (i = 0; i < size; i++) {
-      //printf("[ ");
-        list[i] = rand()%999;
+    size = atol(argv[1]);
+    numWorkers = atoi(argv[2]);
+    int range = (argc > 3) ? atoi(argv[3]) : 0;
+    if (argc > 4) {
+      int k = ps_parse_kernel(argv[4]);
+      if (k < 0) {
+        fprintf(stderr, "unknown kernel %s\n", argv[4]);
+        return 1;
+      }
+      kernel = (ps_kernel_t)k;
     }
-        //printf(" %d", list[i]);
-        memcpy(list_copy, list, size * sizeof(int)); //keeps identical input for sequential
-        double par = parallel(true, list, size); 
-        printEdges(list,size);
-
-        double seq = sequential(true, list_copy, size); // we use the copy not the already sorted list
-        printEdges(list_copy, size);
-        printf("Speedup: %g\n", seq/par); //reports speedup in single run mode
-        return 0;
-
+    cutoff = (argc > 5) ? atoi(argv[5]) : 0;
+    if (argc > 6) {
+      int a = ps_parse_algorithm(argv[6]);
+      if (a < 0) {
+        fprintf(stderr, "unknown algorithm %s\n", argv[6]);
+        return 1;
+      }
+      algorithm = (ps_algorithm_t)a;
+    }
+    if (size < 1) size = 1;
+    if (numWorkers < 1) numWorkers = 1;
+    if (numWorkers > MAXWORKERS) numWorkers = MAXWORKERS;
+    omp_set_num_threads(numWorkers);
 
+    list = malloc(size * sizeof(int));
+    if (list == NULL) {
+      perror("malloc");
+      return 1;
     }
-      //printf(" ]\n");
-   
-  
+    /* the same seed gives the sequential run an identical list */
+    fillList(list, size, seed, range);
+    double par = parallel(true, list, size);
+    printEdges(list,size);
+    printf("Peak memory: %zu MB, of which the list %zu MB\n", peakMemory() >> 20, size * sizeof(int) >> 20);
+    bool parOk = isSorted(list, size);
+
+    fillList(list, size, seed, range);
+    double seq = sequential(true, list, size);
+    printEdges(list, size);
+    printf("Sorted: %s\n", (parOk && isSorted(list, size)) ? "yes" : "NO");
+    printf("Speedup: %g\n", seq/par); //reports speedup in single run mode
+    free(list);
+    return 0;
+  }
 
   /* store runtime time, speedup in output file with different sizes and number of workers
-    run it 5 times and take median values for runtimes
-    matrix size follows 10, 100, 1000, ..., MAXSIZE
-    number of workers follows 1, 2, 3, ..., MAXWORKERS
+    run it NUMRUNS times and take median values for runtimes
+    list size follows 10^4, 10^5, ..., maxSize
+    number of workers follows 1, 2, 4, ..., the number of processors (at least 4)
+    the sequential time of a size is measured once and shared by its rows
   */
-    int listSize[] = {1000,2000,3000,4000,5000,6000,7000,8000,9000,10000};
-    FILE *fp = fopen("results.txt", "w");
-    fprintf(fp, "Size \t NumWorkers \t MedParTime \t MedSeqTime \t Speedup\n");
-
-    printf("opened file\n");
-    fflush(fp); // ensures outputs appear even if it crashes
-
-    srand(time(NULL)); //seed once not inside loops 
-
-    //loop on list sizes
-    for (int sizeIdx = 0; sizeIdx < 10; sizeIdx++){
-      size = listSize[sizeIdx];
-      if (size >MAXSIZE ) size = MAXSIZE; //safety 
+  long maxSize = (argc > 1) ? atol(argv[1]) : MAXSWEEP;
+  int maxWorkers = omp_get_num_procs() > 4 ? omp_get_num_procs() : 4;
+  if (maxWorkers > MAXWORKERS) maxWorkers = MAXWORKERS;
+  size_t memory = physicalMemory();
+
+  FILE *fp = fopen("results.txt", "w");
+  if (fp == NULL) {
+    perror("results.txt");
+    return 1;
+  }
+  fprintf(fp, "Size \t NumWorkers \t MedParTime \t MedSeqTime \t Speedup\n");
+  printf("opened file\n");
+  fflush(fp); // ensures outputs appear even if it crashes
+
+  //loop on list sizes
+  for (size = 10000; size <= maxSize; size *= 10){
+    /* leave room for the rest of the system */
+    if (memory > 0 && size * sizeof(int) > memory / 10 * 9) {
+      printf("Skipping size %ld, %zu MB do not fit in memory\n", size, size * sizeof(int) >> 20);
+      break;
+    }
+    list = malloc(size * sizeof(int));
+    if (list == NULL) {
+      printf("Skipping size %ld, malloc failed\n", size);
+      break;
+    }
 
-      for (numWorkers =1; numWorkers<= 4; numWorkers++){
-        omp_set_num_threads(numWorkers); //Specify the number of processors used by specifying a different number of threads by calling  omp_set_num_threads() as requested in the assignment
+    double seq_times[NUMRUNS];
+    for (int run = 0; run < NUMRUNS; run++) {
+      printf("Running size %ld, sequential run %d\n", size, run+1);
+      fillList(list, size, seed + run, 0);
+      seq_times[run] = sequential(false, list, size);
+    }
+    double med_seq_time = bm_median(seq_times, NUMRUNS);
 
-        double par_times[5];
-        double seq_times[5];
-        int base[MAXSIZE]; // store identical input across seq/par
-        for ( int run = 0; run <5; run++) {
+    for (numWorkers = 1; numWorkers <= maxWorkers; numWorkers = bm_next_workers(numWorkers, maxWorkers)){
+      omp_set_num_threads(numWorkers); //Specify the number of processors used by specifying a different number of threads by calling  omp_set_num_threads() as requested in the assignment
 
-        
-        printf("Running size %d, run %d\n", size, run+1);
-        /* initialize the matrix sequentially*/
-        for (i = 0; i < size; i++) {
-          base[i] = rand()%999; //fill base
-        }
-        memcpy(list, base, size * sizeof(int)); //same input for parallel
+      double par_times[NUMRUNS];
+      for (int run = 0; run < NUMRUNS; run++) {
+        printf("Running size %ld, %d workers, run %d\n", size, numWorkers, run+1);
+        fillList(list, size, seed + run, 0); //same input as sequential run
         par_times[run] = parallel(false, list, size);
-        memcpy(list, base, size * sizeof(int)); // same input for sequential 
-
-        seq_times[run] = sequential(false, list, size);
+        if (!isSorted(list, size)) {
+          fprintf(stderr, "size %ld with %d workers is not sorted\n", size, numWorkers);
+          return 1;
+        }
       }
-      double med_seq_time = findMedian(seq_times, 5);
-      double med_par_time = findMedian(par_times, 5);
-      fprintf(fp, "%d \t %d \t %g \t %g \t %g\n", size, numWorkers, med_par_time, med_seq_time, med_seq_time/med_par_time);
+      double med_par_time = bm_median(par_times, NUMRUNS);
+      fprintf(fp, "%ld \t %d \t %g \t %g \t %g\n", size, numWorkers, med_par_time, med_seq_time, med_seq_time/med_par_time);
       fflush(fp); //flush each row
-
-    }
     }
-    fclose(fp);
-    printf("closed file\n");
-    return 0;
-  
+    free(list);
+  }
+  fclose(fp);
+  printf("closed file\n");
+  return 0;
 }
@@ -0,0 +1,181 @@
+/* checks of the record sorts
+
+   Runs every sort of lib/recordSort.h and lib/recordSort.hpp on random
+   records of 8 bytes, moved in place, and of 48 bytes, above
+   REC_DIRECT_MAX and so sorted through pointers, with few distinct keys
+   so that most keys tie, for several list sizes. Every result must ascend
+   and hold each record once, intact; the stable sorts must also keep equal
+   keys in their input order. rec::sort_by_key is also run on uint64_t
+   keys of 2^63 and above mixed with small ones, which must sort last.
+   Prints one line per sort and size, and exits with status 1 if any
+   check failed.
+
+   usage with gcc:
+     gcc -O2 -fopenmp -c ../../lib/recordSort.c ../../lib/radixSort.c
+     g++ -O2 -fopenmp -o rcheck recordCheck.cpp recordSort.o radixSort.o
+     ./rcheck [maxSize [numWorkers]]
+*/
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "../../lib/recordSort.hpp"
+
+#define KEYS 50     /* distinct keys of the records */
+
+typedef struct {
+    int key, id;
+} small_t;
+
+typedef struct {
+    int key, id;
+    char payload[40];   /* id % 251 in every byte */
+} large_t;
+
+typedef struct {
+    uint64_t key;
+    int id;
+} wide_t;
+
+static int failed = 0;
+
+static void report(const char *sort, const char *record, long size, bool ok) {
+    printf("%-16s %-6s %8ld %s\n", sort, record, size, ok ? "ok" : "FAILED");
+    if (!ok)
+        failed = 1;
+}
+
+static void fill(small_t *r, long n, unsigned seed) {
+    for (long i = 0; i < n; i++) {
+        r[i].key = rand_r(&seed) % KEYS;
+        r[i].id = (int)i;
+    }
+}
+
+static void fill(large_t *r, long n, unsigned seed) {
+    for (long i = 0; i < n; i++) {
+        r[i].key = rand_r(&seed) % KEYS;
+        r[i].id = (int)i;
+        memset(r[i].payload, i % 251, sizeof(r[i].payload));
+    }
+}
+
+/* only the large records carry a payload */
+template <class T>
+static bool intact(const T *) {
+    return true;
+}
+
+static bool intact(const large_t *r) {
+    for (size_t b = 0; b < sizeof(r->payload); b++)
+        if (r->payload[b] != (char)(r->id % 251))
+            return false;
+    return true;
+}
+
+/* whether r[0..n) ascends by key, holds every id once and, with stable
+   set, keeps equal keys in id order */
+template <class T>
+static bool check(const T *r, long n, bool stable) {
+    std::vector<char> seen(n, 0);
+    for (long i = 0; i < n; i++) {
+        if (r[i].id < 0 || r[i].id >= n || seen[r[i].id] || !intact(&r[i]))
+            return false;
+        seen[r[i].id] = 1;
+        if (i > 0 && (r[i - 1].key > r[i].key || (stable && r[i - 1].key == r[i].key && r[i - 1].id > r[i].id)))
+            return false;
+    }
+    return true;
+}
+
+template <class T>
+static int compareKeys(const void *a, const void *b) {
+    int x = static_cast<const T *>(a)->key, y = static_cast<const T *>(b)->key;
+    return (x > y) - (x < y);
+}
+
+template <class T>
+static int64_t keyOf(const void *a) {
+    return static_cast<const T *>(a)->key;
+}
+
+/* every sort on n records of type T */
+template <class T>
+static void checkRecords(const char *name, long n, int threads) {
+    std::vector<T> r(n), sorted(n);
+    std::vector<int64_t> keys(n);
+    auto less = [](const T &a, const T &b) { return a.key < b.key; };
+
+    fill(r.data(), n, 1u);
+    rec_qsort(r.data(), n, sizeof(T), compareKeys<T>);
+    report("rec_qsort", name, n, check(r.data(), n, false));
+
+    fill(r.data(), n, 2u);
+    report("rec_sort", name, n, rec_sort(r.data(), n, sizeof(T), compareKeys<T>, threads) == 0 &&
+                                    check(r.data(), n, false));
+
+    fill(r.data(), n, 3u);
+    report("rec_stable_sort", name, n, rec_stable_sort(r.data(), n, sizeof(T), compareKeys<T>, threads) == 0 &&
+                                           check(r.data(), n, true));
+
+    fill(r.data(), n, 4u);
+    report("rec_sort_by_key", name, n, rec_sort_by_key(r.data(), n, sizeof(T), keyOf<T>, threads) == 0 &&
+                                           check(r.data(), n, true));
+
+    fill(r.data(), n, 5u);
+    for (long i = 0; i < n; i++)
+        keys[i] = r[i].key;
+    bool ok = rec_sort_pairs(keys.data(), r.data(), sorted.data(), sizeof(T), n, threads) == 0 &&
+              check(sorted.data(), n, true);
+    for (long i = 0; ok && i < n; i++)
+        ok = keys[i] == sorted[i].key;
+    report("rec_sort_pairs", name, n, ok);
+
+    fill(r.data(), n, 6u);
+    rec::sort(r.data(), n, less, threads);
+    report("rec::sort", name, n, check(r.data(), n, false));
+
+    fill(r.data(), n, 7u);
+    rec::stable_sort(r.data(), n, less, threads);
+    report("rec::stable_sort", name, n, check(r.data(), n, true));
+
+    fill(r.data(), n, 8u);
+    report("rec::sort_by_key", name, n,
+           rec::sort_by_key(r.data(), n, [](const T &a) { return a.key; }, threads) == 0 &&
+           check(r.data(), n, true));
+}
+
+/* rec::sort_by_key on uint64_t keys, a third of them 2^63 and above */
+static void checkWide(long n, int threads) {
+    std::vector<wide_t> r(n);
+    unsigned seed = 9u;
+    for (long i = 0; i < n; i++) {
+        uint64_t k = (uint64_t)(rand_r(&seed) % KEYS);
+        r[i].key = i % 3 == 0 ? k | 1ULL << 63 : k;
+        r[i].id = (int)i;
+    }
+    bool ok = rec::sort_by_key(r.data(), n, [](const wide_t &a) { return a.key; }, threads) == 0 &&
+              check(r.data(), n, true);
+    report("rec::sort_by_key", "u64", n, ok);
+}
+
+static void checkSize(long n, int threads) {
+    checkRecords<small_t>("small", n, threads);
+    checkRecords<large_t>("large", n, threads);
+    checkWide(n, threads);
+}
+
+int main(int argc, char *argv[]) {
+    long maxSize = (argc > 1) ? atol(argv[1]) : 1000000;
+    int threads = (argc > 2) ? atoi(argv[2]) : omp_get_max_threads();
+    if (threads < 1) threads = 1;
+
+    long sizes[] = { 1, 2, 17, 100, 5000, 200000 };
+    int numSizes = sizeof(sizes) / sizeof(sizes[0]);
+    for (int s = 0; s < numSizes && sizes[s] <= maxSize; s++)
+        checkSize(sizes[s], threads);
+    if (maxSize > sizes[numSizes - 1])
+        checkSize(maxSize, threads);
+    return failed;
+}
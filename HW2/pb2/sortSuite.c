@@ -0,0 +1,289 @@
+/* sort benchmark over input distributions
+
+   Times the sorts of lib/parallelSort.c on every input distribution of
+   lib/sortInput.h (uniform, sorted, reverse, equal, few, organ, zipf and
+   saw) for list sizes 10^3, 10^4, ... up to maxSize and 1, 2, 4, ...
+   threads up to the number of processors (at least 4), with each
+   algorithm. Every run is verified in parallel: the output must ascend and
+   hold the same values, by an order-independent checksum taken before and
+   after the sort. The argsort pass times ps_argsort() instead and checks
+   that its permutation orders the keys with ties by index, then gathers
+   columns of 2-, 4- and 8-byte values by it with ps_gather() and checks
+   every gathered value. Rows are written tab-separated, one per
+   distribution, size, thread count and algorithm, with a header line, to
+   suite.tsv or the file named by the SORTSUITE_RESULTS environment
+   variable:
+
+     dist size threads algorithm ran median min nsPerKey speedup verified
+
+   ran is the algorithm that actually sorted the list (auto picks one,
+   radix and count fall back to quick when they do not pay), median and
+   min are seconds over the runs, speedup is the median with one thread
+   over this median, and verified is 1 when every run passed both checks.
+   Sizes whose list, and the scratch array of the merge sort or the
+   permutation and columns of the argsort, do not fit in physical memory
+   are skipped. A failed check is also reported on
+   stderr and makes the exit status 1.
+
+   usage with gcc:
+     gcc -O2 -fopenmp -o suite sortSuite.c ../../lib/sortInput.c ../../lib/parallelSort.c ../../lib/radixSort.c ../../lib/workSteal.c ../../lib/topology.c -lpthread -lm
+     ./suite [maxSize [runs [distributions [algorithms]]]]
+                         distributions and algorithms are comma-separated
+                         names or all, e.g. ./suite 1000000 3 zipf,saw quick
+                         the algorithms are those of ps_parse_algorithm and
+                         argsort
+*/
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include "../../lib/parallelSort.h"
+#include "../../lib/benchmark.h"
+#include "../../lib/sortInput.h"
+
+#define MAXSWEEP 1000000000L  /* largest list of the default sweep */
+#define MINSIZE 1000          /* smallest list of the sweep */
+#define MAXWORKERS 64         /* maximum number of workers */
+#define NUMRUNS 5             /* default runs per configuration, the median is kept */
+#define MAXRUNS 101
+#define ALGORITHMS 5          /* PS_ALGO_AUTO .. PS_ALGO_MERGE */
+#define ARGSORT ALGORITHMS    /* the argsort pass, after the sorts */
+#define ARGSORT_BYTES 52      /* per key: list, permutation, packed words and their scratch, columns */
+
+/* bytes of physical memory, 0 if unknown */
+static size_t physicalMemory(void) {
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGESIZE);
+    return (pages > 0 && pageSize > 0) ? (size_t)pages * (size_t)pageSize : 0;
+}
+
+/* marks the names of a comma-separated list, or all of them, in chosen.
+   returns false on an unknown name */
+static bool parseList(char *list, int count, int (*parse)(const char *), bool chosen[]) {
+    bool all = strcmp(list, "all") == 0;
+    for (int i = 0; i < count; i++)
+        chosen[i] = all;
+    if (all)
+        return true;
+    for (char *name = strtok(list, ","); name != NULL; name = strtok(NULL, ",")) {
+        int i = parse(name);
+        if (i < 0) {
+            fprintf(stderr, "unknown name %s\n", name);
+            return false;
+        }
+        chosen[i] = true;
+    }
+    return true;
+}
+
+/* the algorithms and the argsort pass */
+static int parseAlgorithm(const char *name) {
+    return strcmp(name, "argsort") == 0 ? ARGSORT : ps_parse_algorithm(name);
+}
+
+static const char *algorithmName(int a) {
+    return a == ARGSORT ? "argsort" : ps_algorithm_name((ps_algorithm_t)a);
+}
+
+typedef struct {
+    double median, min;
+    ps_algorithm_t ran;
+    bool verified;
+} timing_t;
+
+/* the columns the argsort pass gathers, one per fast path of ps_gather
+   and one through its generic copy */
+typedef struct {
+    uint32_t *perm;
+    uint16_t *in16, *out16;
+    uint32_t *in32, *out32;
+    uint64_t *in64, *out64;
+} columns_t;
+
+static void freeColumns(columns_t *c) {
+    free(c->perm);
+    free(c->in16);
+    free(c->out16);
+    free(c->in32);
+    free(c->out32);
+    free(c->in64);
+    free(c->out64);
+}
+
+/* false without memory */
+static bool allocColumns(columns_t *c, long size) {
+    c->perm = malloc(size * sizeof(uint32_t));
+    c->in16 = malloc(size * sizeof(uint16_t));
+    c->out16 = malloc(size * sizeof(uint16_t));
+    c->in32 = malloc(size * sizeof(uint32_t));
+    c->out32 = malloc(size * sizeof(uint32_t));
+    c->in64 = malloc(size * sizeof(uint64_t));
+    c->out64 = malloc(size * sizeof(uint64_t));
+    if (c->perm && c->in16 && c->out16 && c->in32 && c->out32 && c->in64 && c->out64) {
+        #pragma omp parallel for schedule(static)
+        for (long i = 0; i < size; i++) {
+            c->in16[i] = (uint16_t)(i * 40503u);
+            c->in32[i] = (uint32_t)i ^ 0x9E3779B9u;
+            c->in64[i] = (uint64_t)i * 0x9E3779B97F4A7C15ULL;
+        }
+        return true;
+    }
+    freeColumns(c);
+    return false;
+}
+
+/* whether perm orders list by key and then index, which also makes it a
+   permutation, and the columns were gathered by it */
+static bool checkArgsort(const int *list, long size, const columns_t *c, int threads) {
+    long bad = 0;
+    #pragma omp parallel for reduction(+:bad) schedule(static) num_threads(threads)
+    for (long i = 0; i < size; i++) {
+        uint32_t p = c->perm[i];
+        if (p >= (uint64_t)size) {
+            bad++;
+            continue;
+        }
+        if (i > 0 && c->perm[i - 1] < (uint64_t)size) {
+            uint32_t q = c->perm[i - 1];
+            bad += list[q] > list[p] || (list[q] == list[p] && q >= p);
+        }
+        bad += c->out16[i] != c->in16[p] || c->out32[i] != c->in32[p] || c->out64[i] != c->in64[p];
+    }
+    return bad == 0;
+}
+
+/* argsorts runs fresh inputs, gathers the columns by each permutation and
+   checks them */
+static timing_t timeArgsort(int *list, long size, si_dist_t dist, int runs, int threads, columns_t *c) {
+    double times[MAXRUNS];
+    timing_t t = { 0, 0, PS_ALGO_QUICK, true };
+    const void *in[] = { c->in16, c->in32, c->in64 };
+    void *out[] = { c->out16, c->out32, c->out64 };
+    size_t sizes[] = { sizeof(uint16_t), sizeof(uint32_t), sizeof(uint64_t) };
+    for (int run = 0; run < runs; run++) {
+        si_fill(list, size, dist, (uint64_t)run, threads);
+        double start = omp_get_wtime();
+        int status = ps_argsort(list, size, c->perm, threads);
+        times[run] = omp_get_wtime() - start;
+        if (status != 0) {
+            perror("ps_argsort");
+            t.verified = false;
+            continue;
+        }
+        ps_gather(c->perm, size, 3, in, out, sizes, threads);
+        if (!checkArgsort(list, size, c, threads))
+            t.verified = false;
+    }
+    t.min = times[0];
+    for (int run = 1; run < runs; run++)
+        t.min = times[run] < t.min ? times[run] : t.min;
+    t.median = bm_median(times, runs);
+    return t;
+}
+
+/* sorts runs fresh inputs and checks every result */
+static timing_t timeSort(int *list, long size, si_dist_t dist, int runs, const ps_config_t *config) {
+    double times[MAXRUNS];
+    timing_t t = { 0, 0, PS_ALGO_QUICK, true };
+    for (int run = 0; run < runs; run++) {
+        si_fill(list, size, dist, (uint64_t)run, config->threads);
+        uint64_t before = si_checksum(list, size, config->threads);
+        ps_stats_t stats;
+        ps_sort_stats(list, size, config, &stats);
+        times[run] = stats.seconds;
+        t.ran = stats.algorithm;
+        if (!si_sorted(list, size, config->threads) || si_checksum(list, size, config->threads) != before)
+            t.verified = false;
+    }
+    t.min = times[0];
+    for (int run = 1; run < runs; run++)
+        t.min = times[run] < t.min ? times[run] : t.min;
+    t.median = bm_median(times, runs);
+    return t;
+}
+
+int main(int argc, char *argv[]) {
+    long maxSize = (argc > 1) ? atol(argv[1]) : MAXSWEEP;
+    int runs = (argc > 2) ? atoi(argv[2]) : NUMRUNS;
+    if (runs < 1) runs = 1;
+    if (runs > MAXRUNS) runs = MAXRUNS;
+    bool dists[SI_DISTS], algorithms[ALGORITHMS + 1];
+    char all[] = "all", allAlgorithms[] = "all";
+    if (!parseList(argc > 3 ? argv[3] : all, SI_DISTS, si_parse_dist, dists) ||
+        !parseList(argc > 4 ? argv[4] : allAlgorithms, ALGORITHMS + 1, parseAlgorithm, algorithms))
+        return 1;
+    int maxWorkers = omp_get_num_procs() > 4 ? omp_get_num_procs() : 4;
+    if (maxWorkers > MAXWORKERS) maxWorkers = MAXWORKERS;
+    size_t memory = physicalMemory();
+
+    const char *path = getenv("SORTSUITE_RESULTS") != NULL ? getenv("SORTSUITE_RESULTS") : "suite.tsv";
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) {
+        perror(path);
+        return 1;
+    }
+    fprintf(fp, "dist\tsize\tthreads\talgorithm\tran\tmedian\tmin\tnsPerKey\tspeedup\tverified\n");
+    fflush(fp);
+
+    int failed = 0;
+    for (long size = MINSIZE; size <= maxSize; size *= 10) {
+        /* leave room for the rest of the system */
+        if (memory > 0 && size * sizeof(int) > memory / 10 * 9) {
+            printf("Skipping size %ld, %zu MB do not fit in memory\n", size, size * sizeof(int) >> 20);
+            break;
+        }
+        int *list = malloc(size * sizeof(int));
+        if (list == NULL) {
+            printf("Skipping size %ld, malloc failed\n", size);
+            break;
+        }
+        columns_t columns;
+        bool argsort = algorithms[ARGSORT];
+        if (argsort && memory > 0 && (size_t)size * ARGSORT_BYTES > memory / 10 * 9) {
+            printf("Skipping the argsort of size %ld, its permutation and columns do not fit\n", size);
+            argsort = false;
+        } else if (argsort && !allocColumns(&columns, size)) {
+            printf("Skipping the argsort of size %ld, malloc failed\n", size);
+            argsort = false;
+        }
+        for (int d = 0; d < SI_DISTS; d++) {
+            if (!dists[d])
+                continue;
+            for (int a = 0; a <= ARGSORT; a++) {
+                if (!algorithms[a] || (a == ARGSORT && !argsort))
+                    continue;
+                if (a == PS_ALGO_MERGE && memory > 0 && 2 * size * sizeof(int) > memory / 10 * 9) {
+                    printf("Skipping the merge sort of size %ld, its scratch does not fit\n", size);
+                    continue;
+                }
+                double seq = 0;
+                for (int threads = 1; threads <= maxWorkers; threads = bm_next_workers(threads, maxWorkers)) {
+                    printf("Running %s, size %ld, %d workers, %s\n", si_dist_name(d), size, threads, algorithmName(a));
+                    ps_config_t config = { threads, PS_KERNEL_AUTO, 0, (ps_algorithm_t)a, 0, NULL };
+                    timing_t t = a == ARGSORT ? timeArgsort(list, size, (si_dist_t)d, runs, threads, &columns)
+                                              : timeSort(list, size, (si_dist_t)d, runs, &config);
+                    if (threads == 1)
+                        seq = t.median;
+                    if (!t.verified) {
+                        fprintf(stderr, "%s, size %ld, %d workers, %s: %s\n", si_dist_name(d), size, threads,
+                                algorithmName(a), a == ARGSORT ? "wrong permutation or gathered values"
+                                                               : "not sorted or values changed");
+                        failed = 1;
+                    }
+                    fprintf(fp, "%s\t%ld\t%d\t%s\t%s\t%g\t%g\t%g\t%g\t%d\n", si_dist_name(d), size, threads,
+                            algorithmName(a), a == ARGSORT ? algorithmName(a) : ps_algorithm_name(t.ran), t.median,
+                            t.min, 1e9 * t.median / size, t.median > 0 ? seq / t.median : 0, t.verified);
+                    fflush(fp); //flush each row
+                }
+            }
+        }
+        if (argsort)
+            freeColumns(&columns);
+        free(list);
+    }
+    fclose(fp);
+    printf("wrote %s\n", path);
+    return failed;
+}
@@ -0,0 +1,117 @@
+/* OpenMP tasks against the work-stealing pool
+
+   Sorts random lists with the quicksort and the merge sort of
+   lib/parallelSort.c on OpenMP tasks and on a pool of lib/workSteal.c
+   with each victim policy, for 1, 2, 4, ... up to maxThreads workers, and
+   reports the median time of each with the speedup over the OpenMP
+   version and, for the pool, the steals per run and the share of steal
+   attempts that found nothing. Every list is checked.
+
+   usage with gcc:
+     gcc -O2 -fopenmp -o sbench stealBench.c ../../lib/parallelSort.c ../../lib/radixSort.c ../../lib/workSteal.c ../../lib/topology.c -lpthread
+     ./sbench [size [runs [maxThreads]]]
+*/
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include "../../lib/parallelSort.h"
+#include "../../lib/benchmark.h"
+
+#define NUMRUNS 5   /* default runs per configuration, the median is kept */
+#define MAXRUNS 101
+
+static void fill(int *list, long size, unsigned seed) {
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < size; i++) {
+        unsigned s = seed ^ (unsigned)(i * 2654435761u);
+        list[i] = rand_r(&s);
+    }
+}
+
+static bool isSorted(const int *list, long size) {
+    for (long i = 1; i < size; i++)
+        if (list[i - 1] > list[i])
+            return false;
+    return true;
+}
+
+/* median seconds of runs sorts as configured, the pool's steals during
+   the sorts in stats, leaving out the idle rounds between them. -1 if a
+   list came out unsorted */
+static double timeSort(int *list, long size, int runs, const ps_config_t *config, ws_stats_t *stats) {
+    double times[MAXRUNS];
+    stats->steals = stats->failedSteals = 0;
+    for (int run = 0; run < runs; run++) {
+        fill(list, size, 12345u + run);
+        ws_stats_t before, after;
+        if (config->pool != NULL)
+            ws_get_stats(config->pool, &before);
+        double start = omp_get_wtime();
+        ps_sort_with(list, size, config);
+        times[run] = omp_get_wtime() - start;
+        if (config->pool != NULL) {
+            ws_get_stats(config->pool, &after);
+            stats->steals += after.steals - before.steals;
+            stats->failedSteals += after.failedSteals - before.failedSteals;
+        }
+        if (!isSorted(list, size))
+            return -1;
+    }
+    return bm_median(times, runs);
+}
+
+int main(int argc, char *argv[]) {
+    long size = (argc > 1) ? atol(argv[1]) : 10000000;
+    int runs = (argc > 2) ? atoi(argv[2]) : NUMRUNS;
+    int maxThreads = (argc > 3) ? atoi(argv[3]) : omp_get_max_threads();
+    if (size < 1) size = 1;
+    if (runs < 1) runs = 1;
+    if (runs > MAXRUNS) runs = MAXRUNS;
+    if (maxThreads < 1) maxThreads = 1;
+
+    int *list = malloc(size * sizeof(int));
+    if (list == NULL) {
+        perror("malloc");
+        return 1;
+    }
+    ps_algorithm_t algorithms[] = { PS_ALGO_QUICK, PS_ALGO_MERGE };
+    ws_victim_t victims[] = { WS_VICTIM_RANDOM, WS_VICTIM_ROUND, WS_VICTIM_NEAR };
+
+    printf("%ld random values, median of %d runs\n", size, runs);
+    printf("%-6s %7s %-8s %10s %8s %12s %8s\n", "sort", "threads", "runtime", "seconds", "speedup", "steals/run", "failed");
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        for (int k = 0; k < 2; k++) {
+            const char *name = ps_algorithm_name(algorithms[k]);
+            ps_config_t config = { threads, PS_KERNEL_AUTO, 0, algorithms[k], 0, NULL };
+            ws_stats_t stats = { 0, 0, 0, 0 };
+            double omp = timeSort(list, size, runs, &config, &stats);
+            if (omp < 0) {
+                fprintf(stderr, "%s on OpenMP tasks did not sort\n", name);
+                return 1;
+            }
+            printf("%-6s %7d %-8s %10.4f %8s %12s %8s\n", name, threads, "openmp", omp, "1", "", "");
+            for (int v = 0; v < 3; v++) {
+                ws_config_t wc = { threads, victims[v], 0, TOPO_DEFAULT };
+                config.pool = ws_create(&wc);
+                if (config.pool == NULL) {
+                    perror("ws_create");
+                    return 1;
+                }
+                double pool = timeSort(list, size, runs, &config, &stats);
+                ws_destroy(config.pool);
+                config.pool = NULL;
+                if (pool < 0) {
+                    fprintf(stderr, "%s on the %s pool did not sort\n", name, ws_victim_name(victims[v]));
+                    return 1;
+                }
+                long attempts = stats.steals + stats.failedSteals;
+                printf("%-6s %7d %-8s %10.4f %8.3f %12ld %7.1f%%\n", name, threads, ws_victim_name(victims[v]),
+                       pool, omp / pool, stats.steals / runs, attempts > 0 ? 100.0 * stats.failedSteals / attempts : 0.0);
+            }
+        }
+    }
+    free(list);
+    return 0;
+}
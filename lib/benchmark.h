@@ -0,0 +1,60 @@
+/* helpers of the benchmark programs
+
+   The median of repeated timings, without the sorts of parallelSort.h, so
+   the matrix programs and lib/matrixReduce.c can use it too, and the
+   sweep of worker counts 1, 2, 4, ... that ends with the largest.
+
+   build:
+     header only
+*/
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+/* the median of a[0..n), n >= 1, the mean of the two middle values when n
+   is even. reorders a by quickselect */
+static inline double bm_median(double *a, int n) {
+    double *b = a;
+    int m = n, k = n / 2;
+    while (m > 1) {
+        double pivot = b[m / 2];
+        int i = 0, j = m - 1;
+        while (i <= j) {
+            while (b[i] < pivot) i++;
+            while (b[j] > pivot) j--;
+            if (i <= j) {
+                double t = b[i];
+                b[i++] = b[j];
+                b[j--] = t;
+            }
+        }
+        /* b[0..j] <= pivot, b[i..m) >= pivot and anything between equals it */
+        if (k <= j) {
+            m = j + 1;
+        } else if (k >= i) {
+            b += i;
+            m -= i;
+            k -= i;
+        } else {
+            break;
+        }
+    }
+    double upper = a[n / 2];
+    if (n % 2 != 0)
+        return upper;
+    /* the lower middle value is the largest of the half before a[n / 2] */
+    double lower = a[0];
+    for (int i = 1; i < n / 2; i++)
+        lower = a[i] > lower ? a[i] : lower;
+    return (lower + upper) / 2.0;
+}
+
+/* the worker count after workers in the sweep 1, 2, 4, ..., max: twice
+   workers capped at max, and max + 1 once max has run, e.g.
+     for (int w = 1; w <= max; w = bm_next_workers(w, max)) */
+static inline int bm_next_workers(int workers, int max) {
+    if (workers >= max)
+        return max + 1;
+    return workers * 2 < max ? workers * 2 : max;
+}
+
+#endif
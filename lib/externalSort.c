@@ -0,0 +1,654 @@
+/* external-memory sort, see externalSort.h */
+#include "externalSort.h"
+#include "parallelSort.h"
+
+#include <omp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define KEY ((long)sizeof(int))
+#define MIN_MEMORY (4L << 20)   /* bytes, smaller budgets are raised to this */
+#define DONE UINT64_MAX         /* loser tree key of an exhausted run */
+
+/* one read or write of an I/O thread */
+typedef struct request {
+    int fd;
+    void *buf;
+    size_t len;             /* bytes to move */
+    off_t off;
+    bool write;
+    size_t done;            /* bytes moved, fewer than len at the end of a file */
+    int error;              /* errno of a failed transfer, 0 if none */
+    bool finished;
+    struct request *next;
+} request_t;
+
+/* a thread that carries out requests in the order they were submitted */
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t work, done;
+    request_t *head, *tail;
+    bool stop;
+} io_t;
+
+/* the slice [next, end) of a run, read ahead through two block buffers */
+typedef struct {
+    int fd;
+    off_t next, end;        /* bytes not requested yet */
+    int *buf[2];
+    int cur;
+    long pos, len;          /* keys of buf[cur] consumed and held */
+    request_t req;          /* read of the following block into buf[!cur] */
+    bool pending;
+} stream_t;
+
+/* output written from two block buffers */
+typedef struct {
+    int fd;
+    off_t off;              /* where the next block goes */
+    int *buf[2];
+    int cur;
+    long pos, cap;          /* keys in buf[cur] and room for them */
+    request_t req;          /* write of the previous block from buf[!cur] */
+    bool pending;
+} sink_t;
+
+/* I/O THREADS */
+
+static void transfer(request_t *r) {
+    char *p = r->buf;
+    r->done = 0;
+    r->error = 0;
+    while (r->done < r->len) {
+        ssize_t m = r->write ? pwrite(r->fd, p + r->done, r->len - r->done, r->off + r->done)
+                             : pread(r->fd, p + r->done, r->len - r->done, r->off + r->done);
+        if (m < 0 && errno == EINTR)
+            continue;
+        if (m < 0) {
+            r->error = errno;
+            return;
+        }
+        if (m == 0) {
+            if (r->write)
+                r->error = EIO;
+            return;
+        }
+        r->done += m;
+    }
+}
+
+static void *ioMain(void *arg) {
+    io_t *io = arg;
+    pthread_mutex_lock(&io->lock);
+    while (true) {
+        while (io->head == NULL && !io->stop)
+            pthread_cond_wait(&io->work, &io->lock);
+        /* queued requests are carried out even after a stop */
+        if (io->head == NULL)
+            break;
+        request_t *r = io->head;
+        io->head = r->next;
+        if (io->head == NULL)
+            io->tail = NULL;
+        pthread_mutex_unlock(&io->lock);
+        transfer(r);
+        pthread_mutex_lock(&io->lock);
+        r->finished = true;
+        pthread_cond_broadcast(&io->done);
+    }
+    pthread_mutex_unlock(&io->lock);
+    return NULL;
+}
+
+static int ioStart(io_t *io) {
+    io->head = io->tail = NULL;
+    io->stop = false;
+    pthread_mutex_init(&io->lock, NULL);
+    pthread_cond_init(&io->work, NULL);
+    pthread_cond_init(&io->done, NULL);
+    int err = pthread_create(&io->thread, NULL, ioMain, io);
+    if (err != 0) {
+        pthread_cond_destroy(&io->done);
+        pthread_cond_destroy(&io->work);
+        pthread_mutex_destroy(&io->lock);
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+/* returns once every submitted request is done */
+static void ioStop(io_t *io) {
+    pthread_mutex_lock(&io->lock);
+    io->stop = true;
+    pthread_cond_signal(&io->work);
+    pthread_mutex_unlock(&io->lock);
+    pthread_join(io->thread, NULL);
+    pthread_cond_destroy(&io->done);
+    pthread_cond_destroy(&io->work);
+    pthread_mutex_destroy(&io->lock);
+}
+
+static void submit(io_t *io, request_t *r, int fd, void *buf, size_t len, off_t off, bool write) {
+    r->fd = fd;
+    r->buf = buf;
+    r->len = len;
+    r->off = off;
+    r->write = write;
+    r->finished = false;
+    r->next = NULL;
+    pthread_mutex_lock(&io->lock);
+    if (io->tail != NULL)
+        io->tail->next = r;
+    else
+        io->head = r;
+    io->tail = r;
+    pthread_cond_signal(&io->work);
+    pthread_mutex_unlock(&io->lock);
+}
+
+/* 0 once r is done, -1 with errno set if it failed */
+static int await(io_t *io, request_t *r) {
+    pthread_mutex_lock(&io->lock);
+    while (!r->finished)
+        pthread_cond_wait(&io->done, &io->lock);
+    pthread_mutex_unlock(&io->lock);
+    if (r->error != 0) {
+        errno = r->error;
+        return -1;
+    }
+    return 0;
+}
+
+/* await for a request that must have moved all of its bytes */
+static int awaitAll(io_t *io, request_t *r) {
+    if (await(io, r) < 0)
+        return -1;
+    if (r->done != r->len) {
+        errno = EIO;    /* the file shrank under us */
+        return -1;
+    }
+    return 0;
+}
+
+/* FILES */
+
+static size_t physicalMemory(void) {
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGESIZE);
+    return (pages > 0 && pageSize > 0) ? (size_t)pages * (size_t)pageSize : 0;
+}
+
+/* an unlinked temporary file, -1 with errno set */
+static int tempFile(const char *dir) {
+    if (dir == NULL)
+        dir = getenv("TMPDIR");
+    if (dir == NULL || dir[0] == '\0')
+        dir = "/tmp";
+    size_t len = strlen(dir) + sizeof("/esortXXXXXX");
+    char *path = malloc(len);
+    if (path == NULL)
+        return -1;
+    snprintf(path, len, "%s/esortXXXXXX", dir);
+    int fd = mkstemp(path);
+    if (fd >= 0)
+        unlink(path);
+    free(path);
+    return fd;
+}
+
+static int readKey(int fd, long i, int *key) {
+    request_t r;
+    r.fd = fd;
+    r.buf = key;
+    r.len = KEY;
+    r.off = (off_t)i * KEY;
+    r.write = false;
+    transfer(&r);
+    if (r.error != 0) {
+        errno = r.error;
+        return -1;
+    }
+    if (r.done != r.len) {
+        errno = EIO;
+        return -1;
+    }
+    return 0;
+}
+
+static int writeAll(int fd, const int *a, long n, off_t off) {
+    request_t r;
+    r.fd = fd;
+    r.buf = (void *)a;
+    r.len = (size_t)n * KEY;
+    r.off = off;
+    r.write = true;
+    transfer(&r);
+    if (r.error != 0) {
+        errno = r.error;
+        return -1;
+    }
+    return 0;
+}
+
+/* RUN FORMATION */
+
+/* sorts the chunks of chunk keys of the input into runs at the same
+   positions of the file runs. the I/O thread writes the previous run from
+   the other buffer and then reads the next chunk into it while the team
+   sorts; its queue keeps that order */
+static int formRuns(int in, long keys, long chunk, int runs, int threads) {
+    int *buf[2] = { malloc(chunk * KEY), malloc(chunk * KEY) };
+    io_t io;
+    if (buf[0] == NULL || buf[1] == NULL || ioStart(&io) < 0) {
+        free(buf[0]);
+        free(buf[1]);
+        return -1;
+    }
+    ps_config_t config = { threads, PS_KERNEL_AUTO, 0, PS_ALGO_AUTO, 0, NULL };
+    request_t rd, wr;
+    bool writing = false;
+    int rc = 0;
+    long numRuns = (keys + chunk - 1) / chunk;
+    submit(&io, &rd, in, buf[0], (size_t)(chunk < keys ? chunk : keys) * KEY, 0, false);
+    for (long r = 0; r < numRuns; r++) {
+        int cur = r & 1;
+        long first = r * chunk;
+        long n = keys - first < chunk ? keys - first : chunk;
+        if ((rc = awaitAll(&io, &rd)) < 0)
+            break;
+        if (r + 1 < numRuns) {
+            long next = first + chunk;
+            long m = keys - next < chunk ? keys - next : chunk;
+            submit(&io, &rd, in, buf[!cur], (size_t)m * KEY, (off_t)next * KEY, false);
+        }
+        ps_sort_with(buf[cur], n, &config);
+        if (writing && (rc = await(&io, &wr)) < 0)
+            break;
+        submit(&io, &wr, runs, buf[cur], (size_t)n * KEY, (off_t)first * KEY, true);
+        writing = true;
+    }
+    if (rc == 0 && writing)
+        rc = await(&io, &wr);
+    int err = errno;
+    ioStop(&io);
+    free(buf[0]);
+    free(buf[1]);
+    errno = err;
+    return rc;
+}
+
+/* MERGING */
+
+static void prefetch(io_t *io, stream_t *s, size_t block) {
+    if (s->next >= s->end)
+        return;
+    size_t len = (size_t)(s->end - s->next) < block ? (size_t)(s->end - s->next) : block;
+    submit(io, &s->req, s->fd, s->buf[!s->cur], len, s->next, false);
+    s->next += len;
+    s->pending = true;
+}
+
+/* switches to the block read ahead and reads ahead the next one. 1 if
+   there are keys, 0 at the end of the slice, -1 on error */
+static int advance(io_t *io, stream_t *s, size_t block) {
+    s->pos = s->len = 0;
+    if (!s->pending)
+        return 0;
+    s->pending = false;
+    if (awaitAll(io, &s->req) < 0)
+        return -1;
+    s->cur = !s->cur;
+    s->len = (long)(s->req.done / KEY);
+    prefetch(io, s, block);
+    return 1;
+}
+
+/* starts writing the filled buffer and continues in the other one, once
+   the write from it is done */
+static int flush(io_t *io, sink_t *o) {
+    if (o->pending) {
+        o->pending = false;
+        if (await(io, &o->req) < 0)
+            return -1;
+    }
+    if (o->pos == 0)
+        return 0;
+    submit(io, &o->req, o->fd, o->buf[o->cur], (size_t)o->pos * KEY, o->off, true);
+    o->pending = true;
+    o->off += (off_t)o->pos * KEY;
+    o->cur = !o->cur;
+    o->pos = 0;
+    return 0;
+}
+
+/* maps ints to unsigned keys below DONE with the same order */
+static inline uint64_t treeKey(int v) {
+    return (uint32_t)v ^ 0x80000000u;
+}
+
+/* loser tree merge of k streams into o. leaf j is node k + j, internal
+   node i holds the loser of the match between its children and node 0 the
+   overall winner, so replacing the winner's key replays only its path */
+static int mergeStreams(io_t *io, stream_t *st, int k, sink_t *o, size_t block) {
+    uint64_t *key = malloc(k * sizeof(uint64_t));
+    int *tree = malloc(k * sizeof(int));
+    int *winner = malloc(k * sizeof(int));
+    int rc = -1;
+    if (key == NULL || tree == NULL || winner == NULL)
+        goto done;
+    for (int j = 0; j < k; j++) {
+        int r = advance(io, &st[j], block);
+        if (r < 0)
+            goto done;
+        key[j] = r ? treeKey(st[j].buf[st[j].cur][0]) : DONE;
+    }
+    for (int node = k - 1; node >= 1; node--) {
+        int a = 2 * node >= k ? 2 * node - k : winner[2 * node];
+        int b = 2 * node + 1 >= k ? 2 * node + 1 - k : winner[2 * node + 1];
+        winner[node] = key[b] < key[a] ? b : a;
+        tree[node] = key[b] < key[a] ? a : b;
+    }
+    tree[0] = k > 1 ? winner[1] : 0;
+
+    int w = tree[0];
+    while (key[w] != DONE) {
+        stream_t *s = &st[w];
+        o->buf[o->cur][o->pos++] = s->buf[s->cur][s->pos++];
+        if (o->pos == o->cap && flush(io, o) < 0)
+            goto done;
+        if (s->pos == s->len && advance(io, s, block) < 0)
+            goto done;
+        key[w] = s->pos < s->len ? treeKey(s->buf[s->cur][s->pos]) : DONE;
+        for (int node = (w + k) / 2; node > 0; node /= 2) {
+            int l = tree[node];
+            if (key[l] < key[w]) {
+                tree[node] = w;
+                w = l;
+            }
+        }
+        tree[0] = w;
+    }
+    rc = flush(io, o);
+    if (rc == 0 && o->pending) {
+        o->pending = false;
+        rc = await(io, &o->req);
+    }
+done:;
+    int err = errno;
+    free(key);
+    free(tree);
+    free(winner);
+    errno = err;
+    return rc;
+}
+
+/* merges the slices [from[j], to[j]) of k runs of src into dst from key
+   outPos on, with an I/O thread of its own */
+static int mergePart(int src, int k, const long *from, const long *to, int dst, long outPos, size_t block) {
+    stream_t *st = calloc(k, sizeof(stream_t));
+    char *mem = malloc((2 * (size_t)k + 2) * block);
+    io_t io;
+    if (st == NULL || mem == NULL || ioStart(&io) < 0) {
+        free(st);
+        free(mem);
+        return -1;
+    }
+    for (int j = 0; j < k; j++) {
+        st[j].fd = src;
+        st[j].next = (off_t)from[j] * KEY;
+        st[j].end = (off_t)to[j] * KEY;
+        st[j].buf[0] = (int *)(mem + 2 * j * block);
+        st[j].buf[1] = (int *)(mem + (2 * j + 1) * block);
+        prefetch(&io, &st[j], block);
+    }
+    sink_t o;
+    o.fd = dst;
+    o.off = (off_t)outPos * KEY;
+    o.buf[0] = (int *)(mem + 2 * k * block);
+    o.buf[1] = (int *)(mem + (2 * k + 1) * block);
+    o.cur = 0;
+    o.pos = 0;
+    o.cap = (long)(block / KEY);
+    o.pending = false;
+    int rc = mergeStreams(&io, st, k, &o, block);
+    int err = errno;
+    /* reads ahead that the merge did not wait for finish before the buffers go */
+    ioStop(&io);
+    free(st);
+    free(mem);
+    errno = err;
+    return rc;
+}
+
+/* keys <= v in the run [a, b) of fd */
+static long countUpTo(int fd, long a, long b, long v, bool *failed) {
+    long lo = a, hi = b;
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        int key;
+        if (readKey(fd, mid, &key) < 0) {
+            *failed = true;
+            return 0;
+        }
+        if (key <= v)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo - a;
+}
+
+/* positions pos[0..k) in the runs [runs[j], runs[j + 1]) of fd before
+   which lie the first r keys of their merge. the smallest v with at least r
+   keys <= v is searched for, and the keys equal to it are taken from the
+   runs in order until there are r */
+static int splitAt(int fd, const long *runs, int k, long r, long *pos) {
+    long lo = INT_MAX, hi = INT_MIN;
+    for (int j = 0; j < k; j++) {
+        int first, last;
+        if (runs[j + 1] == runs[j])
+            continue;
+        if (readKey(fd, runs[j], &first) < 0 || readKey(fd, runs[j + 1] - 1, &last) < 0)
+            return -1;
+        lo = first < lo ? first : lo;
+        hi = last > hi ? last : hi;
+    }
+    bool failed = false;
+    while (lo < hi) {
+        long v = lo + (hi - lo) / 2;
+        long c = 0;
+        for (int j = 0; j < k; j++)
+            c += countUpTo(fd, runs[j], runs[j + 1], v, &failed);
+        if (failed)
+            return -1;
+        if (c >= r)
+            hi = v;
+        else
+            lo = v + 1;
+    }
+    long need = r;
+    for (int j = 0; j < k; j++) {
+        long below = countUpTo(fd, runs[j], runs[j + 1], lo - 1, &failed);
+        pos[j] = runs[j] + below;
+        need -= below;
+    }
+    for (int j = 0; j < k; j++) {
+        long equal = countUpTo(fd, runs[j], runs[j + 1], lo, &failed) - (pos[j] - runs[j]);
+        long take = equal < need ? equal : need;
+        pos[j] += take;
+        need -= take;
+    }
+    return failed ? -1 : 0;
+}
+
+/* merges the k runs [runs[j], runs[j + 1]) of src into the same positions
+   of dst, split among up to threads threads by output rank */
+static int mergeRuns(int src, const long *runs, int k, int dst, int threads, size_t memory) {
+    long total = runs[k] - runs[0];
+    int parts = threads;
+    if (total / parts < ES_MIN_BLOCK / KEY)
+        parts = total / (ES_MIN_BLOCK / KEY) > 1 ? (int)(total / (ES_MIN_BLOCK / KEY)) : 1;
+    size_t block = memory / parts / (2 * (size_t)k + 2);
+    block = block < ES_MAX_BLOCK ? block : ES_MAX_BLOCK;
+    block = block / 4096 * 4096;
+    block = block < 4096 ? 4096 : block;
+
+    /* row t holds where part t starts in every run */
+    long *pos = malloc((size_t)(parts + 1) * k * sizeof(long));
+    if (pos == NULL)
+        return -1;
+    for (int j = 0; j < k; j++) {
+        pos[j] = runs[j];
+        pos[(size_t)parts * k + j] = runs[j + 1];
+    }
+    int rc = 0;
+    for (int t = 1; t < parts && rc == 0; t++)
+        rc = splitAt(src, runs, k, total * t / parts, pos + (size_t)t * k);
+    int err = errno;
+    #pragma omp parallel for num_threads(parts) if(rc == 0 && parts > 1) schedule(static, 1)
+    for (int t = 0; t < parts; t++) {
+        if (rc != 0)
+            continue;
+        const long *from = pos + (size_t)t * k;
+        if (mergePart(src, k, from, from + k, dst, runs[0] + total * t / parts, block) < 0) {
+            #pragma omp critical
+            {
+                rc = -1;
+                err = errno;
+            }
+        }
+    }
+    free(pos);
+    errno = err;
+    return rc;
+}
+
+int es_sort_file(const char *in, const char *out, const es_config_t *c, es_stats_t *stats) {
+    es_config_t defaults = { 0, 0, NULL };
+    if (c == NULL)
+        c = &defaults;
+    int threads = c->threads > 0 ? c->threads : omp_get_max_threads();
+    size_t memory = c->memory > 0 ? c->memory : physicalMemory() / 2;
+    if (memory < MIN_MEMORY)
+        memory = MIN_MEMORY;
+
+    int fd = open(in, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size % KEY != 0) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    long keys = st.st_size / KEY;
+    /* a third each for the chunk being sorted, the one in transfer and the
+       scratch the in-memory sort may take */
+    long chunk = (long)(memory / 3 / KEY);
+    es_stats_t s = { keys, 1, 0 };
+
+    if (keys <= chunk) {
+        int *a = malloc(keys > 0 ? keys * KEY : 1);
+        request_t r;
+        if (a == NULL) {
+            close(fd);
+            return -1;
+        }
+        r.fd = fd;
+        r.buf = a;
+        r.len = (size_t)keys * KEY;
+        r.off = 0;
+        r.write = false;
+        transfer(&r);
+        close(fd);
+        if (r.error != 0 || r.done != r.len) {
+            free(a);
+            errno = r.error != 0 ? r.error : EIO;
+            return -1;
+        }
+        ps_config_t config = { threads, PS_KERNEL_AUTO, 0, PS_ALGO_AUTO, 0, NULL };
+        ps_sort_with(a, keys, &config);
+        int o = open(out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        int rc = o < 0 ? -1 : writeAll(o, a, keys, 0);
+        int err = errno;
+        if (o >= 0 && close(o) != 0 && rc == 0) {
+            rc = -1;
+            err = errno;
+        }
+        free(a);
+        if (rc == 0 && stats != NULL)
+            *stats = s;
+        errno = err;
+        return rc;
+    }
+
+    int numRuns = (int)((keys + chunk - 1) / chunk);
+    long *runs = malloc((numRuns + 1) * sizeof(long));
+    int src = -1, other = -1, o = -1, rc = -1, err;
+    if (runs == NULL || (src = tempFile(c->tmpDir)) < 0 || formRuns(fd, keys, chunk, src, threads) < 0)
+        goto done;
+    close(fd);
+    fd = -1;
+    for (int r = 0; r < numRuns; r++)
+        runs[r] = (long)r * chunk;
+    runs[numRuns] = keys;
+    s.runs = numRuns;
+
+    /* every run of a merge needs two blocks of ES_MIN_BLOCK per thread */
+    long fanIn = ((long)(memory / threads / ES_MIN_BLOCK) - 2) / 2;
+    fanIn = fanIn < 2 ? 2 : fanIn > INT_MAX ? INT_MAX : fanIn;
+    while (numRuns > fanIn) {
+        if (other < 0 && (other = tempFile(c->tmpDir)) < 0)
+            goto done;
+        int merged = 0;
+        for (int g = 0; g < numRuns; g += fanIn) {
+            int k = numRuns - g < fanIn ? numRuns - g : (int)fanIn;
+            if (mergeRuns(src, runs + g, k, other, threads, memory) < 0)
+                goto done;
+            runs[merged++] = runs[g];
+        }
+        runs[merged] = keys;
+        numRuns = merged;
+        int t = src;
+        src = other;
+        other = t;
+        s.passes++;
+    }
+    if ((o = open(out, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0 ||
+        mergeRuns(src, runs, numRuns, o, threads, memory) < 0)
+        goto done;
+    s.passes++;
+    rc = 0;
+done:
+    err = errno;
+    if (o >= 0 && close(o) != 0 && rc == 0) {
+        rc = -1;
+        err = errno;
+    }
+    if (fd >= 0)
+        close(fd);
+    if (src >= 0)
+        close(src);
+    if (other >= 0)
+        close(other);
+    free(runs);
+    if (rc == 0 && stats != NULL)
+        *stats = s;
+    errno = err;
+    return rc;
+}
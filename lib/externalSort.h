@@ -0,0 +1,63 @@
+/* external-memory sort of key files
+
+   Sorts a file of 32-bit ints in host byte order (no header) that may be
+   many times larger than memory, in two phases.
+
+   Run formation reads the input in chunks of a third of the memory budget,
+   sorts each with ps_sort_with() (lib/parallelSort.h) and appends it as a
+   sorted run to a temporary file; the last third is left for the scratch
+   array a radix or merge sort may take. Two chunk buffers alternate: while
+   the team sorts one, an I/O thread writes the run in the other and reads
+   the next chunk into it.
+
+   Runs are merged with loser trees: with k runs a key costs log2 k
+   comparisons against the losers cached on its path to the root. The merge
+   is split among the threads by output rank, so each thread merges a
+   disjoint slice of every run into its own slice of the output. The
+   boundaries are found by binary search over key values, counting the
+   keys <= v in every run with reads of single keys, and ties at a boundary
+   are divided in run order, so the slices are exactly equal whatever the
+   duplicates. Each thread has an I/O thread of its own, and every run and
+   the output have two block buffers: the merge consumes or fills one while
+   the I/O thread reads the next block of the run into, or writes the
+   previous block of the output from, the other. Blocks take what memory
+   the merge may use, up to ES_MAX_BLOCK bytes. When the runs are too many
+   for blocks of ES_MIN_BLOCK bytes, groups of them are merged into a
+   second temporary file first, each group back into the positions its
+   runs held, until one pass to the output remains.
+
+   The temporary files are unlinked as soon as they are created, so they
+   disappear with the process however it ends. The output is opened only
+   after all of the input has been read, so a file can be sorted onto
+   itself.
+
+   build:
+     gcc -O2 -fopenmp -c externalSort.c parallelSort.c radixSort.c workSteal.c topology.c -lpthread
+*/
+#ifndef EXTERNAL_SORT_H
+#define EXTERNAL_SORT_H
+
+#include <stddef.h>
+
+#define ES_MIN_BLOCK (256 << 10)   /* bytes, fewer runs are merged per pass below this */
+#define ES_MAX_BLOCK (8 << 20)     /* bytes, larger blocks gain nothing */
+
+typedef struct {
+    size_t memory;      /* bytes of buffers, 0 for half the physical memory */
+    int threads;        /* 0 for the OpenMP default, 1 for no team */
+    const char *tmpDir; /* directory of the run files, NULL for $TMPDIR or /tmp */
+} es_config_t;
+
+/* what a sort did */
+typedef struct {
+    long keys;
+    int runs;           /* sorted runs written by run formation */
+    int passes;         /* merge passes, the last one writing the output */
+} es_stats_t;
+
+/* sorts the keys of the file in ascending into the file out, c NULL for
+   the defaults and stats NULL if not wanted. returns 0, or -1 with errno
+   set (EINVAL for an input whose size is not a multiple of 4 bytes) */
+int es_sort_file(const char *in, const char *out, const es_config_t *c, es_stats_t *stats);
+
+#endif
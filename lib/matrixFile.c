@@ -0,0 +1,421 @@
+/* binary matrix files, see matrixFile.h */
+#include "matrixFile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <omp.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define MINCHUNK (1 << 20)  /* bytes of text per thread at least */
+
+/* per-chunk state of the text loader */
+typedef struct {
+    const char *begin, *end;
+    size_t tokens;      /* values in the chunk */
+    size_t lines;       /* newlines in the chunk */
+    size_t offset;      /* index of the chunk's first value in the matrix */
+    long firstLine;     /* 0-based line number of the chunk's first line */
+    int err;
+    long badLine;
+} chunk_t;
+
+int mf_map(const char *path, mf_matrix_t *m) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if ((size_t)st.st_size < MF_HEADER) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+
+    int32_t dims[2];
+    memcpy(dims, (char *)map + 8, sizeof(dims));
+    if (memcmp(map, MF_MAGIC, 8) != 0 || dims[0] < 1 || dims[1] < 1 ||
+        (size_t)st.st_size < MF_HEADER + (size_t)dims[0] * dims[1] * sizeof(int32_t)) {
+        munmap(map, st.st_size);
+        errno = EINVAL;
+        return -1;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    m->data = (const int *)((char *)map + MF_HEADER);
+    m->rows = dims[0];
+    m->cols = dims[1];
+    m->map = map;
+    m->mapLen = st.st_size;
+    return 0;
+}
+
+int mf_save(const char *path, const int *data, int rows, int cols) {
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL)
+        return -1;
+    int32_t dims[2] = { rows, cols };
+    size_t n = (size_t)rows * cols;
+    if (fwrite(MF_MAGIC, 1, 8, fp) != 8 || fwrite(dims, sizeof(dims), 1, fp) != 1 ||
+        fwrite(data, sizeof(int), n, fp) != n) {
+        int err = errno;
+        fclose(fp);
+        errno = err;
+        return -1;
+    }
+    return fclose(fp);
+}
+
+static bool isToken(char c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+';
+}
+static bool isSeparator(char c) {
+    return c == ' ' || c == '\t' || c == ',' || c == ';' || c == '\r';
+}
+
+#ifdef __SSE2__
+/* bit i set when byte i is a digit or a sign */
+static unsigned tokenMask(__m128i v) {
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                                  _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+    __m128i sign = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('-')),
+                                _mm_cmpeq_epi8(v, _mm_set1_epi8('+')));
+    return (unsigned)_mm_movemask_epi8(_mm_or_si128(digit, sign));
+}
+#endif
+
+/* pass 1: values are maximal runs of token characters, counted 16 bytes at
+   a time as the positions where a run starts */
+static void countChunk(chunk_t *c) {
+    const char *p = c->begin;
+    size_t tokens = 0, lines = 0;
+    bool inToken = false;
+#ifdef __SSE2__
+    unsigned prev = 0;
+    for (; p + 16 <= c->end; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        unsigned tok = tokenMask(v);
+        unsigned nl = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+        tokens += __builtin_popcount(tok & ~((tok << 1) | prev));
+        lines += __builtin_popcount(nl);
+        prev = tok >> 15;
+    }
+    inToken = prev != 0;
+#endif
+    for (; p < c->end; p++) {
+        bool tok = isToken(*p);
+        tokens += tok && !inToken;
+        lines += *p == '\n';
+        inToken = tok;
+    }
+    c->tokens = tokens;
+    c->lines = lines;
+}
+
+/* value of the n <= 8 digits at p, 8 bytes at p must be readable. the
+   digits are shifted up so the missing ones become leading zeros, then
+   pairs, quads and the two halves are combined with three multiplies */
+static uint32_t parseDigits(const char *p, int n) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint64_t v;
+    memcpy(&v, p, 8);
+    v -= 0x3030303030303030ULL;
+    v <<= 8 * (8 - n);
+    v = (v * 10) + (v >> 8);
+    v = (((v & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+         (((v >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+    return (uint32_t)v;
+#else
+    uint32_t v = 0;
+    for (int i = 0; i < n; i++)
+        v = v * 10 + (p[i] - '0');
+    return v;
+#endif
+}
+
+/* converts the token [s, e), an optional sign followed by digits only.
+   bytes up to limit may be read. returns 0, EINVAL or ERANGE */
+static inline __attribute__((always_inline))
+int parseToken(const char *s, const char *e, const char *limit, int *out) {
+    bool neg = *s == '-';
+    s += (*s == '-') | (*s == '+');
+    unsigned n = (unsigned)(e - s);
+    if (__builtin_expect(s + 16 <= limit, 1)) {
+        if (n - 1 < 8) {
+            int value = (int)parseDigits(s, n);
+            *out = neg ? -value : value;
+            return 0;
+        }
+        if (n - 9 < 2) {
+            int64_t value = (int64_t)parseDigits(s, n - 8) * 100000000 + parseDigits(e - 8, 8);
+            value = neg ? -value : value;
+            if (value > INT_MAX || value < INT_MIN)
+                return ERANGE;
+            *out = (int)value;
+            return 0;
+        }
+    }
+    while (n > 1 && *s == '0') {
+        s++;
+        n--;
+    }
+    if (n == 0)
+        return EINVAL;
+    if (n > 10)
+        return ERANGE;
+    int64_t value = 0;
+    for (unsigned i = 0; i < n; i++)
+        value = value * 10 + (s[i] - '0');
+    if (neg) value = -value;
+    if (value > INT_MAX || value < INT_MIN)
+        return ERANGE;
+    *out = (int)value;
+    return 0;
+}
+
+#ifdef __SSE2__
+/* 64 bytes at p as bit masks of token characters, signs, newlines and
+   separators */
+static void classify64(const char *p, uint64_t *tok, uint64_t *sign, uint64_t *nl, uint64_t *sep) {
+    *tok = *sign = *nl = *sep = 0;
+    for (int k = 0; k < 4; k++) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + 16 * k));
+        __m128i s = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('-')), _mm_cmpeq_epi8(v, _mm_set1_epi8('+')));
+        __m128i w = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8(','))),
+                                 _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')), _mm_cmpeq_epi8(v, _mm_set1_epi8(';'))));
+        w = _mm_or_si128(w, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+        *tok |= (uint64_t)tokenMask(v) << (16 * k);
+        *sign |= (uint64_t)(unsigned)_mm_movemask_epi8(s) << (16 * k);
+        *nl |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))) << (16 * k);
+        *sep |= (uint64_t)(unsigned)_mm_movemask_epi8(w) << (16 * k);
+    }
+}
+#endif
+
+/* pass 2: parse the chunk into out, checking that every non-empty line
+   has cols values. whole 64 byte blocks are classified with SSE2 and the
+   token boundaries are walked as bits, the tail goes byte by byte */
+static void parseChunk(chunk_t *c, int *out, int cols) {
+    const char *p = c->begin, *end = c->end;
+    long line = c->firstLine;
+    int perLine = 0, err = 0;
+#ifdef __SSE2__
+    const char *tokStart = p;
+    uint64_t prevTok = 0;
+    int startPos[64], endPos[64];
+    for (; p + 64 <= end; p += 64) {
+        uint64_t tok, sign, nl, sep;
+        classify64(p, &tok, &sign, &nl, &sep);
+        uint64_t starts = tok & ~((tok << 1) | prevTok);
+        uint64_t ends = ~tok & ((tok << 1) | prevTok);
+        uint64_t bad = ~(tok | nl | sep) | (sign & ~starts);
+        if (bad) {
+            line += __builtin_popcountll(nl & ((bad & -bad) - 1));
+            err = EINVAL;
+            goto done;
+        }
+
+        /* values per line: the tokens ending at or before each newline */
+        long blockLine = line;
+        uint64_t pending = ends;
+        for (uint64_t n = nl; n; n &= n - 1) {
+            uint64_t upTo = (n & -n) | ((n & -n) - 1);
+            perLine += __builtin_popcountll(pending & upTo);
+            pending &= ~upTo;
+            if (perLine != 0 && perLine != cols) {
+                err = EINVAL;
+                goto done;
+            }
+            perLine = 0;
+            line++;
+        }
+        perLine += __builtin_popcountll(pending);
+
+        /* token boundaries as positions, then one conversion per token */
+        int numStarts = 0, numEnds = 0;
+        for (; starts; starts &= starts - 1)
+            startPos[numStarts++] = __builtin_ctzll(starts);
+        for (uint64_t e = ends; e; e &= e - 1)
+            endPos[numEnds++] = __builtin_ctzll(e);
+        int s = 0;
+        for (int k = 0; k < numEnds; k++) {
+            const char *from = (k == 0 && prevTok) ? tokStart : p + startPos[s++];
+            if ((err = parseToken(from, p + endPos[k], end, out++)) != 0) {
+                line = blockLine + __builtin_popcountll(nl & ((1ULL << endPos[k]) - 1));
+                goto done;
+            }
+        }
+        if (s < numStarts)
+            tokStart = p + startPos[s];
+        prevTok = tok >> 63;
+    }
+    if (prevTok) {
+        /* the open token is parsed again by the tail loop */
+        p = tokStart;
+    }
+#endif
+    while (p < end) {
+        char ch = *p;
+        if (ch == '\n') {
+            if (perLine != 0 && perLine != cols) {
+                err = EINVAL;
+                goto done;
+            }
+            perLine = 0;
+            line++;
+            p++;
+            continue;
+        }
+        if (isSeparator(ch)) {
+            p++;
+            continue;
+        }
+        const char *e = p + (ch == '-' || ch == '+');
+        while (e < end && *e >= '0' && *e <= '9')
+            e++;
+        if (e < end && !isSeparator(*e) && *e != '\n') {
+            err = EINVAL;
+            goto done;
+        }
+        if ((err = parseToken(p, e, end, out++)) != 0)
+            goto done;
+        perLine++;
+        p = e;
+    }
+    if (perLine != 0 && perLine != cols)
+        err = EINVAL;
+done:
+    c->err = err;
+    c->badLine = line + 1;
+}
+
+int mf_load_text(const char *path, mf_matrix_t *m, int threads, long *badLine) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    size_t len = st.st_size;
+    char *text = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (text == MAP_FAILED)
+        return -1;
+    madvise(text, len, MADV_SEQUENTIAL);
+    const char *end = text + len;
+
+    /* columns: values on the first line that has any */
+    int cols = 0;
+    for (const char *p = text; p < end && (cols == 0 || *p != '\n'); p++)
+        cols += isToken(*p) && (p == text || !isToken(p[-1]));
+
+    if (threads < 1) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    int numChunks = (int)(len / MINCHUNK) + 1;
+    if (numChunks > 4 * threads) numChunks = 4 * threads;
+    chunk_t *chunks = calloc(numChunks, sizeof(chunk_t));
+    if (chunks == NULL || cols == 0) {
+        munmap(text, len);
+        free(chunks);
+        errno = chunks ? EINVAL : ENOMEM;
+        if (badLine) *badLine = 1;
+        return -1;
+    }
+
+    /* chunk i starts after the first newline at or past i * len / numChunks */
+    const char *start = text;
+    for (int i = 0; i < numChunks; i++) {
+        const char *stop = (i == numChunks - 1) ? end : text + (len / numChunks) * (i + 1);
+        if (stop < start) stop = start;
+        if (stop < end) {
+            const char *nl = memchr(stop, '\n', end - stop);
+            stop = nl ? nl + 1 : end;
+        }
+        chunks[i].begin = start;
+        chunks[i].end = stop;
+        start = stop;
+    }
+
+    #pragma omp parallel for num_threads(threads) schedule(dynamic, 1)
+    for (int i = 0; i < numChunks; i++)
+        countChunk(&chunks[i]);
+
+    size_t total = 0;
+    long lines = 0;
+    for (int i = 0; i < numChunks; i++) {
+        chunks[i].offset = total;
+        chunks[i].firstLine = lines;
+        total += chunks[i].tokens;
+        lines += chunks[i].lines;
+    }
+    size_t rows = (total + cols - 1) / cols;
+    int *data = rows > INT_MAX ? NULL : malloc(rows * cols * sizeof(int));
+    if (data == NULL) {
+        munmap(text, len);
+        free(chunks);
+        errno = rows > INT_MAX ? EINVAL : ENOMEM;
+        return -1;
+    }
+
+    /* the parsing threads are the first to touch their part of data */
+    #pragma omp parallel for num_threads(threads) schedule(dynamic, 1)
+    for (int i = 0; i < numChunks; i++)
+        parseChunk(&chunks[i], data + chunks[i].offset, cols);
+
+    int err = 0;
+    for (int i = 0; i < numChunks && err == 0; i++) {
+        if (chunks[i].err != 0) {
+            err = chunks[i].err;
+            if (badLine) *badLine = chunks[i].badLine;
+        }
+    }
+    if (err == 0 && total % cols != 0) {
+        err = EINVAL;
+        if (badLine) *badLine = lines;
+    }
+    munmap(text, len);
+    free(chunks);
+    if (err != 0) {
+        free(data);
+        errno = err;
+        return -1;
+    }
+    m->data = data;
+    m->rows = (int)rows;
+    m->cols = cols;
+    m->map = NULL;
+    m->mapLen = 0;
+    return 0;
+}
+
+void mf_release(mf_matrix_t *m) {
+    if (m->map != NULL)
+        munmap(m->map, m->mapLen);
+    else
+        free((void *)m->data);
+    m->data = NULL;
+    m->map = NULL;
+}
@@ -0,0 +1,41 @@
+/* binary matrix files
+
+   A matrix file is the 8 byte magic "MTRX0001", the number of rows and of
+   columns as 32-bit ints, then rows x cols 32-bit ints in row-major order,
+   all in host byte order. mf_map() maps such a file read-only, so opening
+   even a multi-GB matrix costs no copy and pages are loaded on first touch.
+
+   mf_load_text() reads the same matrix from text: one row per line, values
+   separated by spaces, tabs, commas or semicolons. The file is mapped and
+   cut into newline-aligned chunks that OpenMP threads count and then parse
+   in parallel with an SSE2 digit scanner, each writing its values straight
+   into their place in the allocated matrix.
+
+   build:
+     gcc -O2 -fopenmp -c matrixFile.c
+*/
+#ifndef MATRIX_FILE_H
+#define MATRIX_FILE_H
+
+#include <stddef.h>
+
+#define MF_MAGIC "MTRX0001"
+#define MF_HEADER 16    /* magic, rows, cols */
+
+typedef struct {
+    const int *data;    /* rows x cols, row-major */
+    int rows, cols;
+    void *map;          /* mapping that owns data, NULL if data is malloc'd */
+    size_t mapLen;
+} mf_matrix_t;
+
+/* returns 0, or -1 with errno set (EINVAL for a file that is not a matrix) */
+int mf_map(const char *path, mf_matrix_t *m);
+int mf_save(const char *path, const int *data, int rows, int cols);
+/* threads 0 means one per online cpu. returns 0, or -1 with errno set to
+   EINVAL for a malformed file (with the 1-based line in *badLine if badLine
+   is not NULL) or ERANGE for a value that does not fit an int */
+int mf_load_text(const char *path, mf_matrix_t *m, int threads, long *badLine);
+void mf_release(mf_matrix_t *m);
+
+#endif
@@ -0,0 +1,598 @@
+/* matrix reduction library, see matrixReduce.h */
+#ifndef _REENTRANT
+#define _REENTRANT
+#endif
+#include "matrixReduce.h"
+#include "benchmark.h"
+
+#include <omp.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAXENTRIES 64   /* maximum rows in the tuning table */
+#define NUMRUNS 5       /* runs per candidate while tuning, the median is kept */
+#define LEAF_ELEMS 4096 /* default leaf block of the task backend, fits in L1 */
+
+static const char *backendNames[] = { "auto", "seq", "strips", "mutex", "bag", "omp", "tasks" };
+static const char *scheduleNames[] = { "none", "static", "dynamic", "guided" };
+
+/* partial result of a strip, a row block or a thread */
+typedef struct {
+    long long sum;
+    int min, minRow, minCol;
+    int max, maxRow, maxCol;
+} partial_t;
+
+/* everything the workers of one reduction share */
+typedef struct {
+    mr_view_t v;
+    unsigned ops;
+    int numWorkers;
+    int chunk;
+    topo_policy_t affinity;
+    int nextRow;                /* bag of tasks counter */
+    partial_t *partials;        /* one per worker for the strips backend */
+    partial_t result;           /* merged result for mutex and bag */
+    pthread_mutex_t lock;
+} job_t;
+
+typedef struct {
+    job_t *job;
+    long id;
+    void *(*body)(void *);
+} worker_arg_t;
+
+typedef struct {
+    int size;
+    mr_config_t config;
+    double seconds;
+} entry_t;
+
+/* tuning table used by MR_AUTO, loaded on first use */
+static entry_t table[MAXENTRIES];
+static int tableSize = 0;
+static pthread_once_t tableOnce = PTHREAD_ONCE_INIT;
+static pthread_rwlock_t tableLock = PTHREAD_RWLOCK_INITIALIZER;
+
+struct mr_future {
+    pthread_t thread;
+    mr_request_t req;
+    mr_result_t res;
+    int status;
+    int err;
+    volatile int done;
+};
+
+/* NAMES */
+const char *mr_backend_name(mr_backend_t b) {
+    return (unsigned)b < sizeof(backendNames) / sizeof(backendNames[0]) ? backendNames[b] : "?";
+}
+const char *mr_schedule_name(mr_schedule_t s) {
+    return (unsigned)s < sizeof(scheduleNames) / sizeof(scheduleNames[0]) ? scheduleNames[s] : "?";
+}
+static int parseName(const char *name, const char **names, int n) {
+    for (int i = 0; i < n; i++)
+        if (strcmp(name, names[i]) == 0)
+            return i;
+    return -1;
+}
+int mr_parse_backend(const char *name) {
+    return parseName(name, backendNames, sizeof(backendNames) / sizeof(backendNames[0]));
+}
+int mr_parse_schedule(const char *name) {
+    return parseName(name, scheduleNames, sizeof(scheduleNames) / sizeof(scheduleNames[0]));
+}
+
+/* VIEWS */
+mr_view_t mr_view(const int *data, int rows, int cols) {
+    mr_view_t v = { data, rows, cols, (size_t)cols };
+    return v;
+}
+mr_view_t mr_subview(mr_view_t v, int row, int col, int rows, int cols) {
+    mr_view_t s = { v.data + (size_t)row * v.stride + col, rows, cols, v.stride };
+    return s;
+}
+
+/* PARTIAL RESULTS */
+static void partialInit(partial_t *p) {
+    p->sum = 0;
+    p->min = INT_MAX; p->minRow = INT_MAX; p->minCol = INT_MAX;
+    p->max = INT_MIN; p->maxRow = INT_MAX; p->maxCol = INT_MAX;
+}
+
+/* ties go to the first position in row-major order so every backend
+   reports the same coordinates */
+static bool before(int r1, int c1, int r2, int c2) {
+    return r1 < r2 || (r1 == r2 && c1 < c2);
+}
+
+static void partialMerge(partial_t *into, const partial_t *p) {
+    into->sum += p->sum;
+    if (p->min < into->min ||
+        (p->min == into->min && before(p->minRow, p->minCol, into->minRow, into->minCol))) {
+        into->min = p->min; into->minRow = p->minRow; into->minCol = p->minCol;
+    }
+    if (p->max > into->max ||
+        (p->max == into->max && before(p->maxRow, p->maxCol, into->maxRow, into->maxCol))) {
+        into->max = p->max; into->maxRow = p->maxRow; into->maxCol = p->maxCol;
+    }
+}
+
+/* scan rows [first, last) into p, rows are visited in order so strict
+   comparisons keep the first occurrence */
+static void scanRows(const mr_view_t *v, unsigned ops, int first, int last, partial_t *p) {
+    int cols = v->cols;
+    for (int i = first; i < last; i++) {
+        const int *row = v->data + (size_t)i * v->stride;
+        long long rowSum = 0;
+        if (ops == MR_SUM) {
+            for (int j = 0; j < cols; j++)
+                rowSum += row[j];
+            p->sum += rowSum;
+            continue;
+        }
+        int rowMin = row[0], rowMinCol = 0;
+        int rowMax = row[0], rowMaxCol = 0;
+        for (int j = 0; j < cols; j++) {
+            int val = row[j];
+            rowSum += val;
+            if (val < rowMin) { rowMin = val; rowMinCol = j; }
+            if (val > rowMax) { rowMax = val; rowMaxCol = j; }
+        }
+        p->sum += rowSum;
+        if (rowMin < p->min) { p->min = rowMin; p->minRow = i; p->minCol = rowMinCol; }
+        if (rowMax > p->max) { p->max = rowMax; p->maxRow = i; p->maxCol = rowMaxCol; }
+    }
+}
+
+static void stripBounds(const job_t *job, long id, int *first, int *last) {
+    int stripSize = job->v.rows / job->numWorkers;
+    *first = (int)id * stripSize;
+    *last = (id == job->numWorkers - 1) ? job->v.rows : *first + stripSize;
+}
+
+/* BACKENDS */
+
+/* static strips, partial results are combined by the caller after join */
+static void *stripsWorker(void *arg) {
+    worker_arg_t *w = arg;
+    job_t *job = w->job;
+    int first, last;
+    stripBounds(job, w->id, &first, &last);
+    partialInit(&job->partials[w->id]);
+    scanRows(&job->v, job->ops, first, last, &job->partials[w->id]);
+    return NULL;
+}
+
+/* static strips, each worker merges into the shared result under a mutex */
+static void *mutexWorker(void *arg) {
+    worker_arg_t *w = arg;
+    job_t *job = w->job;
+    int first, last;
+    partial_t mine;
+    stripBounds(job, w->id, &first, &last);
+    partialInit(&mine);
+    scanRows(&job->v, job->ops, first, last, &mine);
+    pthread_mutex_lock(&job->lock);
+    partialMerge(&job->result, &mine);
+    pthread_mutex_unlock(&job->lock);
+    return NULL;
+}
+
+/* bag of tasks, workers fetch chunk rows at a time from a shared counter */
+static void *bagWorker(void *arg) {
+    worker_arg_t *w = arg;
+    job_t *job = w->job;
+    partial_t mine;
+    partialInit(&mine);
+    while (true) {
+        int row = __sync_fetch_and_add(&job->nextRow, job->chunk);
+        if (row >= job->v.rows)
+            break;
+        int last = row + job->chunk < job->v.rows ? row + job->chunk : job->v.rows;
+        scanRows(&job->v, job->ops, row, last, &mine);
+    }
+    pthread_mutex_lock(&job->lock);
+    partialMerge(&job->result, &mine);
+    pthread_mutex_unlock(&job->lock);
+    return NULL;
+}
+
+/* start routine of the spawned workers, they end with the call so their
+   mask is not restored */
+static void *pinnedWorker(void *arg) {
+    worker_arg_t *w = arg;
+    topo_pin(w->job->affinity, (int)w->id, NULL);
+    return w->body(arg);
+}
+
+/* worker 0 runs on the calling thread */
+static int runPthreads(job_t *job, void *(*worker)(void *)) {
+    pthread_t *workerid = malloc(job->numWorkers * sizeof(pthread_t));
+    worker_arg_t *args = malloc(job->numWorkers * sizeof(worker_arg_t));
+    pthread_attr_t attr;
+    int started = 1, err = 0, pinned;
+    cpu_set_t saved;
+    if (workerid == NULL || args == NULL) {
+        free(workerid);
+        free(args);
+        errno = ENOMEM;
+        return -1;
+    }
+    pthread_attr_init(&attr);
+    pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM);
+    for (long w = 0; w < job->numWorkers; w++) {
+        args[w].job = job;
+        args[w].id = w;
+        args[w].body = worker;
+    }
+    for (; started < job->numWorkers; started++)
+        if ((err = pthread_create(&workerid[started], &attr, pinnedWorker, &args[started])) != 0)
+            break;
+    pinned = topo_pin(job->affinity, 0, &saved) == 1;
+    worker(&args[0]);
+    if (pinned)
+        topo_restore(&saved);
+    for (int w = 1; w < started; w++)
+        pthread_join(workerid[w], NULL);
+    pthread_attr_destroy(&attr);
+    free(workerid);
+    free(args);
+    if (err != 0) {
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+/* OpenMP parallel for over rows with a runtime schedule, each thread keeps
+   its own partial and merges once */
+static void runOmp(job_t *job, mr_schedule_t schedule, int chunk) {
+    omp_sched_t kinds[] = { omp_sched_static, omp_sched_static, omp_sched_dynamic, omp_sched_guided };
+    omp_set_schedule(kinds[schedule], chunk);
+    #pragma omp parallel num_threads(job->numWorkers)
+    {
+        cpu_set_t saved;
+        int pinned = topo_pin(job->affinity, omp_get_thread_num(), &saved) == 1;
+        partial_t mine;
+        partialInit(&mine);
+        #pragma omp for schedule(runtime) nowait
+        for (int i = 0; i < job->v.rows; i++)
+            scanRows(&job->v, job->ops, i, i + 1, &mine);
+        #pragma omp critical
+        partialMerge(&job->result, &mine);
+        if (pinned)
+            topo_restore(&saved);
+    }
+}
+
+/* split the block into quadrants down to a leaf, quadrants run as tasks
+   and are merged in row-major order on the way back up */
+static void blockReduce(const job_t *job, int row, int col, int rows, int cols, partial_t *out) {
+    if ((long)rows * cols <= job->chunk) {
+        mr_view_t leaf = mr_subview(job->v, row, col, rows, cols);
+        partialInit(out);
+        scanRows(&leaf, job->ops, 0, rows, out);
+        if (out->minRow != INT_MAX) { out->minRow += row; out->minCol += col; }
+        if (out->maxRow != INT_MAX) { out->maxRow += row; out->maxCol += col; }
+        return;
+    }
+    int topRows = (rows > 1) ? rows / 2 : rows;
+    int leftCols = (cols > 1) ? cols / 2 : cols;
+    partial_t parts[4];
+    int n = 0;
+    for (int qi = 0; qi < 2; qi++) {
+        for (int qj = 0; qj < 2; qj++) {
+            int qr = qi ? rows - topRows : topRows;
+            int qc = qj ? cols - leftCols : leftCols;
+            if (qr == 0 || qc == 0)
+                continue;
+            partial_t *p = &parts[n++];
+            #pragma omp task firstprivate(qi, qj, qr, qc, p) if((long)rows * cols > 16L * job->chunk)
+            blockReduce(job, row + (qi ? topRows : 0), col + (qj ? leftCols : 0), qr, qc, p);
+        }
+    }
+    #pragma omp taskwait
+    *out = parts[0];
+    for (int q = 1; q < n; q++)
+        partialMerge(out, &parts[q]);
+}
+
+static void runTasks(job_t *job) {
+    if (job->chunk <= 1)
+        job->chunk = LEAF_ELEMS;
+    #pragma omp parallel num_threads(job->numWorkers)
+    {
+        cpu_set_t saved;
+        int pinned = topo_pin(job->affinity, omp_get_thread_num(), &saved) == 1;
+        #pragma omp single
+        blockReduce(job, 0, 0, job->v.rows, job->v.cols, &job->result);
+        if (pinned)
+            topo_restore(&saved);
+    }
+}
+
+static int onlineCpus(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n < 1 ? 1 : (int)n;
+}
+
+/* TUNING TABLE */
+static const char *tablePath(const char *path) {
+    if (path != NULL)
+        return path;
+    path = getenv("MATRIXSUM_TUNING");
+    return path ? path : "tuning.txt";
+}
+
+static int readTable(const char *path, entry_t out[]) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        return 0;
+    char line[256], backend[32], schedule[32];
+    int n = 0;
+    while (n < MAXENTRIES && fgets(line, sizeof(line), fp)) {
+        entry_t *e = &out[n];
+        if (line[0] == '#')
+            continue;
+        if (sscanf(line, "%d %31s %d %31s %d %lf", &e->size, backend, &e->config.threads,
+                   schedule, &e->config.chunk, &e->seconds) != 6)
+            continue;
+        int b = mr_parse_backend(backend);
+        int s = mr_parse_schedule(schedule);
+        if (b <= MR_AUTO || s < 0)
+            continue;
+        e->config.backend = (mr_backend_t)b;
+        e->config.schedule = (mr_schedule_t)s;
+        n++;
+    }
+    fclose(fp);
+    return n;
+}
+
+static void loadDefaultTable(void) {
+    pthread_rwlock_wrlock(&tableLock);
+    tableSize = readTable(tablePath(NULL), table);
+    pthread_rwlock_unlock(&tableLock);
+}
+
+static int writeTable(const char *path, const entry_t t[], int n) {
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL)
+        return -1;
+    fprintf(fp, "# matrixSum tuning table, fastest configuration per size\n");
+    fprintf(fp, "# cpus %d\n", onlineCpus());
+    fprintf(fp, "# size backend threads schedule chunk medianSec\n");
+    for (int i = 0; i < n; i++)
+        fprintf(fp, "%d %s %d %s %d %g\n", t[i].size, mr_backend_name(t[i].config.backend),
+                t[i].config.threads, mr_schedule_name(t[i].config.schedule),
+                t[i].config.chunk, t[i].seconds);
+    return fclose(fp);
+}
+
+/* the entry whose element count is closest in ratio to rows x cols */
+mr_config_t mr_auto_config(int rows, int cols) {
+    mr_config_t config = { MR_OMP, 0, MR_SCHED_STATIC, 0 };
+    double elems = (double)rows * cols;
+    double bestDist = 0;
+    pthread_once(&tableOnce, loadDefaultTable);
+    pthread_rwlock_rdlock(&tableLock);
+    for (int i = 0; i < tableSize; i++) {
+        double ratio = (double)table[i].size * table[i].size / (elems > 0 ? elems : 1);
+        double dist = ratio > 1 ? ratio : 1 / ratio;
+        if (i == 0 || dist < bestDist) {
+            config = table[i].config;
+            bestDist = dist;
+        }
+    }
+    pthread_rwlock_unlock(&tableLock);
+    return config;
+}
+
+/* REDUCTION */
+int mr_reduce(const mr_request_t *req, mr_result_t *res) {
+    const mr_view_t *v = &req->view;
+    if (v->data == NULL || v->rows < 1 || v->cols < 1 || v->stride < (size_t)v->cols ||
+        (req->ops & MR_ALL) == 0 || (req->ops & ~MR_ALL) != 0 ||
+        (unsigned)req->config.backend > MR_TASKS || (unsigned)req->config.schedule > MR_SCHED_GUIDED) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    mr_config_t c = req->config;
+    if (c.backend == MR_AUTO)
+        c = mr_auto_config(v->rows, v->cols);
+    if (c.threads < 1) c.threads = onlineCpus();
+    if (c.threads > v->rows) c.threads = v->rows;
+    if (c.backend == MR_SEQ) c.threads = 1;
+    if (c.backend == MR_OMP && c.schedule == MR_SCHED_NONE) c.schedule = MR_SCHED_STATIC;
+    if (c.backend != MR_OMP) c.schedule = MR_SCHED_NONE;
+
+    job_t job;
+    job.v = *v;
+    job.ops = req->ops;
+    job.numWorkers = c.threads;
+    job.chunk = c.chunk > 0 ? c.chunk : 1;
+    job.affinity = req->affinity;
+    job.nextRow = 0;
+    job.partials = NULL;
+    partialInit(&job.result);
+    pthread_mutex_init(&job.lock, NULL);
+
+    int status = 0;
+    double start = omp_get_wtime();
+    switch (c.backend) {
+    case MR_SEQ:
+        scanRows(&job.v, job.ops, 0, v->rows, &job.result);
+        break;
+    case MR_STRIPS:
+        job.partials = malloc(job.numWorkers * sizeof(partial_t));
+        if (job.partials == NULL) {
+            errno = ENOMEM;
+            status = -1;
+            break;
+        }
+        status = runPthreads(&job, stripsWorker);
+        for (int w = 0; status == 0 && w < job.numWorkers; w++)
+            partialMerge(&job.result, &job.partials[w]);
+        free(job.partials);
+        break;
+    case MR_MUTEX:
+        status = runPthreads(&job, mutexWorker);
+        break;
+    case MR_BAG:
+        status = runPthreads(&job, bagWorker);
+        break;
+    case MR_TASKS:
+        job.chunk = c.chunk;
+        runTasks(&job);
+        break;
+    default:
+        runOmp(&job, c.schedule, c.chunk);
+        break;
+    }
+    double end = omp_get_wtime();
+    pthread_mutex_destroy(&job.lock);
+    if (status != 0)
+        return -1;
+
+    memset(res, 0, sizeof(*res));
+    res->sum = (req->ops & MR_SUM) ? job.result.sum : 0;
+    if (req->ops & MR_MIN) {
+        res->min = job.result.min; res->minRow = job.result.minRow; res->minCol = job.result.minCol;
+    }
+    if (req->ops & MR_MAX) {
+        res->max = job.result.max; res->maxRow = job.result.maxRow; res->maxCol = job.result.maxCol;
+    }
+    res->seconds = end - start;
+    res->used = c;
+    return 0;
+}
+
+/* ASYNC */
+static void *futureMain(void *arg) {
+    mr_future_t *f = arg;
+    f->status = mr_reduce(&f->req, &f->res);
+    f->err = errno;
+    __sync_synchronize();
+    f->done = 1;
+    return NULL;
+}
+
+mr_future_t *mr_reduce_async(const mr_request_t *req) {
+    mr_future_t *f = calloc(1, sizeof(*f));
+    if (f == NULL)
+        return NULL;
+    f->req = *req;
+    int err = pthread_create(&f->thread, NULL, futureMain, f);
+    if (err != 0) {
+        free(f);
+        errno = err;
+        return NULL;
+    }
+    return f;
+}
+
+int mr_ready(mr_future_t *f) {
+    int done = f->done;
+    __sync_synchronize();
+    return done;
+}
+
+int mr_wait(mr_future_t *f, mr_result_t *res) {
+    pthread_join(f->thread, NULL);
+    int status = f->status;
+    if (status == 0)
+        *res = f->res;
+    else
+        errno = f->err;
+    free(f);
+    return status;
+}
+
+/* TUNING */
+/* every configuration worth trying on a machine with cpus cores */
+static int candidates(mr_config_t out[], int max, int cpus) {
+    int n = 0;
+    if (n < max) {
+        mr_config_t seq = { MR_SEQ, 1, MR_SCHED_NONE, 0 };
+        out[n++] = seq;
+    }
+    for (int t = 1; ; t *= 2) {
+        if (t > cpus) t = cpus;
+        mr_config_t list[] = {
+            { MR_STRIPS, t, MR_SCHED_NONE, 0 },
+            { MR_MUTEX,  t, MR_SCHED_NONE, 0 },
+            { MR_BAG,    t, MR_SCHED_NONE, 1 },
+            { MR_BAG,    t, MR_SCHED_NONE, 16 },
+            { MR_OMP,    t, MR_SCHED_STATIC, 0 },
+            { MR_OMP,    t, MR_SCHED_DYNAMIC, 16 },
+            { MR_OMP,    t, MR_SCHED_GUIDED, 0 },
+            { MR_TASKS,  t, MR_SCHED_NONE, 0 },
+        };
+        for (int i = 0; i < (int)(sizeof(list) / sizeof(list[0])) && n < max; i++)
+            out[n++] = list[i];
+        if (t == cpus)
+            break;
+    }
+    return n;
+}
+
+int mr_tune(int maxSize, const char *path, FILE *log) {
+    int sizes[] = { 100, 250, 500, 1000, 2000, 4000, 8000, 10000 };
+    mr_config_t configs[256];
+    int numConfigs = candidates(configs, 256, onlineCpus());
+    entry_t found[MAXENTRIES];
+    int n = 0;
+
+    int *matrix = malloc((size_t)maxSize * maxSize * sizeof(int));
+    if (matrix == NULL)
+        return -1;
+    unsigned seed = (unsigned)time(NULL);
+    for (int s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])) && sizes[s] <= maxSize; s++) {
+        int size = sizes[s];
+        for (size_t k = 0; k < (size_t)size * size; k++)
+            matrix[k] = rand_r(&seed) % 999;
+        mr_request_t req = { mr_view(matrix, size, size), MR_ALL, { MR_SEQ, 1, MR_SCHED_NONE, 0 }, TOPO_DEFAULT };
+        entry_t *best = &found[n++];
+        best->size = size;
+        best->seconds = -1;
+        for (int c = 0; c < numConfigs; c++) {
+            double times[NUMRUNS];
+            mr_result_t res;
+            req.config = configs[c];
+            for (int run = 0; run < NUMRUNS; run++) {
+                if (mr_reduce(&req, &res) != 0) {
+                    free(matrix);
+                    return -1;
+                }
+                times[run] = res.seconds;
+            }
+            double med = bm_median(times, NUMRUNS);
+            if (best->seconds < 0 || med < best->seconds) {
+                best->config = res.used;
+                best->seconds = med;
+            }
+        }
+        if (log != NULL)
+            fprintf(log, "size %d: %s with %d threads (%s, chunk %d) in %g sec\n", size,
+                    mr_backend_name(best->config.backend), best->config.threads,
+                    mr_schedule_name(best->config.schedule), best->config.chunk, best->seconds);
+    }
+    free(matrix);
+
+    if (writeTable(tablePath(path), found, n) != 0)
+        return -1;
+    pthread_once(&tableOnce, loadDefaultTable);
+    pthread_rwlock_wrlock(&tableLock);
+    memcpy(table, found, n * sizeof(entry_t));
+    tableSize = n;
+    pthread_rwlock_unlock(&tableLock);
+    return n;
+}
@@ -0,0 +1,106 @@
+/* matrix reduction library
+
+   One request/result API over the sum, min and max reductions that the
+   homework programs implement separately: sequential, static pthread strips
+   (HW1/pb1/matrixSum.c), strips merging under a mutex
+   (HW1/pb1/b_noBarriersNoArray.c), a bag of rows (HW1/pb1/c_bagOfTasks.c),
+   an OpenMP parallel for (HW2/pb1/matrixSum-openmp.c) and the recursive
+   quadrant reduction on OpenMP tasks. MR_AUTO picks the configuration from
+   the tuning table written by mr_tune().
+
+   There is no global state besides the lazily loaded tuning table, so
+   mr_reduce() can be called from several threads at once. Workers are
+   pinned by the request's affinity policy (see topology.h) for the length
+   of the call; threads that outlive it, the caller and OpenMP pool
+   threads, get their previous mask back.
+
+   build:
+     gcc -O2 -fopenmp -c matrixReduce.c topology.c
+     gcc -O2 -fopenmp -o prog prog.c matrixReduce.o topology.o -lpthread
+*/
+#ifndef MATRIX_REDUCE_H
+#define MATRIX_REDUCE_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "topology.h"
+
+/* a read-only window of rows x cols ints, stride is the distance in ints
+   between the starts of two consecutive rows */
+typedef struct {
+    const int *data;
+    int rows, cols;
+    size_t stride;
+} mr_view_t;
+
+/* operation set */
+#define MR_SUM 1
+#define MR_MIN 2
+#define MR_MAX 4
+#define MR_ALL (MR_SUM | MR_MIN | MR_MAX)
+
+typedef enum { MR_AUTO, MR_SEQ, MR_STRIPS, MR_MUTEX, MR_BAG, MR_OMP, MR_TASKS } mr_backend_t;
+typedef enum { MR_SCHED_NONE, MR_SCHED_STATIC, MR_SCHED_DYNAMIC, MR_SCHED_GUIDED } mr_schedule_t;
+
+/* threads 0 means one per online cpu. for MR_BAG chunk is the number of
+   rows taken per fetch, for MR_OMP it is the OpenMP schedule chunk and for
+   MR_TASKS the number of elements in a leaf block (0: 4096) */
+typedef struct {
+    mr_backend_t backend;
+    int threads;
+    mr_schedule_t schedule;
+    int chunk;
+} mr_config_t;
+
+typedef struct {
+    mr_view_t view;
+    unsigned ops;
+    mr_config_t config;
+    topo_policy_t affinity; /* TOPO_DEFAULT (0) takes $AFFINITY */
+} mr_request_t;
+
+/* min and max positions are the first occurrence in row-major order, fields
+   of operations that were not requested are left at 0 */
+typedef struct {
+    long long sum;
+    int min, minRow, minCol;
+    int max, maxRow, maxCol;
+    double seconds;     /* wall time of the reduction itself */
+    mr_config_t used;   /* configuration that actually ran */
+} mr_result_t;
+
+typedef struct mr_future mr_future_t;
+
+/* whole matrix view over a contiguous rows x cols array */
+mr_view_t mr_view(const int *data, int rows, int cols);
+/* rows [row, row+rows) and cols [col, col+cols) of another view */
+mr_view_t mr_subview(mr_view_t v, int row, int col, int rows, int cols);
+
+/* returns 0, or -1 with errno set to EINVAL for a bad request or to the
+   error of a failed thread creation */
+int mr_reduce(const mr_request_t *req, mr_result_t *res);
+
+/* starts the reduction on its own thread; the view must stay valid until
+   mr_wait() returns. returns NULL with errno set on failure */
+mr_future_t *mr_reduce_async(const mr_request_t *req);
+/* nonzero once the result is available */
+int mr_ready(mr_future_t *f);
+/* blocks for the result and releases the future, returns as mr_reduce() */
+int mr_wait(mr_future_t *f, mr_result_t *res);
+
+/* times every candidate configuration on square matrices up to maxSize,
+   writes the fastest per size to path (NULL: $MATRIXSUM_TUNING or
+   tuning.txt) and makes it the table used by MR_AUTO. progress goes to log
+   if it is not NULL. returns the number of entries or -1 */
+int mr_tune(int maxSize, const char *path, FILE *log);
+/* configuration MR_AUTO would use for a rows x cols matrix */
+mr_config_t mr_auto_config(int rows, int cols);
+
+const char *mr_backend_name(mr_backend_t b);
+const char *mr_schedule_name(mr_schedule_t s);
+/* -1 if the name is unknown */
+int mr_parse_backend(const char *name);
+int mr_parse_schedule(const char *name);
+
+#endif
@@ -0,0 +1,1780 @@
+/* parallel sorting library, see parallelSort.h */
+#include "parallelSort.h"
+#include "radixSort.h"
+#include "workSteal.h"
+
+#include <omp.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <strings.h>
+#include <stdint.h>
+#include <errno.h>
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+/* SEQ_CUTOFF: ranges up to this many keys end the recursion in the leaf
+   sort. it depends on the key type and on what the leaf sort can use */
+#define SEQ_CUTOFF_INT 64       /* ints with the AVX2 network */
+#define SEQ_CUTOFF_SCALAR 24    /* any key with insertion sort only */
+#define NETWORK_MIN 8           /* smaller leaves are insertion sorted */
+#define NINTHER_MIN 128     /* from this size the pivot is a median of medians */
+#define PARTIAL_MOVES 8     /* shifts a partial insertion sort may make */
+#define OFFSETS 64          /* values per block of the BlockQuicksort kernel */
+#define RADIX_MIN (1L << 16)    /* smaller arrays are never radix sorted */
+#define RADIX_PASS_LEVELS 6     /* quicksort levels that cost as much as a radix pass */
+#define RADIX_MIN_DESCENTS 64   /* with fewer than 1 in this many descents the quicksort runs */
+#define COUNT_MIN 4096          /* smaller arrays are never counting sorted */
+#define COUNT_MAX_SPAN (1L << 16) /* most counters per thread */
+#define COUNT_DENSITY 4         /* keys per counter a counting sort needs at least */
+#define PROFILE_PAIRS 1024      /* most adjacent pairs the chooser samples */
+#define PROFILE_STRIDE 32       /* and at least this many keys per pair */
+#define MERGE_CUTOFF 8192       /* smaller merges are not split among tasks */
+#define MERGE_RUN 4096          /* merge sort ranges up to this size are quicksorted */
+#define NATURAL_MAX_RUNS 16     /* more presorted runs than this are not merged */
+#define NATURAL_MIN_SHARE 8     /* runs are looked for when under 1 in this many sampled pairs turns */
+#define CALIBRATE_KEYS 4096     /* keys sorted once to measure the cost per key */
+#define TASK_GRAIN_NS 20000.0   /* work a task carries at least, some 20 times what it costs */
+#define TASK_SLACK 16           /* tasks per thread the cutoff leaves room for */
+#define TASK_CAP 32             /* most outstanding quicksort tasks per thread */
+#define GATHER_BLOCK 4096       /* positions whose columns ps_gather moves together */
+
+static const char *kernelNames[] = { "auto", "hoare", "block", "avx512" };
+static const char *algorithmNames[] = { "auto", "quick", "radix", "count", "merge" };
+
+/* what one thread did in an instrumented sort, a cache line each */
+typedef struct {
+    long created, inlined;
+    int maxDepth;
+    int running;        /* clocks started and not stopped, nested by continuations */
+    double busy;        /* seconds of work */
+    double since;       /* when the current stretch of work began */
+    char pad[24];
+} probe_t;
+
+/* settings of one sort, shared by all its tasks */
+typedef struct {
+    ps_kernel_t kernel;
+    int cutoff;         /* SEQ_CUTOFF of this sort */
+    bool network;       /* leaves may use the AVX2 network */
+    const int *base;    /* the whole array, random draws depend on offsets into it */
+    uint64_t seed;
+    long taskCutoff;    /* smaller ranges are not split into tasks */
+    int maxTaskDepth;   /* nor are ranges deeper in the recursion */
+    long maxPending;    /* nor while this many tasks are outstanding */
+    long *pending;      /* tasks created and not finished */
+    probe_t *probe;     /* one per thread, NULL when not instrumented */
+    ws_pool_t *pool;    /* runs the tasks instead of OpenMP when not NULL */
+    int poolThreads;
+} sorter_t;
+
+/* one cooperative partition of a[0..n) around pivot */
+typedef struct {
+    int *a;
+    long n;
+    int pivot;
+    ps_kernel_t kernel;         /* for the leftover middle */
+    long numBlocks;             /* whole blocks in the range */
+    long leftTaken, rightTaken; /* blocks claimed from each end */
+    long *leftOpen, *rightOpen; /* blocks a task stopped in the middle of */
+    int numLeftOpen, numRightOpen;
+    bool swapped;               /* some value had to move */
+    probe_t *probe;
+    omp_lock_t lock;
+} split_t;
+
+static inline void swap(int *a, int *b) {
+    int t = *a;
+    *a = *b;
+    *b = t;
+}
+
+static void swapBlocks(int *a, int *b) {
+    for (int k = 0; k < PS_BLOCK; k++)
+        swap(&a[k], &b[k]);
+}
+
+/* the worker of the pool, or the OpenMP thread, running the caller */
+static inline int threadNum(void) {
+    int w = ws_worker();
+    return w >= 0 ? w : omp_get_thread_num();
+}
+
+/* the busy time of a thread runs while it works on a sort and stops while
+   it waits in a taskwait, where it may run other tasks, which count their
+   own time. a continuation a task runs inline nests in its time */
+static inline void clockStart(probe_t *probe) {
+    if (probe != NULL && probe[threadNum()].running++ == 0)
+        probe[threadNum()].since = omp_get_wtime();
+}
+
+static inline void clockStop(probe_t *probe) {
+    if (probe != NULL) {
+        probe_t *p = &probe[threadNum()];
+        if (--p->running == 0)
+            p->busy += omp_get_wtime() - p->since;
+    }
+}
+
+/* the splitmix64 finalizer. as a counter-based generator the k-th value
+   is a function of k alone, so tasks draw without sharing any state */
+static inline uint64_t mix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+/* draw k of the range a[0..n): a random index in [0, n) that only
+   depends on the seed and the bounds of the range, not on the thread or
+   the order the tasks run in */
+static long randomIndex(const int *a, long n, int k, const sorter_t *s) {
+    uint64_t x = mix64(s->seed ^ mix64(((uint64_t)(a - s->base) << 8 | (uint64_t)k) ^ mix64((uint64_t)n)));
+    return (long)(((unsigned __int128)x * (uint64_t)n) >> 64);
+}
+
+/* KERNELS
+   each moves the values < pivot of a[0..n) to the front and returns their
+   count. the Hoare loop branches on every value and mispredicts about
+   every second one on random input. the block kernel records misplaced
+   values as offsets with branch-free code and swaps them pairwise, and
+   the compress kernel does the same 16 values at a time with AVX-512,
+   falling back to the block kernel without AVX-512F.
+   HW2/pb2/partitionBench.c counts the branch misses per value of each */
+
+/* Hoare pass */
+static long partitionHoare(int *a, long n, int pivot) {
+    long i = 0, j = n - 1;
+    while (true) {
+        while (i <= j && a[i] < pivot) i++;
+        while (i <= j && a[j] >= pivot) j--;
+        if (i >= j)
+            return i;
+        swap(&a[i++], &a[j--]);
+    }
+}
+
+/* BlockQuicksort. the comparison result only decides whether the offset
+   counter moves, never which code runs, so random input costs no
+   mispredictions. a left and a right block are scanned when their offsets
+   run out, the recorded pairs are swapped, and a block whose misplaced
+   values are all gone is done. the < 2 blocks left in the middle take a
+   Hoare pass */
+static long partitionBlock(int *a, long n, int pivot) {
+    unsigned char offL[OFFSETS], offR[OFFSETS];
+    int numL = 0, numR = 0, startL = 0, startR = 0;
+    long l = 0, r = n;
+    while (r - l >= 2 * OFFSETS) {
+        if (numL == 0) {
+            startL = 0;
+            for (int i = 0; i < OFFSETS; i++) {
+                offL[numL] = (unsigned char)i;
+                numL += a[l + i] >= pivot;
+            }
+        }
+        if (numR == 0) {
+            startR = 0;
+            for (int i = 0; i < OFFSETS; i++) {
+                offR[numR] = (unsigned char)i;
+                numR += a[r - 1 - i] < pivot;
+            }
+        }
+        int num = numL < numR ? numL : numR;
+        for (int k = 0; k < num; k++)
+            swap(&a[l + offL[startL + k]], &a[r - 1 - offR[startR + k]]);
+        numL -= num; numR -= num;
+        startL += num; startR += num;
+        if (numL == 0) l += OFFSETS;
+        if (numR == 0) r -= OFFSETS;
+    }
+    return l + partitionHoare(a + l, r - l, pivot);
+}
+
+#ifdef __x86_64__
+/* compress-store partition. the first and last 16 values are held in
+   registers, which leaves 32 free slots; each step reads 16 values from the
+   end with less free room, then writes the ones < pivot at the left write
+   position and the rest just below the right one, so the free slots never
+   run out */
+__attribute__((target("avx512f")))
+static inline void storeSides(int *a, __m512i v, __m512i pv, long *wl, long *wr, __mmask16 valid) {
+    __mmask16 lt = _mm512_mask_cmplt_epi32_mask(valid, v, pv);
+    __mmask16 ge = valid & ~lt;
+    _mm512_mask_compressstoreu_epi32(a + *wl, lt, v);
+    *wl += __builtin_popcount(lt);
+    *wr -= __builtin_popcount(ge);
+    _mm512_mask_compressstoreu_epi32(a + *wr, ge, v);
+}
+
+__attribute__((target("avx512f")))
+static long partitionCompress(int *a, long n, int pivot) {
+    if (n < 64)
+        return partitionHoare(a, n, pivot);
+    __m512i pv = _mm512_set1_epi32(pivot);
+    __m512i first = _mm512_loadu_si512(a);
+    __m512i last = _mm512_loadu_si512(a + n - 16);
+    long left = 16, right = n - 16;     /* unread values are a[left..right) */
+    long wl = 0, wr = n;                /* written: a[0..wl) < pivot, a[wr..n) >= */
+    while (right - left >= 16) {
+        __m512i v;
+        if (left - wl <= wr - right) {
+            v = _mm512_loadu_si512(a + left);
+            left += 16;
+        } else {
+            right -= 16;
+            v = _mm512_loadu_si512(a + right);
+        }
+        storeSides(a, v, pv, &wl, &wr, 0xFFFF);
+    }
+    __mmask16 rest = (__mmask16)((1u << (right - left)) - 1);
+    __m512i v = _mm512_maskz_loadu_epi32(rest, a + left);
+    storeSides(a, v, pv, &wl, &wr, rest);
+    storeSides(a, first, pv, &wl, &wr, 0xFFFF);
+    storeSides(a, last, pv, &wl, &wr, 0xFFFF);
+    return wl;
+}
+#endif
+
+const char *ps_kernel_name(ps_kernel_t k) {
+    return kernelNames[k];
+}
+
+int ps_parse_kernel(const char *name) {
+    for (int i = 0; i < (int)(sizeof(kernelNames) / sizeof(kernelNames[0])); i++)
+        if (strcasecmp(name, kernelNames[i]) == 0)
+            return i;
+    return -1;
+}
+
+const char *ps_algorithm_name(ps_algorithm_t a) {
+    return algorithmNames[a];
+}
+
+int ps_parse_algorithm(const char *name) {
+    for (int i = 0; i < (int)(sizeof(algorithmNames) / sizeof(algorithmNames[0])); i++)
+        if (strcasecmp(name, algorithmNames[i]) == 0)
+            return i;
+    return -1;
+}
+
+static bool hasCompress(void) {
+#ifdef __x86_64__
+    return __builtin_cpu_supports("avx512f");
+#else
+    return false;
+#endif
+}
+
+ps_kernel_t ps_resolve_kernel(ps_kernel_t k) {
+    if (k == PS_KERNEL_AUTO)
+        return hasCompress() ? PS_KERNEL_COMPRESS : PS_KERNEL_BLOCK;
+    if (k == PS_KERNEL_COMPRESS && !hasCompress())
+        return PS_KERNEL_BLOCK;
+    return k;
+}
+
+/* sequential partition. values already on their side at both ends are
+   skipped first, so swapped stays false exactly when the range was
+   partitioned already */
+static long partitionSeq(int *a, long n, int pivot, bool *swapped, ps_kernel_t kernel) {
+    long i = 0, j = n;
+    while (i < j && a[i] < pivot) i++;
+    while (i < j && a[j - 1] >= pivot) j--;
+    if (i == j)
+        return i;
+    *swapped = true;
+    switch (kernel) {
+#ifdef __x86_64__
+    case PS_KERNEL_COMPRESS:
+        return i + partitionCompress(a + i, j - i, pivot);
+#endif
+    case PS_KERNEL_BLOCK:
+        return i + partitionBlock(a + i, j - i, pivot);
+    default:
+        return i + partitionHoare(a + i, j - i, pivot);
+    }
+}
+
+long ps_partition_kernel(int *a, long n, int pivot, ps_kernel_t k) {
+    bool swapped = false;
+    return partitionSeq(a, n, pivot, &swapped, ps_resolve_kernel(k));
+}
+
+/* PARALLEL PARTITION
+   a large range is split by tasks that claim PS_BLOCK values at a time
+   from both ends and neutralize a left block against a right one until
+   one of them is entirely on its side, so the first levels of the
+   recursion do not leave all threads but one idle. the few blocks left
+   half done are moved next to the middle and partitioned sequentially */
+
+/* next block from the left or right end as an element offset, -1 once the
+   two ends have met */
+static long claim(split_t *sp, bool left) {
+    long start = -1;
+    omp_set_lock(&sp->lock);
+    if (sp->leftTaken + sp->rightTaken < sp->numBlocks)
+        start = left ? sp->leftTaken++ * PS_BLOCK : sp->n - ++sp->rightTaken * PS_BLOCK;
+    omp_unset_lock(&sp->lock);
+    return start;
+}
+
+/* swaps misplaced values between a left and a right block until one of
+   them is done, then claims a replacement for it. a block still half done
+   when the claims run out is recorded for the cleanup */
+static void neutralize(split_t *sp) {
+    long left = -1, right = -1;
+    int i = 0, j = 0;
+    int pivot = sp->pivot;
+    bool swapped = false;
+    while (true) {
+        if (left < 0) {
+            if ((left = claim(sp, true)) < 0)
+                break;
+            i = 0;
+        }
+        if (right < 0) {
+            if ((right = claim(sp, false)) < 0)
+                break;
+            j = 0;
+        }
+        int *l = sp->a + left, *r = sp->a + right;
+        while (i < PS_BLOCK && j < PS_BLOCK) {
+            while (i < PS_BLOCK && l[i] < pivot) i++;
+            while (j < PS_BLOCK && r[j] >= pivot) j++;
+            if (i < PS_BLOCK && j < PS_BLOCK) {
+                swap(&l[i++], &r[j++]);
+                swapped = true;
+            }
+        }
+        if (i == PS_BLOCK) left = -1;
+        if (j == PS_BLOCK) right = -1;
+    }
+    omp_set_lock(&sp->lock);
+    if (left >= 0)
+        sp->leftOpen[sp->numLeftOpen++] = left / PS_BLOCK;
+    if (right >= 0)
+        sp->rightOpen[sp->numRightOpen++] = (sp->n - right) / PS_BLOCK - 1;
+    sp->swapped |= swapped;
+    omp_unset_lock(&sp->lock);
+}
+
+static int compareLong(const void *a, const void *b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+/* moves the open blocks among the taken ones to the slots nearest the
+   middle, swapping each with a finished block found there. blocks are
+   numbered from their own end of the range. returns whether any moved */
+static bool gatherOpen(int *a, long n, bool left, long taken, long *open, int numOpen) {
+    bool moved = false;
+    qsort(open, numOpen, sizeof(long), compareLong);
+    long slot = taken - 1;
+    for (int k = numOpen - 1, low = 0; k >= low; slot--) {
+        if (open[k] == slot) {      /* already in place */
+            k--;
+            continue;
+        }
+        /* slot holds a finished block, trade it for the farthest open one */
+        long from = open[low++];
+        int *x = left ? a + from * PS_BLOCK : a + n - (from + 1) * PS_BLOCK;
+        int *y = left ? a + slot * PS_BLOCK : a + n - (slot + 1) * PS_BLOCK;
+        swapBlocks(x, y);
+        moved = true;
+    }
+    return moved;
+}
+
+/* sets up the partition of a[0..n) by up to tasks neutralize tasks.
+   false without memory */
+static bool splitBegin(split_t *sp, int *a, long n, int pivot, ps_kernel_t kernel, int tasks, probe_t *probe) {
+    sp->a = a;
+    sp->n = n;
+    sp->pivot = pivot;
+    sp->kernel = kernel;
+    sp->numBlocks = n / PS_BLOCK;
+    sp->leftTaken = sp->rightTaken = 0;
+    sp->leftOpen = malloc(2 * tasks * sizeof(long));
+    if (sp->leftOpen == NULL)
+        return false;
+    sp->rightOpen = sp->leftOpen + tasks;
+    sp->numLeftOpen = sp->numRightOpen = 0;
+    sp->swapped = false;
+    sp->probe = probe;
+    omp_init_lock(&sp->lock);
+    return true;
+}
+
+/* after the neutralize tasks: the count of values < pivot */
+static long splitEnd(split_t *sp, bool *swapped) {
+    int *a = sp->a;
+    long n = sp->n;
+    /* everything outside the open blocks and the unclaimed remainder in
+       the middle is on its side already */
+    sp->swapped |= gatherOpen(a, n, true, sp->leftTaken, sp->leftOpen, sp->numLeftOpen);
+    sp->swapped |= gatherOpen(a, n, false, sp->rightTaken, sp->rightOpen, sp->numRightOpen);
+    long first = (sp->leftTaken - sp->numLeftOpen) * PS_BLOCK;
+    long last = n - (sp->rightTaken - sp->numRightOpen) * PS_BLOCK;
+    omp_destroy_lock(&sp->lock);
+    free(sp->leftOpen);
+    *swapped |= sp->swapped;
+    return first + partitionSeq(a + first, last - first, sp->pivot, swapped, sp->kernel);
+}
+
+static long partitionPar(int *a, long n, int pivot, bool *swapped, ps_kernel_t kernel, probe_t *probe) {
+    int tasks = omp_get_num_threads();
+    split_t sp;
+    if (!splitBegin(&sp, a, n, pivot, kernel, tasks, probe))
+        return partitionSeq(a, n, pivot, swapped, kernel);
+
+    for (int t = 0; t < tasks; t++) {
+        #pragma omp task shared(sp)
+        {
+            clockStart(sp.probe);
+            neutralize(&sp);
+            clockStop(sp.probe);
+        }
+    }
+    if (probe != NULL)
+        probe[threadNum()].created += tasks;
+    clockStop(probe);
+    #pragma omp taskwait
+    clockStart(probe);
+    return splitEnd(&sp, swapped);
+}
+
+static long partition(int *a, long n, int pivot, bool *swapped, ps_kernel_t kernel, probe_t *probe) {
+    if (n >= PS_PARALLEL_SPLIT && omp_in_parallel() && omp_get_num_threads() > 1)
+        return partitionPar(a, n, pivot, swapped, kernel, probe);
+    return partitionSeq(a, n, pivot, swapped, kernel);
+}
+
+long ps_partition(int *a, long n, int pivot) {
+    bool swapped = false;
+    return partition(a, n, pivot, &swapped, ps_resolve_kernel(PS_KERNEL_AUTO), NULL);
+}
+
+/* SMALL RANGES AND FALLBACKS */
+
+static void insertionSort(int *a, long n) {
+    for (long i = 1; i < n; i++) {
+        int v = a[i];
+        long j = i;
+        for (; j > 0 && a[j - 1] > v; j--)
+            a[j] = a[j - 1];
+        a[j] = v;
+    }
+}
+
+/* insertion sort that gives up after PARTIAL_MOVES shifted values, so a
+   nearly sorted range is finished in one pass and anything else costs
+   little. returns whether the range is sorted */
+static bool partialInsertionSort(int *a, long n) {
+    long moves = 0;
+    for (long i = 1; i < n; i++) {
+        if (a[i - 1] <= a[i])
+            continue;
+        int v = a[i];
+        long j = i;
+        for (; j > 0 && a[j - 1] > v; j--)
+            a[j] = a[j - 1];
+        a[j] = v;
+        moves += i - j;
+        if (moves > PARTIAL_MOVES)
+            return false;
+    }
+    return true;
+}
+
+static void siftDown(int *a, long n, long i) {
+    int v = a[i];
+    while (2 * i + 1 < n) {
+        long child = 2 * i + 1;
+        if (child + 1 < n && a[child + 1] > a[child])
+            child++;
+        if (a[child] <= v)
+            break;
+        a[i] = a[child];
+        i = child;
+    }
+    a[i] = v;
+}
+
+/* O(n log n) whatever the input, used once partitions keep coming out bad */
+static void heapSort(int *a, long n) {
+    for (long i = n / 2 - 1; i >= 0; i--)
+        siftDown(a, n, i);
+    for (long i = n - 1; i > 0; i--) {
+        swap(&a[0], &a[i]);
+        siftDown(a, i, 0);
+    }
+}
+
+/* AVX2 bitonic network for leaves of up to 64 ints. the leaf is loaded
+   into 1, 2, 4 or 8 registers of 8 lanes, padded with INT_MAX, and seen as
+   one list of 8 x registers values. every bitonic step compares value i
+   with value i ^ j: for j >= 8 that is a whole register against another,
+   for j < 8 a register against a lane permutation of itself, with a blend
+   that keeps the min or the max per lane. no step depends on the data */
+#ifdef __x86_64__
+__attribute__((target("avx2")))
+static void networkSort(int *a, long n) {
+    __m256i v[8];
+    int regs = 1;
+    while (regs * 8 < n)
+        regs *= 2;
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i pad = _mm256_set1_epi32(INT_MAX);
+    for (int r = 0; r < regs; r++) {
+        long count = n - r * 8;
+        count = count < 0 ? 0 : count > 8 ? 8 : count;
+        __m256i valid = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)count), lane);
+        v[r] = _mm256_blendv_epi8(pad, _mm256_maskload_epi32(a + r * 8, valid), valid);
+    }
+
+    for (int k = 2; k <= regs * 8; k *= 2) {
+        for (int j = k / 2; j > 0; j /= 2) {
+            if (j >= 8) {
+                int d = j / 8;
+                for (int r = 0; r < regs; r++) {
+                    if (r & d)
+                        continue;
+                    __m256i mn = _mm256_min_epi32(v[r], v[r | d]);
+                    __m256i mx = _mm256_max_epi32(v[r], v[r | d]);
+                    bool ascending = ((r * 8) & k) == 0;
+                    v[r] = ascending ? mn : mx;
+                    v[r | d] = ascending ? mx : mn;
+                }
+                continue;
+            }
+            __m256i jv = _mm256_set1_epi32(j);
+            __m256i upper = _mm256_cmpeq_epi32(_mm256_and_si256(lane, jv), jv);
+            __m256i partner = _mm256_xor_si256(lane, jv);
+            __m256i flip = _mm256_setzero_si256();
+            if (k < 8) {
+                /* direction changes within the register */
+                __m256i kv = _mm256_set1_epi32(k);
+                flip = _mm256_cmpeq_epi32(_mm256_and_si256(lane, kv), kv);
+            }
+            for (int r = 0; r < regs; r++) {
+                __m256i p = _mm256_permutevar8x32_epi32(v[r], partner);
+                __m256i mn = _mm256_min_epi32(v[r], p);
+                __m256i mx = _mm256_max_epi32(v[r], p);
+                /* the upper lane of a pair keeps the max when ascending */
+                __m256i takeMax = _mm256_xor_si256(upper, flip);
+                if (k >= 8 && ((r * 8) & k) != 0)
+                    takeMax = _mm256_xor_si256(takeMax, _mm256_set1_epi32(-1));
+                v[r] = _mm256_blendv_epi8(mn, mx, takeMax);
+            }
+        }
+    }
+
+    for (int r = 0; r < regs; r++) {
+        long count = n - r * 8;
+        count = count < 0 ? 0 : count > 8 ? 8 : count;
+        __m256i valid = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)count), lane);
+        _mm256_maskstore_epi32(a + r * 8, valid, v[r]);
+    }
+}
+#endif
+
+static bool hasNetwork(void) {
+#ifdef __x86_64__
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+/* base case of the recursion */
+static void leafSort(int *a, long n, const sorter_t *s) {
+#ifdef __x86_64__
+    if (s->network && n >= NETWORK_MIN) {
+        networkSort(a, n);
+        return;
+    }
+#endif
+    (void)s;
+    insertionSort(a, n);
+}
+
+/* PIVOTS */
+
+static inline void sort2(int *a, long i, long j) {
+    if (a[j] < a[i])
+        swap(&a[i], &a[j]);
+}
+
+static inline void sort3(int *a, long i, long j, long k) {
+    sort2(a, i, j);
+    sort2(a, j, k);
+    sort2(a, i, j);
+}
+
+/* median of 3, or the ninther of 9 spread samples for larger ranges, moved
+   to a[0]. dups is set when another sample equals it, a hint that the range
+   holds many copies of the pivot */
+static void choosePivot(int *a, long n, bool *dups) {
+    long mid = n / 2;
+    if (n >= NINTHER_MIN) {
+        sort3(a, 0, mid, n - 1);
+        sort3(a, 1, mid - 1, n - 2);
+        sort3(a, 2, mid + 1, n - 3);
+        sort3(a, mid - 1, mid, mid + 1);
+        *dups = a[mid - 1] == a[mid] || a[mid] == a[mid + 1];
+    } else {
+        sort3(a, 0, mid, n - 1);
+        *dups = a[0] == a[mid] || a[mid] == a[n - 1];
+    }
+    swap(&a[0], &a[mid]);
+}
+
+/* swaps the values choosePivot samples in a range that split badly with
+   random ones, so a crafted pattern cannot keep the pivots bad */
+static void breakPatterns(int *a, long n, const sorter_t *s) {
+    if (n <= SEQ_CUTOFF_SCALAR)
+        return;
+    long mid = n / 2;
+    long ninther[] = { 0, 1, 2, mid - 1, mid, mid + 1, n - 3, n - 2, n - 1 };
+    long median[] = { 0, mid, n - 1 };
+    long *samples = n >= NINTHER_MIN ? ninther : median;
+    int count = n >= NINTHER_MIN ? 9 : 3;
+    for (int k = 0; k < count; k++)
+        swap(&a[samples[k]], &a[randomIndex(a, n, k, s)]);
+}
+
+/* QUICKSORT */
+
+/* pdqsort over a[0..n). the pivot goes to a[0], the rest is split into
+   < pivot and >= pivot, and when the samples hinted at duplicates the
+   values equal to the pivot are gathered next to it in a second pass so
+   they are never looked at again. a split that moved nothing is
+   followed by a partial insertion sort of both sides, which finishes
+   sorted and nearly sorted input in linear time. after badAllowed
+   unbalanced splits the range is heap sorted. with parallel set, the left
+   side of a split becomes a task when spawnTask allows, and large splits
+   use the whole team. depth counts the splits above a[0..n) */
+static void quickSort(int *a, long n, int badAllowed, int depth, bool parallel, const sorter_t *s);
+
+/* after a[0..n) was split into [0, lt) < pivot, [lt, gt) equal and
+   [gt, n) greater: heap sorts the range on its last allowed bad split,
+   breaks the patterns of both sides on the others, and finishes both
+   sides when the split moved nothing and they are nearly sorted. returns
+   whether a[0..n) is sorted */
+static bool settleSplit(int *a, long n, long lt, long gt, bool swapped, int *badAllowed, const sorter_t *s) {
+    long leftN = lt, rightN = n - gt;
+    if ((leftN < n / 8 || rightN < n / 8) && gt - lt < n / 8) {
+        if (--*badAllowed == 0) {
+            heapSort(a, n);
+            return true;
+        }
+        breakPatterns(a, leftN, s);
+        breakPatterns(a + gt, rightN, s);
+        return false;
+    }
+    return !swapped && partialInsertionSort(a, leftN) && partialInsertionSort(a + gt, rightN);
+}
+
+/* whether the left side of a split, of n keys at depth, becomes a task:
+   it must be above the cutoff, not too deep, and the outstanding tasks
+   below the cap, which a task takes a place under as it is created */
+static bool spawnTask(long n, int depth, const sorter_t *s) {
+    if (n <= s->taskCutoff || depth >= s->maxTaskDepth)
+        return false;
+    long pending;
+    #pragma omp atomic capture
+    pending = ++*s->pending;
+    if (pending > s->maxPending) {
+        #pragma omp atomic
+        --*s->pending;
+        return false;
+    }
+    return true;
+}
+
+static void runTask(int *a, long n, int badAllowed, int depth, const sorter_t *s) {
+    clockStart(s->probe);
+    quickSort(a, n, badAllowed, depth, n > s->taskCutoff, s);
+    clockStop(s->probe);
+    #pragma omp atomic
+    --*s->pending;
+}
+
+static void quickSort(int *a, long n, int badAllowed, int depth, bool parallel, const sorter_t *s) {
+    ps_kernel_t kernel = s->kernel;
+    probe_t *probe = s->probe;
+    bool spawned = false;
+    while (n > s->cutoff) {
+        bool dups, swapped = false;
+        choosePivot(a, n, &dups);
+        int pivot = a[0];
+        /* the c values < pivot end up in a[1..c], so a[c] trades with it */
+        long lt = parallel ? partition(a + 1, n - 1, pivot, &swapped, kernel, probe)
+                           : partitionSeq(a + 1, n - 1, pivot, &swapped, kernel);
+        swap(&a[0], &a[lt]);
+        long gt = lt + 1;
+        if (dups) {
+            /* everything right of the pivot is >= it, so < pivot + 1 means equal */
+            bool ignored = false;
+            if (pivot == INT_MAX)
+                gt = n;
+            else
+                gt += parallel ? partition(a + gt, n - gt, pivot + 1, &ignored, kernel, probe)
+                               : partitionSeq(a + gt, n - gt, pivot + 1, &ignored, kernel);
+        }
+
+        long leftN = lt, rightN = n - gt;
+        if (settleSplit(a, n, lt, gt, swapped, &badAllowed, s)) {
+            n = 0;
+            break;
+        }
+
+        depth++;
+        if (probe != NULL && depth > probe[threadNum()].maxDepth)
+            probe[threadNum()].maxDepth = depth;
+        if (parallel) {
+            if (spawnTask(leftN, depth, s)) {
+                #pragma omp task firstprivate(a, leftN, badAllowed, depth)
+                runTask(a, leftN, badAllowed, depth, s);
+                spawned = true;
+                if (probe != NULL)
+                    probe[threadNum()].created++;
+            } else {
+                if (probe != NULL)
+                    probe[threadNum()].inlined++;
+                quickSort(a, leftN, badAllowed, depth, leftN > s->taskCutoff, s);
+            }
+            a += gt;
+            n = rightN;
+            parallel = n > s->taskCutoff;
+        } else if (leftN < rightN) {
+            /* recurse on the smaller side for a log n stack */
+            quickSort(a, leftN, badAllowed, depth, false, s);
+            a += gt;
+            n = rightN;
+        } else {
+            quickSort(a + gt, rightN, badAllowed, depth, false, s);
+            n = leftN;
+        }
+    }
+    leafSort(a, n, s);
+    /* tasks spawned for left sides finish before the range counts as sorted */
+    if (spawned) {
+        clockStop(probe);
+        #pragma omp taskwait
+        clockStart(probe);
+    }
+}
+
+static int log2Floor(long n) {
+    int log = 0;
+    while (n >>= 1)
+        log++;
+    return log;
+}
+
+/* MERGE SORT
+   stable, with a scratch array of n ints. runs of MERGE_RUN keys are
+   quicksorted in the L1 cache and larger ranges sort their halves on
+   tasks into the other array, alternating between the two so each level
+   moves the keys once. a merge is split among tasks at the co-rank of the
+   middle of its output down to MERGE_CUTOFF values */
+
+/* how many of the first k values of the merge of x and y come from x, so
+   that x[0..i) and y[0..k - i) are the first k values. keys of x win ties,
+   which keeps the merge stable */
+static long coRank(long k, const int *x, long nx, const int *y, long ny) {
+    long lo = k > ny ? k - ny : 0, hi = k < nx ? k : nx;
+    while (lo < hi) {
+        long i = lo + (hi - lo) / 2;
+        /* x[i] precedes y[k - i - 1], so more than i values come from x */
+        if (x[i] <= y[k - i - 1])
+            lo = i + 1;
+        else
+            hi = i;
+    }
+    return lo;
+}
+
+/* branch-free: which side a value comes from only decides the increments */
+static void mergeSeq(const int *x, long nx, const int *y, long ny, int *out) {
+    long i = 0, j = 0;
+    while (i < nx && j < ny) {
+        bool fromY = y[j] < x[i];
+        *out++ = fromY ? y[j] : x[i];
+        j += fromY;
+        i += !fromY;
+    }
+    memcpy(out, x + i, (nx - i) * sizeof(int));
+    memcpy(out + nx - i, y + j, (ny - j) * sizeof(int));
+}
+
+/* merges x and y into out. the output is halved at its middle, the
+   co-rank of which a binary search finds, and the first half becomes a
+   task, so a merge never leaves the team idle however the keys fall */
+static void mergePar(const int *x, long nx, const int *y, long ny, int *out) {
+    while (nx + ny > MERGE_CUTOFF) {
+        long k = (nx + ny) / 2;
+        long i = coRank(k, x, nx, y, ny);
+        #pragma omp task firstprivate(x, y, out, i, k)
+        mergePar(x, i, y, k - i, out);
+        x += i;
+        nx -= i;
+        y += k - i;
+        ny -= k - i;
+        out += k;
+    }
+    mergeSeq(x, nx, y, ny, out);
+    #pragma omp taskwait
+}
+
+/* sorts a[0..n) into a, or into the scratch b[0..n) with toScratch set.
+   the halves are sorted into the other array and merged back, so every
+   level moves the keys once and b is the only extra memory. runs of up to
+   MERGE_RUN keys fit the L1 cache and are quicksorted there, which saves
+   the merge levels that would each stream the whole array; equal ints
+   cannot be told apart, so that does not make the result less stable */
+static void mergeSort(int *a, int *b, long n, bool toScratch, bool parallel, const sorter_t *s) {
+    if (n <= MERGE_RUN) {
+        quickSort(a, n, log2Floor(n) + 1, 0, false, s);
+        if (toScratch)
+            memcpy(b, a, n * sizeof(int));
+        return;
+    }
+    long h = n / 2;
+    #pragma omp task if(parallel && h > PS_TASK_CUTOFF)
+    mergeSort(a, b, h, !toScratch, parallel && h > PS_TASK_CUTOFF, s);
+    mergeSort(a + h, b + h, n - h, !toScratch, parallel && n - h > PS_TASK_CUTOFF, s);
+    #pragma omp taskwait
+    const int *from = toScratch ? a : b;
+    int *to = toScratch ? b : a;
+    if (parallel)
+        mergePar(from, h, from + h, n - h, to);
+    else
+        mergeSeq(from, h, from + h, n - h, to);
+}
+
+/* WORK-STEALING POOL
+   the quicksort and the merge sort as tasks of a ws_pool_t. no task ever
+   waits: a split too large for one thread is started as neutralize tasks
+   whose continuation carries on with the range, and a merge sort range
+   merges its halves in the continuation of the tasks that sort them */
+
+/* a range of the quicksort on the pool and how far its split has got */
+typedef struct {
+    int *a;
+    long n;
+    int badAllowed, depth;
+    bool spawned;           /* holds a place under s->maxPending */
+    const sorter_t *s;
+    enum { QS_PIVOT, QS_LESS, QS_EQUAL, QS_SPLIT } stage;
+    int pivot;
+    bool dups, swapped, ignored;
+    long lt, gt;
+    long counted;           /* values below the bound of the last split */
+    split_t sp;
+    ws_join_t join;
+} wsquick_t;
+
+static void wsQuickSort(wsquick_t *q);
+
+static void wsNeutralize(void *arg) {
+    split_t *sp = arg;
+    clockStart(sp->probe);
+    neutralize(sp);
+    clockStop(sp->probe);
+}
+
+static void wsSplitDone(void *arg) {
+    wsquick_t *q = arg;
+    probe_t *probe = q->s->probe;
+    clockStart(probe);
+    q->counted = splitEnd(&q->sp, q->stage == QS_LESS ? &q->swapped : &q->ignored);
+    wsQuickSort(q);
+    clockStop(probe);
+}
+
+/* counts the values < pivot of a[0..n) into q->counted and returns false
+   or, for a range worth the whole pool, starts the cooperative split and
+   returns true, its continuation carrying on with q */
+static bool wsSplit(wsquick_t *q, int *a, long n, int pivot, bool *swapped) {
+    const sorter_t *s = q->s;
+    int tasks = s->poolThreads;
+    if (n >= PS_PARALLEL_SPLIT && tasks > 1 &&
+        splitBegin(&q->sp, a, n, pivot, s->kernel, tasks, s->probe)) {
+        if (s->probe != NULL)
+            s->probe[threadNum()].created += tasks;
+        ws_join_init(&q->join, wsSplitDone, q);
+        for (int t = 0; t < tasks; t++)
+            ws_spawn(&q->join, wsNeutralize, &q->sp);
+        ws_join_close(&q->join);
+        return true;
+    }
+    q->counted = partitionSeq(a, n, pivot, swapped, s->kernel);
+    return false;
+}
+
+static void wsQuickDone(wsquick_t *q) {
+    if (q->spawned) {
+        #pragma omp atomic
+        --*q->s->pending;
+    }
+    free(q);
+}
+
+static void wsQuickTask(void *arg) {
+    wsquick_t *q = arg;
+    probe_t *probe = q->s->probe;
+    clockStart(probe);
+    wsQuickSort(q);
+    clockStop(probe);
+}
+
+/* the left side of the split of q becomes a task when spawnTask allows.
+   otherwise the thread sorts it itself, still through the state machine
+   while it is above the cutoff, so its splits can be cooperative and its
+   own left sides tasks once places under the cap free up */
+static void wsSpawnLeft(wsquick_t *q) {
+    const sorter_t *s = q->s;
+    probe_t *probe = s->probe;
+    long leftN = q->lt;
+    bool spawned = spawnTask(leftN, q->depth, s);
+    wsquick_t *left = NULL;
+    if ((spawned || leftN > s->taskCutoff) && (left = malloc(sizeof(wsquick_t))) == NULL && spawned) {
+        #pragma omp atomic
+        --*s->pending;
+    }
+    if (left == NULL) {
+        if (probe != NULL)
+            probe[threadNum()].inlined++;
+        quickSort(q->a, leftN, q->badAllowed, q->depth, false, s);
+        return;
+    }
+    left->a = q->a;
+    left->n = leftN;
+    left->badAllowed = q->badAllowed;
+    left->depth = q->depth;
+    left->spawned = spawned;
+    left->s = s;
+    left->stage = QS_PIVOT;
+    if (!spawned) {
+        if (probe != NULL)
+            probe[threadNum()].inlined++;
+        wsQuickSort(left);
+        return;
+    }
+    if (probe != NULL)
+        probe[threadNum()].created++;
+    ws_spawn(NULL, wsQuickTask, left);
+}
+
+/* quickSort as a state machine over the stages of a split, which a
+   cooperative split suspends and its continuation resumes. frees q once
+   its range is sorted */
+static void wsQuickSort(wsquick_t *q) {
+    const sorter_t *s = q->s;
+    probe_t *probe = s->probe;
+    while (true) {
+        switch (q->stage) {
+        case QS_PIVOT:
+            if (q->n <= s->taskCutoff) {
+                quickSort(q->a, q->n, q->badAllowed, q->depth, false, s);
+                wsQuickDone(q);
+                return;
+            }
+            choosePivot(q->a, q->n, &q->dups);
+            q->pivot = q->a[0];
+            q->swapped = false;
+            q->stage = QS_LESS;
+            if (wsSplit(q, q->a + 1, q->n - 1, q->pivot, &q->swapped))
+                return;
+            break;
+        case QS_LESS:
+            /* the values < pivot are in a[1..lt], so a[lt] trades with it */
+            q->lt = q->counted;
+            swap(&q->a[0], &q->a[q->lt]);
+            q->gt = q->lt + 1;
+            q->stage = QS_SPLIT;
+            if (q->dups && q->pivot == INT_MAX) {
+                q->gt = q->n;
+            } else if (q->dups) {
+                q->stage = QS_EQUAL;
+                q->ignored = false;
+                if (wsSplit(q, q->a + q->gt, q->n - q->gt, q->pivot + 1, &q->ignored))
+                    return;
+            }
+            break;
+        case QS_EQUAL:
+            q->gt += q->counted;
+            q->stage = QS_SPLIT;
+            break;
+        case QS_SPLIT:
+            if (settleSplit(q->a, q->n, q->lt, q->gt, q->swapped, &q->badAllowed, s)) {
+                wsQuickDone(q);
+                return;
+            }
+            q->depth++;
+            if (probe != NULL && q->depth > probe[threadNum()].maxDepth)
+                probe[threadNum()].maxDepth = q->depth;
+            wsSpawnLeft(q);
+            q->a += q->gt;
+            q->n -= q->gt;
+            q->stage = QS_PIVOT;
+            break;
+        }
+    }
+}
+
+/* runs the quicksort of a[0..n) on the pool of s. false without memory */
+static bool quickSortOnPool(int *a, long n, const sorter_t *s) {
+    wsquick_t *q = malloc(sizeof(wsquick_t));
+    if (q == NULL)
+        return false;
+    q->a = a;
+    q->n = n;
+    q->badAllowed = log2Floor(n) + 1;
+    q->depth = 0;
+    q->spawned = false;
+    q->s = s;
+    q->stage = QS_PIVOT;
+    ws_run(s->pool, wsQuickTask, q);
+    return true;
+}
+
+/* a range of the merge sort on the pool */
+typedef struct {
+    int *a, *b;
+    long n;
+    bool toScratch;
+    const sorter_t *s;
+    ws_join_t join;
+} wsmerge_t;
+
+/* a part of a merge */
+typedef struct {
+    const int *x, *y;
+    long nx, ny;
+    int *out;
+} wsmergepart_t;
+
+static void wsMergePart(void *arg);
+
+/* mergePar on the pool: the first half of the output becomes a task that
+   counts toward the join of the calling task */
+static void wsMerge(const int *x, long nx, const int *y, long ny, int *out) {
+    while (nx + ny > MERGE_CUTOFF) {
+        long k = (nx + ny) / 2;
+        long i = coRank(k, x, nx, y, ny);
+        wsmergepart_t *part = malloc(sizeof(wsmergepart_t));
+        if (part == NULL)
+            break;
+        part->x = x;
+        part->nx = i;
+        part->y = y;
+        part->ny = k - i;
+        part->out = out;
+        ws_spawn(NULL, wsMergePart, part);
+        x += i;
+        nx -= i;
+        y += k - i;
+        ny -= k - i;
+        out += k;
+    }
+    mergeSeq(x, nx, y, ny, out);
+}
+
+static void wsMergePart(void *arg) {
+    wsmergepart_t *part = arg;
+    wsMerge(part->x, part->nx, part->y, part->ny, part->out);
+    free(part);
+}
+
+/* the continuation of a range whose halves are sorted */
+static void wsMergeHalves(void *arg) {
+    wsmerge_t *m = arg;
+    long h = m->n / 2;
+    const int *from = m->toScratch ? m->a : m->b;
+    int *to = m->toScratch ? m->b : m->a;
+    wsMerge(from, h, from + h, m->n - h, to);
+    free(m);
+}
+
+static wsmerge_t *newMerge(int *a, int *b, long n, bool toScratch, const sorter_t *s) {
+    wsmerge_t *m = malloc(sizeof(wsmerge_t));
+    if (m != NULL) {
+        m->a = a;
+        m->b = b;
+        m->n = n;
+        m->toScratch = toScratch;
+        m->s = s;
+    }
+    return m;
+}
+
+/* mergeSort on the pool: the halves become tasks of a join whose
+   continuation merges them */
+static void wsMergeSort(void *arg) {
+    wsmerge_t *m = arg;
+    long h = m->n / 2;
+    wsmerge_t *left = NULL, *right = NULL;
+    if (m->n > MERGE_RUN && h > PS_TASK_CUTOFF) {
+        left = newMerge(m->a, m->b, h, !m->toScratch, m->s);
+        right = newMerge(m->a + h, m->b + h, m->n - h, !m->toScratch, m->s);
+    }
+    if (left == NULL || right == NULL) {
+        free(left);
+        free(right);
+        mergeSort(m->a, m->b, m->n, m->toScratch, false, m->s);
+        free(m);
+        return;
+    }
+    ws_join_init(&m->join, wsMergeHalves, m);
+    ws_spawn(&m->join, wsMergeSort, left);
+    ws_spawn(&m->join, wsMergeSort, right);
+    ws_join_close(&m->join);
+}
+
+/* runs the merge sort of a[0..n) on the pool of s. false without memory */
+static bool mergeSortOnPool(int *a, int *scratch, long n, const sorter_t *s) {
+    wsmerge_t *m = newMerge(a, scratch, n, false, s);
+    if (m == NULL)
+        return false;
+    ws_run(s->pool, wsMergeSort, m);
+    return true;
+}
+
+/* PRESORTED RUNS */
+
+/* a maximal ascending or descending stretch of the input */
+typedef struct {
+    long start;
+    bool down;
+} run_t;
+
+/* stores the natural runs of a[lo..hi) in runs and returns their number,
+   or -1 as soon as there are more than max */
+static long findRuns(const int *a, long lo, long hi, run_t *runs, long max) {
+    long r = 0;
+    for (long i = lo; i < hi;) {
+        if (r == max)
+            return -1;
+        /* equal keys belong to either direction, the first unequal pair decides */
+        long j = i + 1;
+        while (j < hi && a[j] == a[j - 1]) j++;
+        bool down = j < hi && a[j] < a[j - 1];
+        if (down)
+            while (j < hi && a[j] <= a[j - 1]) j++;
+        else
+            while (j < hi && a[j] >= a[j - 1]) j++;
+        runs[r].start = i;
+        runs[r].down = down;
+        r++;
+        i = j;
+    }
+    return r;
+}
+
+static void reverse(int *a, long n, int threads) {
+    #pragma omp parallel for num_threads(threads) if(threads > 1 && n >= PS_PARALLEL_SPLIT)
+    for (long i = 0; i < n / 2; i++)
+        swap(&a[i], &a[n - 1 - i]);
+}
+
+/* sorts input that is a few ascending or descending runs. every thread
+   scans its chunk for runs and gives up past NATURAL_MAX_RUNS, so random
+   input costs a few hundred keys per thread; runs that continue across a
+   chunk boundary are joined. a single ascending run is the sorted input,
+   descending runs are reversed in place, and the runs are merged pairwise,
+   level by level, between a and a scratch array with the co-ranked merge
+   of the merge sort. false, with the keys permuted at most, when the runs
+   are too many or there is no memory */
+static bool sortRuns(int *a, long n, int threads) {
+    long chunk = (n + threads - 1) / threads;
+    run_t *found = malloc((size_t)threads * NATURAL_MAX_RUNS * sizeof(run_t));
+    long *counts = malloc(threads * sizeof(long));
+    long *bounds = malloc((NATURAL_MAX_RUNS + 1) * sizeof(long));
+    bool sorted = false;
+    if (found == NULL || counts == NULL || bounds == NULL)
+        goto done;
+    #pragma omp parallel for num_threads(threads) if(threads > 1)
+    for (int t = 0; t < threads; t++) {
+        long lo = t * chunk < n ? t * chunk : n, hi = lo + chunk < n ? lo + chunk : n;
+        counts[t] = findRuns(a, lo, hi, found + (size_t)t * NATURAL_MAX_RUNS, NATURAL_MAX_RUNS);
+    }
+
+    /* join the runs of all chunks, and the ones continuing over a boundary */
+    run_t runs[NATURAL_MAX_RUNS];
+    long r = 0;
+    for (int t = 0; t < threads; t++) {
+        if (counts[t] < 0)
+            goto done;
+        for (long i = 0; i < counts[t]; i++) {
+            run_t next = found[(size_t)t * NATURAL_MAX_RUNS + i];
+            if (i == 0 && r > 0 && runs[r - 1].down == next.down &&
+                (next.down ? a[next.start] <= a[next.start - 1] : a[next.start] >= a[next.start - 1]))
+                continue;
+            if (r == NATURAL_MAX_RUNS)
+                goto done;
+            runs[r++] = next;
+        }
+    }
+    for (long i = 0; i < r; i++) {
+        bounds[i] = runs[i].start;
+        if (runs[i].down)
+            reverse(a + runs[i].start, (i + 1 < r ? runs[i + 1].start : n) - runs[i].start, threads);
+    }
+    bounds[r] = n;
+    if (r == 1) {
+        sorted = true;
+        goto done;
+    }
+
+    int *b = malloc(n * sizeof(int));
+    if (b == NULL)
+        goto done;
+    int *from = a, *to = b;
+    while (r > 1) {
+        #pragma omp parallel num_threads(threads) if(threads > 1)
+        {
+            #pragma omp single
+            for (long i = 0; i < r; i += 2) {
+                long lo = bounds[i], mid = bounds[i + 1], hi = i + 2 <= r ? bounds[i + 2] : mid;
+                #pragma omp task firstprivate(lo, mid, hi)
+                mergePar(from + lo, mid - lo, from + mid, hi - mid, to + lo);
+            }
+        }
+        long merged = 0;
+        for (long i = 0; i < r; i += 2)
+            bounds[merged++] = bounds[i];
+        bounds[merged] = n;
+        r = merged;
+        int *t = from;
+        from = to;
+        to = t;
+    }
+    if (from != a) {
+        #pragma omp parallel for num_threads(threads) if(threads > 1)
+        for (long i = 0; i < n; i += PS_BLOCK)
+            memcpy(a + i, b + i, (n - i < PS_BLOCK ? n - i : PS_BLOCK) * sizeof(int));
+    }
+    free(b);
+    sorted = true;
+done:
+    free(found);
+    free(counts);
+    free(bounds);
+    return sorted;
+}
+
+/* SELECTION */
+
+/* introselect: moves the k-th smallest value of a[0..n) to a[k], the
+   smaller ones before it and the larger ones after. the splits are the
+   quicksort's, cooperative ones included inside a team, but only the side
+   holding k is continued, so the expected work is linear. a range that
+   keeps splitting badly gets random swaps and after badAllowed splits is
+   heap sorted */
+static void quickSelect(int *a, long n, long k, int badAllowed, const sorter_t *s) {
+    while (n > s->cutoff) {
+        bool dups, swapped = false;
+        choosePivot(a, n, &dups);
+        int pivot = a[0];
+        long lt = partition(a + 1, n - 1, pivot, &swapped, s->kernel, NULL);
+        swap(&a[0], &a[lt]);
+        long gt = lt + 1;
+        if (dups && k > lt) {
+            bool ignored = false;
+            if (pivot == INT_MAX)
+                gt = n;
+            else
+                gt += partition(a + gt, n - gt, pivot + 1, &ignored, s->kernel, NULL);
+        }
+        if (k >= lt && k < gt)
+            return;
+        if ((lt < n / 8 || n - gt < n / 8) && gt - lt < n / 8) {
+            if (--badAllowed == 0) {
+                heapSort(a, n);
+                return;
+            }
+            breakPatterns(a, lt, s);
+            breakPatterns(a + gt, n - gt, s);
+        }
+        if (k < lt) {
+            n = lt;
+        } else {
+            a += gt;
+            n -= gt;
+            k -= gt;
+        }
+    }
+    leafSort(a, n, s);
+}
+
+/* ALGORITHM CHOICE
+   PS_ALGO_AUTO samples adjacent pairs for the key range, the share of
+   descents and how often the direction turns. few turns send the input to
+   the run merge, a range small next to n to the counting sort, and keys
+   that are not nearly sorted to the radix sort when its passes cost less
+   than the quicksort levels. whatever declines falls to the quicksort */
+
+/* the smallest and largest key */
+static void keyRange(const int *a, long n, int threads, int *min, int *max) {
+    int lo = a[0], hi = a[0];
+    #pragma omp parallel for num_threads(threads) if(threads > 1) reduction(min:lo) reduction(max:hi)
+    for (long i = 1; i < n; i++) {
+        lo = a[i] < lo ? a[i] : lo;
+        hi = a[i] > hi ? a[i] : hi;
+    }
+    *min = lo;
+    *max = hi;
+}
+
+/* estimates the key range from pairs of adjacent keys spread over
+   a[0..n), n > 2 * pairs, and returns how many of the pairs descend.
+   turns counts the unequal pairs that go the other way than the unequal
+   pair before them, about one per presorted run */
+static int samplePairs(const int *a, long n, int pairs, int *min, int *max, int *turns) {
+    long stride = (n - 1) / pairs;
+    int lo = a[0], hi = a[0], descents = 0, changes = 0, last = 0;
+    for (long s = 0; s < pairs; s++) {
+        int x = a[s * stride], y = a[s * stride + 1];
+        lo = x < lo ? x : lo;
+        lo = y < lo ? y : lo;
+        hi = x > hi ? x : hi;
+        hi = y > hi ? y : hi;
+        descents += y < x;
+        int dir = (y > x) - (y < x);
+        changes += dir != 0 && last != 0 && dir != last;
+        last = dir != 0 ? dir : last;
+    }
+    *min = lo;
+    *max = hi;
+    *turns = changes;
+    return descents;
+}
+
+/* whether counters for span values are few enough for n keys */
+static bool countingPays(long n, int threads, long span) {
+    return span <= COUNT_MAX_SPAN && span * COUNT_DENSITY <= n && span * threads <= n;
+}
+
+/* counting sort of keys in [lo, lo + span). every thread counts the keys
+   of its own chunk, the counters are summed per value in slices of the
+   value range, and each thread writes the runs of its own part of the
+   output. returns 1 when sorted, 0 when some key was outside, with the
+   exact key range in min and max, and -1 when out of memory */
+static int countingSort(int *a, long n, int threads, int lo, long span, int *min, int *max) {
+    long *counts = malloc(threads * span * sizeof(long));
+    long *starts = malloc((span + 1) * sizeof(long));
+    if (counts == NULL || starts == NULL) {
+        free(counts);
+        free(starts);
+        return -1;
+    }
+    bool outside = false;
+    int allMin = INT_MAX, allMax = INT_MIN;
+    #pragma omp parallel num_threads(threads) if(threads > 1)
+    {
+        int id = omp_get_thread_num(), team = omp_get_num_threads();
+        long from = n * id / team, to = n * (id + 1) / team;
+        long *mine = counts + id * span;
+        memset(mine, 0, span * sizeof(long));
+        int kmin = INT_MAX, kmax = INT_MIN;
+        bool out = false;
+        for (long i = from; i < to; i++) {
+            int k = a[i];
+            unsigned long v = (unsigned long)((long)k - lo);
+            kmin = k < kmin ? k : kmin;
+            kmax = k > kmax ? k : kmax;
+            if (v < (unsigned long)span)
+                mine[v]++;
+            else
+                out = true;
+        }
+        #pragma omp critical(countRange)
+        {
+            allMin = kmin < allMin ? kmin : allMin;
+            allMax = kmax > allMax ? kmax : allMax;
+            outside |= out;
+        }
+        #pragma omp barrier
+        if (!outside) {
+            for (long v = span * id / team; v < span * (id + 1) / team; v++) {
+                long total = 0;
+                for (int t = 0; t < team; t++)
+                    total += counts[t * span + v];
+                starts[v] = total;
+            }
+            #pragma omp barrier
+            #pragma omp single
+            {
+                long at = 0;
+                for (long v = 0; v < span; v++) {
+                    long k = starts[v];
+                    starts[v] = at;
+                    at += k;
+                }
+                starts[span] = at;
+            }
+            /* the last value starting at or before my first position */
+            long first = 0, last = span;
+            while (last - first > 1) {
+                long mid = (first + last) / 2;
+                if (starts[mid] <= from)
+                    first = mid;
+                else
+                    last = mid;
+            }
+            for (long v = first, i = from; i < to; v++) {
+                long end = starts[v + 1] < to ? starts[v + 1] : to;
+                for (; i < end; i++)
+                    a[i] = (int)(lo + v);
+            }
+        }
+    }
+    free(counts);
+    free(starts);
+    *min = allMin;
+    *max = allMax;
+    return outside ? 0 : 1;
+}
+
+/* whether the radix passes over [min, max] cost less than the quicksort
+   levels for n keys with at most max - min + 1 distinct values */
+static bool radixPays(long n, int min, int max) {
+    long distinct = (long)max - min + 1;
+    int levels = log2Floor(distinct < n ? distinct : n);
+    return rs_passes_i32(min, max) * RADIX_PASS_LEVELS < levels;
+}
+
+/* PS_ALGO_AUTO: the run merge, the counting or the radix sort, where one
+   pays. returns the one that sorted a, PS_ALGO_QUICK if the quicksort
+   should run */
+static ps_algorithm_t sortByKeys(int *a, long n, int threads) {
+    /* at most one key in PROFILE_STRIDE is read, so the choice costs
+       little next to any of the sorts */
+    int pairs = n / PROFILE_STRIDE < PROFILE_PAIRS ? (int)(n / PROFILE_STRIDE) : PROFILE_PAIRS;
+    int min, max;
+    int turns;
+    int descents = samplePairs(a, n, pairs, &min, &max, &turns);
+    /* samples that seldom change direction: the input may be a few
+       presorted runs, which a scan of little cost otherwise finds */
+    if ((long)turns * NATURAL_MIN_SHARE < pairs && sortRuns(a, n, threads))
+        return PS_ALGO_MERGE;
+    if (descents == 0)
+        return PS_ALGO_QUICK;   /* likely sorted, which the quicksort finds in one pass */
+    /* the samples may have missed the extremes, so the counters cover a
+       wider range, and the counting pass checks every key against it */
+    long pad = ((long)max - min) / 4 + 1;
+    long lo = (long)min - pad > INT_MIN ? (long)min - pad : INT_MIN;
+    long hi = (long)max + pad < INT_MAX ? (long)max + pad : INT_MAX;
+    bool exact = false;
+    if (countingPays(n, threads, hi - lo + 1)) {
+        int r = countingSort(a, n, threads, (int)lo, hi - lo + 1, &min, &max);
+        if (r == 1)
+            return PS_ALGO_COUNT;
+        exact = r == 0;
+        if (exact && countingPays(n, threads, (long)max - min + 1) &&
+            countingSort(a, n, threads, min, (long)max - min + 1, &min, &max) == 1)
+            return PS_ALGO_COUNT;
+    }
+    /* nearly sorted keys take the quicksort linear time */
+    if (n < RADIX_MIN || descents * RADIX_MIN_DESCENTS < pairs || !radixPays(n, min, max))
+        return PS_ALGO_QUICK;
+    if ((exact ? rs_sort_i32_range(a, n, threads, min, max) : rs_sort_i32(a, n, threads)) == 0)
+        return PS_ALGO_RADIX;
+    return PS_ALGO_QUICK;
+}
+
+/* the leaf sort and pivot settings of a configuration */
+static void configure(sorter_t *s, const int *a, const ps_config_t *c) {
+    s->kernel = ps_resolve_kernel(c->kernel);
+    s->network = hasNetwork();
+    s->cutoff = c->cutoff > 0 ? c->cutoff : s->network ? SEQ_CUTOFF_INT : SEQ_CUTOFF_SCALAR;
+    /* the network only takes up to 64 values */
+    if (s->cutoff > SEQ_CUTOFF_INT)
+        s->network = false;
+    s->base = a;
+    s->seed = mix64(c->seed);
+    s->taskCutoff = PS_TASK_CUTOFF;
+    s->maxTaskDepth = INT_MAX;
+    s->maxPending = LONG_MAX;
+    s->pending = NULL;
+    s->probe = NULL;
+    s->pool = c->pool;
+    s->poolThreads = c->pool != NULL ? ws_threads(c->pool) : 0;
+}
+
+/* nanoseconds per key and quicksort level on this machine, measured once
+   on CALIBRATE_KEYS random keys whose second sort is timed, warm */
+static double keyCost(void) {
+    static double cost = 0;
+    double c;
+    #pragma omp atomic read
+    c = cost;
+    if (c > 0)
+        return c;
+    int *a = malloc(CALIBRATE_KEYS * sizeof(int));
+    if (a == NULL)
+        return 1.0;
+    ps_config_t d = { 1, PS_KERNEL_AUTO, 0, PS_ALGO_QUICK, 0, NULL };
+    sorter_t s;
+    configure(&s, a, &d);
+    double seconds = 0;
+    for (int run = 0; run < 2; run++) {
+        for (long i = 0; i < CALIBRATE_KEYS; i++)
+            a[i] = (int)mix64(i);
+        seconds = omp_get_wtime();
+        quickSort(a, CALIBRATE_KEYS, log2Floor(CALIBRATE_KEYS) + 1, 0, false, &s);
+        seconds = omp_get_wtime() - seconds;
+    }
+    free(a);
+    c = seconds * 1e9 / ((double)CALIBRATE_KEYS * log2Floor(CALIBRATE_KEYS));
+    c = c > 0.1 ? c : 0.1;  /* below the timer resolution */
+    #pragma omp atomic write
+    cost = c;
+    return c;
+}
+
+/* task granularity of a parallel quicksort of n keys: a task gets at
+   least TASK_GRAIN_NS of work at the measured cost per key, and the cutoff
+   rises with n so each thread gets about TASK_SLACK tasks, enough to even
+   out unbalanced splits. splits deeper than twice the depth those need
+   stay inline, as do all while TASK_CAP tasks per thread are pending */
+static void chooseGrain(sorter_t *s, long n, int threads) {
+    double cost = keyCost();
+    long grain = PS_TASK_CUTOFF;
+    while (grain * log2Floor(grain) * cost < TASK_GRAIN_NS)
+        grain *= 2;
+    long share = n / ((long)threads * TASK_SLACK);
+    s->taskCutoff = share > grain ? share : grain;
+    s->maxTaskDepth = 2 * (log2Floor((long)threads * TASK_SLACK) + 1);
+    s->maxPending = (long)threads * TASK_CAP;
+}
+
+static void runMergeSort(int *a, int *scratch, long n, int threads, const sorter_t *s) {
+    if (s->poolThreads > 1 && mergeSortOnPool(a, scratch, n, s))
+        return;
+    if (threads == 1) {
+        mergeSort(a, scratch, n, false, false, s);
+        return;
+    }
+    #pragma omp parallel num_threads(threads)
+    {
+        #pragma omp single
+        mergeSort(a, scratch, n, false, true, s);
+    }
+}
+
+void ps_sort_with(int *a, long n, const ps_config_t *c) {
+    ps_sort_stats(a, n, c, NULL);
+}
+
+void ps_sort_stats(int *a, long n, const ps_config_t *c, ps_stats_t *stats) {
+    ps_config_t defaults = { 0, PS_KERNEL_AUTO, 0, PS_ALGO_AUTO, 0, NULL };
+    if (c == NULL)
+        c = &defaults;
+    int threads = c->threads > 0 ? c->threads : omp_get_max_threads();
+    double start = omp_get_wtime();
+    if (stats != NULL)
+        memset(stats, 0, sizeof(*stats));
+    ps_algorithm_t ran = PS_ALGO_QUICK;
+    if (c->algorithm == PS_ALGO_RADIX && rs_sort_i32(a, n, threads) == 0)
+        ran = PS_ALGO_RADIX;
+    if (c->algorithm == PS_ALGO_COUNT && n > 0) {
+        int min, max;
+        keyRange(a, n, threads, &min, &max);
+        if (countingPays(n, threads, (long)max - min + 1) &&
+            countingSort(a, n, threads, min, (long)max - min + 1, &min, &max) == 1)
+            ran = PS_ALGO_COUNT;
+    }
+    if (c->algorithm == PS_ALGO_AUTO && n >= COUNT_MIN)
+        ran = sortByKeys(a, n, threads);
+    sorter_t s;
+    configure(&s, a, c);
+    if (ran == PS_ALGO_QUICK && c->algorithm == PS_ALGO_MERGE) {
+        int *scratch = malloc(n * sizeof(int));
+        if (scratch != NULL) {
+            runMergeSort(a, scratch, n, threads, &s);
+            free(scratch);
+            ran = PS_ALGO_MERGE;
+        }
+    }
+    /* the quicksort, also when the others do not pay or ran out of memory */
+    probe_t *probe = NULL;
+    if (ran == PS_ALGO_QUICK) {
+        /* a pool brings its own workers */
+        if (s.pool != NULL)
+            threads = s.poolThreads;
+        if (stats != NULL)
+            probe = calloc(threads, sizeof(probe_t));
+        s.probe = probe;
+        long pending = 0;
+        s.pending = &pending;
+        if (threads > 1)
+            chooseGrain(&s, n, threads);
+        if (threads == 1) {
+            clockStart(probe);
+            quickSort(a, n, log2Floor(n) + 1, 0, false, &s);
+            clockStop(probe);
+        } else if (s.pool == NULL || !quickSortOnPool(a, n, &s)) {
+            #pragma omp parallel num_threads(threads)
+            {
+                #pragma omp single
+                {
+                    clockStart(probe);
+                    quickSort(a, n, log2Floor(n) + 1, 0, n > s.taskCutoff, &s);
+                    clockStop(probe);
+                }
+            }
+        }
+    }
+    if (stats == NULL)
+        return;
+    stats->algorithm = ran;
+    stats->threads = threads;
+    stats->seconds = omp_get_wtime() - start;
+    if (probe == NULL)
+        return;
+    stats->taskCutoff = threads > 1 ? s.taskCutoff : 0;
+    for (int t = 0; t < threads; t++) {
+        stats->tasksCreated += probe[t].created;
+        stats->tasksInline += probe[t].inlined;
+        stats->maxDepth = probe[t].maxDepth > stats->maxDepth ? probe[t].maxDepth : stats->maxDepth;
+        if (t < PS_STATS_THREADS)
+            stats->busy[t] = probe[t].busy;
+    }
+    free(probe);
+}
+
+void ps_sort_seq(int *a, long n) {
+    ps_config_t c = { 1, PS_KERNEL_AUTO, 0, PS_ALGO_AUTO, 0, NULL };
+    ps_sort_with(a, n, &c);
+}
+
+void ps_sort(int *a, long n, int threads) {
+    ps_config_t c = { threads, PS_KERNEL_AUTO, 0, PS_ALGO_AUTO, 0, NULL };
+    ps_sort_with(a, n, &c);
+}
+
+void ps_merge_sort(int *a, long n, int *scratch, int threads) {
+    ps_config_t c = { threads, PS_KERNEL_AUTO, 0, PS_ALGO_MERGE, 0, NULL };
+    sorter_t s;
+    configure(&s, a, &c);
+    runMergeSort(a, scratch, n, threads > 0 ? threads : omp_get_max_threads(), &s);
+}
+
+int ps_select(int *a, long n, long k, int threads) {
+    ps_config_t c = { threads, PS_KERNEL_AUTO, 0, PS_ALGO_QUICK, 0, NULL };
+    sorter_t s;
+    configure(&s, a, &c);
+    if (threads <= 0)
+        threads = omp_get_max_threads();
+    /* only ranges of PS_PARALLEL_SPLIT are worth the team */
+    if (threads == 1 || n < PS_PARALLEL_SPLIT) {
+        quickSelect(a, n, k, log2Floor(n) + 1, &s);
+    } else {
+        #pragma omp parallel num_threads(threads)
+        {
+            #pragma omp single
+            quickSelect(a, n, k, log2Floor(n) + 1, &s);
+        }
+    }
+    return a[k];
+}
+
+void ps_partial_sort(int *a, long n, long k, int threads) {
+    if (k <= 0)
+        return;
+    if (k < n)
+        ps_select(a, n, k, threads);
+    else
+        k = n;
+    ps_config_t c = { threads, PS_KERNEL_AUTO, 0, PS_ALGO_AUTO, 0, NULL };
+    ps_sort_with(a, k, &c);
+}
+
+double ps_median(int *a, long n, int threads) {
+    int upper = ps_select(a, n, n / 2, threads);
+    if (n % 2 != 0)
+        return upper;
+    /* the lower middle value is the largest of the half before a[n / 2] */
+    int lower = a[0];
+    #pragma omp parallel for num_threads(threads > 0 ? threads : omp_get_max_threads()) reduction(max:lower) if(n >= PS_PARALLEL_SPLIT)
+    for (long i = 1; i < n / 2; i++)
+        lower = a[i] > lower ? a[i] : lower;
+    return ((double)lower + upper) / 2.0;
+}
+
+/* ARGSORT
+   every key is packed with its index into a 64-bit word, key - min above
+   the log2 n bits of the index, and the words are radix sorted: 8 bytes
+   move per key instead of a key and an index, and ties break by index, so
+   the order is stable */
+
+int ps_argsort(const int *keys, long n, uint32_t *perm, int threads) {
+    if (n < 0 || n > PS_ARGSORT_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (n == 0)
+        return 0;
+    if (threads <= 0)
+        threads = omp_get_max_threads();
+    int min, max;
+    keyRange(keys, n, threads, &min, &max);
+    /* key - min takes at most 32 bits and the index the rest */
+    int indexBits = log2Floor(n - 1) + 1;
+    uint64_t *words = malloc(n * sizeof(uint64_t));
+    if (words == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    #pragma omp parallel for num_threads(threads) if(threads > 1)
+    for (long i = 0; i < n; i++)
+        words[i] = (uint64_t)((int64_t)keys[i] - min) << indexBits | (uint64_t)i;
+    if (rs_sort_u64(words, n, threads) != 0) {
+        free(words);
+        return -1;
+    }
+    uint64_t mask = (1ULL << indexBits) - 1;
+    #pragma omp parallel for num_threads(threads) if(threads > 1)
+    for (long i = 0; i < n; i++)
+        perm[i] = (uint32_t)(words[i] & mask);
+    free(words);
+    return 0;
+}
+
+/* out[i] = in[perm[i]] for i in [first, last), with fixed sizes moved as
+   integers so the compiler does not call memcpy per element */
+static void gatherColumn(const uint32_t *perm, long first, long last, const char *in, char *out, size_t size) {
+    switch (size) {
+    case 4:
+        for (long i = first; i < last; i++)
+            ((uint32_t *)out)[i] = ((const uint32_t *)in)[perm[i]];
+        break;
+    case 8:
+        for (long i = first; i < last; i++)
+            ((uint64_t *)out)[i] = ((const uint64_t *)in)[perm[i]];
+        break;
+    default:
+        for (long i = first; i < last; i++)
+            memcpy(out + i * size, in + perm[i] * size, size);
+        break;
+    }
+}
+
+void ps_gather(const uint32_t *perm, long n, int numColumns, const void *const columns[], void *const out[],
+               const size_t sizes[], int threads) {
+    if (threads <= 0)
+        threads = omp_get_max_threads();
+    /* a block of perm stays in the L1 cache while every column takes it */
+    #pragma omp parallel for schedule(static) num_threads(threads) if(threads > 1 && n > GATHER_BLOCK)
+    for (long first = 0; first < n; first += GATHER_BLOCK) {
+        long last = first + GATHER_BLOCK < n ? first + GATHER_BLOCK : n;
+        for (int c = 0; c < numColumns; c++)
+            gatherColumn(perm, first, last, columns[c], out[c], sizes[c]);
+    }
+}
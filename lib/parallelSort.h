@@ -0,0 +1,110 @@
+/* parallel sorting library
+
+   Sorts int arrays with long indices on one thread or a team: a
+   pattern-defeating quicksort that takes O(n log n) on any input, a stable
+   merge sort, and the counting and radix sorts (lib/radixSort.h) that
+   PS_ALGO_AUTO picks when the keys favour them. Also selection, and an
+   argsort whose order ps_gather() applies to any number of columns. The
+   quick and merge sorts run on OpenMP tasks, or on the work-stealing pool
+   of lib/workSteal.h when ps_config_t.pool is set. parallelSort.c
+   describes how each sort works.
+
+   build:
+     gcc -O2 -fopenmp -c parallelSort.c radixSort.c workSteal.c topology.c -lpthread
+*/
+#ifndef PARALLEL_SORT_H
+#define PARALLEL_SORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "workSteal.h"
+
+#define PS_BLOCK 4096               /* elements per block of the parallel partition */
+#define PS_PARALLEL_SPLIT (1L << 20) /* smaller ranges are partitioned sequentially */
+#define PS_TASK_CUTOFF 1000         /* smaller ranges are never sorted on new tasks */
+#define PS_STATS_THREADS 64         /* threads whose busy time ps_stats_t reports */
+#define PS_ARGSORT_MAX (1L << 32)   /* most keys ps_argsort orders, indices are 32 bits */
+
+/* the sequential partition: branchy Hoare, branch-free BlockQuicksort, or
+   AVX-512 compress stores, which run as the block kernel without AVX-512F.
+   AUTO is the fastest that runs */
+typedef enum { PS_KERNEL_AUTO, PS_KERNEL_HOARE, PS_KERNEL_BLOCK, PS_KERNEL_COMPRESS } ps_kernel_t;
+/* AUTO samples the keys and may finish presorted runs with a merge, or
+   take the counting or radix sort, else the quicksort. MERGE is stable
+   and falls back to the quicksort when n ints of scratch cannot be had */
+typedef enum { PS_ALGO_AUTO, PS_ALGO_QUICK, PS_ALGO_RADIX, PS_ALGO_COUNT, PS_ALGO_MERGE } ps_algorithm_t;
+
+typedef struct {
+    int threads;        /* 0 for the OpenMP default, 1 sorts without a team */
+    ps_kernel_t kernel;
+    int cutoff;         /* leaf size, 0 for the default of the key type */
+    ps_algorithm_t algorithm;
+    unsigned long seed; /* of the pivot randomization, the same seed makes the same draws */
+    ws_pool_t *pool;    /* runs the quick and merge sorts with its workers, NULL for OpenMP tasks */
+} ps_config_t;
+
+/* what a sort did. the task counts and times are those of the quicksort,
+   0 when another algorithm sorted the keys */
+typedef struct {
+    ps_algorithm_t algorithm;   /* the one that ran, not PS_ALGO_AUTO */
+    int threads;
+    double seconds;             /* wall time of the whole sort */
+    long taskCutoff;            /* ranges up to this size stayed on their thread */
+    long tasksCreated;          /* splits whose left side became a task */
+    long tasksInline;           /* splits above the cutoff sorted inline */
+    int maxDepth;               /* deepest split of the recursion */
+    double busy[PS_STATS_THREADS]; /* seconds thread t sorted, idle for the rest */
+} ps_stats_t;
+
+const char *ps_kernel_name(ps_kernel_t k);
+/* -1 if the name is unknown */
+int ps_parse_kernel(const char *name);
+const char *ps_algorithm_name(ps_algorithm_t a);
+/* -1 if the name is unknown */
+int ps_parse_algorithm(const char *name);
+/* the kernel PS_KERNEL_AUTO or an unsupported kernel runs as */
+ps_kernel_t ps_resolve_kernel(ps_kernel_t k);
+
+/* sorts a[0..n) ascending on one thread */
+void ps_sort_seq(int *a, long n);
+/* sorts a[0..n) ascending with a team of threads, 0 for the OpenMP default */
+void ps_sort(int *a, long n, int threads);
+/* sorts a[0..n) ascending as configured, c NULL for the defaults */
+void ps_sort_with(int *a, long n, const ps_config_t *c);
+/* ps_sort_with, filling *stats with what the sort did */
+void ps_sort_stats(int *a, long n, const ps_config_t *c, ps_stats_t *stats);
+/* stable merge sort of a[0..n) with a team of threads, 0 for the OpenMP
+   default, that uses scratch[0..n) instead of allocating, so a caller
+   sorting many arrays allocates it once */
+void ps_merge_sort(int *a, long n, int *scratch, int threads);
+
+/* moves the k-th smallest value of a[0..n), 0 <= k < n, to a[k] with no
+   larger value before it and no smaller one after, and returns it. threads
+   as for ps_sort */
+int ps_select(int *a, long n, long k, int threads);
+/* sorts the k smallest values of a[0..n) into a[0..k); the rest of the
+   array is left in no particular order */
+void ps_partial_sort(int *a, long n, long k, int threads);
+/* the median of a[0..n), n >= 1, the mean of the two middle values when n
+   is even. reorders a */
+double ps_median(int *a, long n, int threads);
+
+/* the sort order of keys[0..n), n <= PS_ARGSORT_MAX, in perm[0..n): the
+   index of the smallest key first, equal keys by index. keys are not
+   changed. threads as for ps_sort. returns 0, or -1 with errno EINVAL for
+   too many keys or ENOMEM, perm then undefined */
+int ps_argsort(const int *keys, long n, uint32_t *perm, int threads);
+/* out[c][i] = columns[c][perm[i]] for i in [0, n) and each of numColumns
+   columns of sizes[c]-byte elements. out[c] must not overlap columns[c] */
+void ps_gather(const uint32_t *perm, long n, int numColumns, const void *const columns[], void *const out[],
+               const size_t sizes[], int threads);
+
+/* reorders a[0..n) so the values < pivot come first and returns their
+   count. Inside a parallel region with more than one thread, ranges of at
+   least PS_PARALLEL_SPLIT are partitioned by tasks of the whole team */
+long ps_partition(int *a, long n, int pivot);
+/* the same on the calling thread with the given kernel */
+long ps_partition_kernel(int *a, long n, int pivot, ps_kernel_t k);
+
+#endif
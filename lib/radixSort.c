@@ -0,0 +1,405 @@
+/* parallel radix sort, see radixSort.h */
+#include "radixSort.h"
+
+#include <omp.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+#define MIN_DIGIT 8         /* digit widths in bits */
+#define MAX_DIGIT 11
+#define MSD_MIN_PASSES 3    /* keys needing this many passes split on the top digit first */
+#define SMALL_BUCKET 64     /* MSD buckets up to this size are insertion sorted */
+#define LINE 64             /* bytes per cache line and write-combining buffer */
+
+/* the helpers below are inlined into teamSort, once for each key width
+   and kind, so the tests on those disappear from the loops */
+#define INLINE static inline __attribute__((always_inline))
+
+typedef enum { KEY_UNSIGNED, KEY_SIGNED, KEY_FLOAT } kind_t;
+
+/* one sort, shared by its team */
+typedef struct {
+    void *a, *tmp;
+    long n;
+    int threads;
+    bool wide;          /* 64-bit keys */
+    kind_t kind;
+    bool known;         /* min and max were given */
+    uint64_t min, max;  /* smallest and largest mapped key */
+    int bits;           /* significant bits of max - min */
+    int digit;          /* widest digit, in bits */
+    long *counts;       /* threads x buckets, the digit counts of each chunk */
+    char *scratch;      /* per thread: write-combining buffers, bucket starts, counts */
+    size_t stride;      /* bytes of scratch per thread */
+    bool stream;        /* the parallel passes bypass the cache */
+    bool skip;          /* the last parallel pass found a single bucket */
+    bool ready, failed; /* there is work, memory ran out */
+} radix_t;
+
+INLINE uint64_t load(const void *a, long i, bool wide) {
+    return wide ? ((const uint64_t *)a)[i] : ((const uint32_t *)a)[i];
+}
+
+INLINE void store(void *a, long i, uint64_t v, bool wide) {
+    if (wide)
+        ((uint64_t *)a)[i] = v;
+    else
+        ((uint32_t *)a)[i] = (uint32_t)v;
+}
+
+/* the unsigned integer with the order of the key */
+INLINE uint64_t order(uint64_t raw, bool wide, kind_t kind) {
+    uint64_t sign = wide ? 1ULL << 63 : 1ULL << 31;
+    uint64_t all = wide ? ~0ULL : 0xFFFFFFFFULL;
+    if (kind == KEY_SIGNED)
+        return raw ^ sign;
+    if (kind == KEY_FLOAT)
+        return raw ^ ((-(uint64_t)((raw & sign) != 0) & all) | sign);
+    return raw;
+}
+
+INLINE long digitOf(uint64_t raw, uint64_t min, int shift, uint64_t mask, bool wide, kind_t kind) {
+    return (long)(((order(raw, wide, kind) - min) >> shift) & mask);
+}
+
+/* the widest digit whose write-combining buffers, a line per bucket, fit
+   in three quarters of the L1 data cache. wider digits save passes but
+   every key then evicts a buffer line, which costs more than the pass */
+static int digitBits(void) {
+    long cache = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+    if (cache <= 0)
+        cache = 32 * 1024;
+    int d = MIN_DIGIT;
+    while (d < MAX_DIGIT && ((long)LINE << (d + 1)) <= cache / 4 * 3)
+        d++;
+    return d;
+}
+
+INLINE void histogram(const radix_t *r, const void *src, long lo, long hi, int shift, int width,
+                      long *count, bool wide, kind_t kind) {
+    uint64_t mask = (1ULL << width) - 1, min = r->min;
+    memset(count, 0, (sizeof(long)) << width);
+    for (long i = lo; i < hi; i++)
+        count[digitOf(load(src, i, wide), min, shift, mask, wide, kind)]++;
+}
+
+/* writes one whole cache line of dst straight to memory, without first
+   reading the line it overwrites */
+static inline void streamLine(char *dst, const char *line) {
+#ifdef __x86_64__
+    for (int k = 0; k < LINE; k += 16)
+        _mm_stream_si128((__m128i *)(dst + k), _mm_load_si128((const __m128i *)(line + k)));
+#else
+    memcpy(dst, line, LINE);
+#endif
+}
+
+/* moves src[lo..hi) to dst, the keys of bucket d from next[d] on */
+INLINE void scatter(const radix_t *r, const void *src, long lo, long hi, void *dst, int shift, int width,
+                    long *next, bool wide, kind_t kind) {
+    uint64_t mask = (1ULL << width) - 1, min = r->min;
+    for (long i = lo; i < hi; i++) {
+        uint64_t raw = load(src, i, wide);
+        store(dst, next[digitOf(raw, min, shift, mask, wide, kind)]++, raw, wide);
+    }
+}
+
+/* scatter for arrays larger than the cache. each bucket has a cache line
+   of buffer that mirrors the line of dst its next key goes to; a full line
+   is streamed out at once, only the lines at both ends of a bucket's part,
+   which other chunks share, are written key by key */
+INLINE void scatterStreamed(const radix_t *r, const void *src, long lo, long hi, void *dst, int shift, int width,
+                            long *next, char *scratch, bool wide, kind_t kind) {
+    size_t keyBytes = wide ? 8 : 4;
+    long perLine = LINE / keyBytes;
+    uint64_t mask = (1ULL << width) - 1, min = r->min;
+    char *buf = scratch;
+    long *begin = (long *)(scratch + ((long)LINE << r->digit));
+    char *out = dst;
+    long skew = (long)((uintptr_t)dst / keyBytes) & (perLine - 1);
+    memcpy(begin, next, sizeof(long) << width);
+    for (long i = lo; i < hi; i++) {
+        uint64_t raw = load(src, i, wide);
+        long d = digitOf(raw, min, shift, mask, wide, kind);
+        long p = next[d]++;
+        long slot = (p + skew) & (perLine - 1);
+        store(buf, d * perLine + slot, raw, wide);
+        if (slot == perLine - 1) {
+            long line = p - slot;
+            if (line >= begin[d])
+                streamLine(out + line * keyBytes, buf + d * LINE);
+            else
+                memcpy(out + begin[d] * keyBytes, buf + d * LINE + (begin[d] - line) * keyBytes,
+                       (p + 1 - begin[d]) * keyBytes);
+        }
+    }
+    for (long d = 0; d <= (long)mask; d++) {
+        long p = next[d];
+        long slot = (p + skew) & (perLine - 1);
+        long from = p - slot > begin[d] ? p - slot : begin[d];
+        if (slot > 0 && p > from)
+            memcpy(out + from * keyBytes, buf + d * LINE + (from - (p - slot)) * keyBytes, (p - from) * keyBytes);
+    }
+#ifdef __x86_64__
+    _mm_sfence();
+#endif
+}
+
+/* one pass of the whole team from src to dst, called by every thread.
+   afterwards the counts of the last thread hold the end of each bucket */
+INLINE void parallelPass(radix_t *r, const void *src, void *dst, int shift, int width, bool wide, kind_t kind) {
+    int id = omp_get_thread_num(), team = omp_get_num_threads();
+    long buckets = 1L << width;
+    long lo = r->n * id / team, hi = r->n * (id + 1) / team;
+    long *mine = r->counts + ((long)id << r->digit);
+    histogram(r, src, lo, hi, shift, width, mine, wide, kind);
+    #pragma omp barrier
+    #pragma omp single
+    {
+        /* bucket by bucket, each thread's keys after the previous thread's */
+        long at = 0;
+        r->skip = false;
+        for (long d = 0; d < buckets; d++) {
+            long total = 0;
+            for (int t = 0; t < team; t++) {
+                long *c = r->counts + ((long)t << r->digit) + d;
+                long k = *c;
+                *c = at;
+                at += k;
+                total += k;
+            }
+            if (total == r->n)
+                r->skip = true;
+        }
+    }
+    if (!r->skip) {
+        if (r->stream)
+            scatterStreamed(r, src, lo, hi, dst, shift, width, mine, r->scratch + id * r->stride, wide, kind);
+        else
+            scatter(r, src, lo, hi, dst, shift, width, mine, wide, kind);
+    }
+    #pragma omp barrier
+}
+
+/* one pass of the calling thread over src[lo..hi), false if it was skipped */
+INLINE bool serialPass(radix_t *r, const void *src, long lo, long hi, void *dst, int shift, int width,
+                       char *scratch, bool wide, kind_t kind) {
+    long buckets = 1L << width;
+    long *count = (long *)(scratch + ((LINE + sizeof(long)) << r->digit));
+    histogram(r, src, lo, hi, shift, width, count, wide, kind);
+    long at = lo;
+    for (long d = 0; d < buckets; d++) {
+        long k = count[d];
+        if (k == hi - lo)
+            return false;
+        count[d] = at;
+        at += k;
+    }
+    scatter(r, src, lo, hi, dst, shift, width, count, wide, kind);
+    return true;
+}
+
+INLINE void insertionSort(void *a, long lo, long hi, bool wide, kind_t kind) {
+    for (long i = lo + 1; i < hi; i++) {
+        uint64_t raw = load(a, i, wide);
+        uint64_t key = order(raw, wide, kind);
+        long j = i;
+        while (j > lo && order(load(a, j - 1, wide), wide, kind) > key) {
+            store(a, j, load(a, j - 1, wide), wide);
+            j--;
+        }
+        store(a, j, raw, wide);
+    }
+}
+
+/* sorts bucket [lo, hi) of tmp by the bits below the top digit into a */
+INLINE void sortBucket(radix_t *r, long lo, long hi, int bits, char *scratch, bool wide, kind_t kind) {
+    size_t keyBytes = wide ? 8 : 4;
+    if (hi - lo <= SMALL_BUCKET) {
+        memcpy((char *)r->a + lo * keyBytes, (char *)r->tmp + lo * keyBytes, (hi - lo) * keyBytes);
+        insertionSort(r->a, lo, hi, wide, kind);
+        return;
+    }
+    int passes = (bits + r->digit - 1) / r->digit;
+    int width = (bits + passes - 1) / passes;
+    void *src = r->tmp, *dst = r->a;
+    for (int shift = 0; shift < bits; shift += width) {
+        int w = bits - shift < width ? bits - shift : width;
+        if (serialPass(r, src, lo, hi, dst, shift, w, scratch, wide, kind)) {
+            void *t = src;
+            src = dst;
+            dst = t;
+        }
+    }
+    if (src != r->a)
+        memcpy((char *)r->a + lo * keyBytes, (char *)src + lo * keyBytes, (hi - lo) * keyBytes);
+}
+
+static int passesFor(int bits, int digit) {
+    return (bits + digit - 1) / digit;
+}
+
+/* the smallest and largest mapped key, from the extremes of each chunk */
+INLINE void scanRange(radix_t *r, bool wide, kind_t kind) {
+    int id = omp_get_thread_num(), team = omp_get_num_threads();
+    long lo = r->n * id / team, hi = r->n * (id + 1) / team;
+    uint64_t min = ~0ULL, max = 0;
+    for (long i = lo; i < hi; i++) {
+        uint64_t k = order(load(r->a, i, wide), wide, kind);
+        min = k < min ? k : min;
+        max = k > max ? k : max;
+    }
+    #pragma omp critical(radixRange)
+    {
+        r->min = min < r->min ? min : r->min;
+        r->max = max > r->max ? max : r->max;
+    }
+    #pragma omp barrier
+}
+
+/* sizes the passes and allocates the arrays of a team, false if the keys
+   are sorted already or memory ran out */
+static bool prepare(radix_t *r, size_t keyBytes, int team) {
+    if (r->max == r->min)
+        return false;
+    r->bits = 64 - __builtin_clzll(r->max - r->min);
+    r->digit = digitBits();
+    /* streaming only pays when the array would not stay in the cache anyway */
+    long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    r->stream = (long)(r->n * keyBytes) > (l2 > 0 ? l2 : 1L << 20);
+    long buckets = 1L << r->digit;
+    r->stride = (LINE + 2 * sizeof(long)) * buckets;
+    r->tmp = malloc(r->n * keyBytes);
+    r->counts = malloc(team * buckets * sizeof(long));
+    r->scratch = aligned_alloc(LINE, team * r->stride);
+    r->failed = r->tmp == NULL || r->counts == NULL || r->scratch == NULL;
+    return !r->failed;
+}
+
+/* the whole sort, run by every thread of the team */
+INLINE void teamSort(radix_t *r, bool wide, kind_t kind) {
+    size_t keyBytes = wide ? 8 : 4;
+    int team = omp_get_num_threads();
+    if (!r->known)
+        scanRange(r, wide, kind);
+    #pragma omp single
+    r->ready = prepare(r, keyBytes, team);
+    if (!r->ready)
+        return;
+
+    int passes = passesFor(r->bits, r->digit);
+    if (passes < MSD_MIN_PASSES) {
+        int width = (r->bits + passes - 1) / passes;
+        void *src = r->a, *dst = r->tmp;
+        for (int shift = 0; shift < r->bits; shift += width) {
+            int w = r->bits - shift < width ? r->bits - shift : width;
+            parallelPass(r, src, dst, shift, w, wide, kind);
+            if (!r->skip) {
+                void *t = src;
+                src = dst;
+                dst = t;
+            }
+        }
+        if (src != r->a) {
+            int id = omp_get_thread_num();
+            long lo = r->n * id / team, hi = r->n * (id + 1) / team;
+            memcpy((char *)r->a + lo * keyBytes, (char *)src + lo * keyBytes, (hi - lo) * keyBytes);
+        }
+        return;
+    }
+    /* min and max differ in the top digit, so this pass is never skipped */
+    int low = r->bits - r->digit;
+    parallelPass(r, r->a, r->tmp, low, r->digit, wide, kind);
+    char *scratch = r->scratch + omp_get_thread_num() * r->stride;
+    const long *end = r->counts + ((long)(team - 1) << r->digit);
+    #pragma omp for schedule(dynamic, 1)
+    for (long d = 0; d < 1L << r->digit; d++)
+        sortBucket(r, d == 0 ? 0 : end[d - 1], end[d], low, scratch, wide, kind);
+}
+
+static int radixSort(radix_t *r) {
+    int threads = r->threads > 0 ? r->threads : omp_get_max_threads();
+    if (r->n < 2)
+        return 0;
+    if (!r->known) {
+        r->min = ~0ULL;
+        r->max = 0;
+    }
+    #pragma omp parallel num_threads(threads) if(threads > 1)
+    {
+        /* one instance per key width and kind, with the tests on them
+           resolved at compile time */
+        switch (r->wide * 3 + r->kind) {
+        case 0: teamSort(r, false, KEY_UNSIGNED); break;
+        case 1: teamSort(r, false, KEY_SIGNED); break;
+        case 2: teamSort(r, false, KEY_FLOAT); break;
+        case 3: teamSort(r, true, KEY_UNSIGNED); break;
+        case 4: teamSort(r, true, KEY_SIGNED); break;
+        default: teamSort(r, true, KEY_FLOAT); break;
+        }
+    }
+    free(r->tmp);
+    free(r->counts);
+    free(r->scratch);
+    return r->failed ? -1 : 0;
+}
+
+static int sortKeys(void *a, long n, int threads, bool wide, kind_t kind) {
+    radix_t r;
+    memset(&r, 0, sizeof(r));
+    r.a = a;
+    r.n = n;
+    r.threads = threads;
+    r.wide = wide;
+    r.kind = kind;
+    return radixSort(&r);
+}
+
+int rs_sort_u32(uint32_t *a, long n, int threads) {
+    return sortKeys(a, n, threads, false, KEY_UNSIGNED);
+}
+
+int rs_sort_i32(int32_t *a, long n, int threads) {
+    return sortKeys(a, n, threads, false, KEY_SIGNED);
+}
+
+int rs_sort_u64(uint64_t *a, long n, int threads) {
+    return sortKeys(a, n, threads, true, KEY_UNSIGNED);
+}
+
+int rs_sort_i64(int64_t *a, long n, int threads) {
+    return sortKeys(a, n, threads, true, KEY_SIGNED);
+}
+
+int rs_sort_f32(float *a, long n, int threads) {
+    return sortKeys(a, n, threads, false, KEY_FLOAT);
+}
+
+int rs_sort_f64(double *a, long n, int threads) {
+    return sortKeys(a, n, threads, true, KEY_FLOAT);
+}
+
+int rs_sort_i32_range(int32_t *a, long n, int threads, int32_t min, int32_t max) {
+    radix_t r;
+    memset(&r, 0, sizeof(r));
+    r.a = a;
+    r.n = n;
+    r.threads = threads;
+    r.kind = KEY_SIGNED;
+    r.known = true;
+    r.min = order((uint32_t)min, false, KEY_SIGNED);
+    r.max = order((uint32_t)max, false, KEY_SIGNED);
+    return radixSort(&r);
+}
+
+int rs_passes_i32(int32_t min, int32_t max) {
+    uint64_t span = (uint64_t)((int64_t)max - min);
+    if (span == 0)
+        return 0;
+    return passesFor(64 - __builtin_clzll(span), digitBits());
+}
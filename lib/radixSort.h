@@ -0,0 +1,56 @@
+/* parallel radix sort
+
+   Sorts 32- and 64-bit integer and floating point keys by their bits
+   instead of by comparisons, in O(n) per pass. Every key type is mapped to
+   an unsigned integer with the same order: signed ints flip their sign
+   bit, floats flip the sign bit of positive values and all bits of
+   negative ones (so -0.0 sorts before 0.0, negative NaNs first and
+   positive NaNs last). The mapping is applied each time a digit is read,
+   so the array only ever holds the original keys.
+
+   A parallel scan first finds the smallest and largest mapped key, and
+   digits are taken from key - min: keys in [0, 999) need 10 bits whatever
+   their type, two passes of 5 bits on most cpus. A digit has at most 8 to
+   11 bits, the most for which the write-combining buffers, a cache line
+   per bucket, fit in three quarters of the L1 data cache.
+
+   Keys that need at most MSD_MIN_PASSES - 1 digits are sorted LSD. In each
+   pass every thread counts the digits of its own chunk, one prefix sum over
+   all counters gives each thread its own output positions per bucket, and
+   the chunk is scattered. Arrays larger than the L2 cache go through the
+   write-combining buffers, each of which mirrors the line of the output its
+   next key goes to and is streamed out with non-temporal stores once full,
+   so the scatter never reads the lines it overwrites. Passes whose digit is
+   the same for every key are skipped. Wider keys are split by their top
+   digit first (MSD) and the buckets, now small enough for the cache, are
+   LSD sorted by a thread each.
+
+   Every sort needs a second array of n keys; when it cannot be allocated
+   the array is left unchanged and -1 is returned with errno set.
+   lib/parallelSort.c uses it for large int arrays, see ps_sort_with.
+
+   build:
+     gcc -O2 -fopenmp -c radixSort.c
+*/
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <stdint.h>
+
+/* each sorts a[0..n) ascending with a team of threads, 0 for the OpenMP
+   default and 1 for no team, and returns 0, or -1 if out of memory */
+int rs_sort_u32(uint32_t *a, long n, int threads);
+int rs_sort_i32(int32_t *a, long n, int threads);
+int rs_sort_u64(uint64_t *a, long n, int threads);
+int rs_sort_i64(int64_t *a, long n, int threads);
+int rs_sort_f32(float *a, long n, int threads);
+int rs_sort_f64(double *a, long n, int threads);
+
+/* rs_sort_i32 for keys already known to lie in [min, max] */
+int rs_sort_i32_range(int32_t *a, long n, int threads, int32_t min, int32_t max);
+
+/* passes rs_sort_i32_range makes over keys in [min, max], 0 if they are
+   all equal */
+int rs_passes_i32(int32_t min, int32_t max);
+
+#endif
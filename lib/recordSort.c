@@ -0,0 +1,482 @@
+/* parallel sorts of records, see recordSort.h */
+#include "recordSort.h"
+#include "radixSort.h"
+
+#include <omp.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#define CUTOFF 16           /* ranges up to this size are insertion sorted */
+#define NINTHER_MIN 128     /* from this size the pivot is a median of medians */
+#define TASK_CUTOFF 1000    /* smaller ranges are sorted without new tasks */
+#define MERGE_CUTOFF 8192   /* smaller merges are not split among tasks */
+
+/* one sort, shared by all its tasks */
+typedef struct {
+    size_t size;            /* bytes per element */
+    rec_compare_t compar;
+    bool indirect;          /* the elements are pointers to the records compared */
+} sorter_t;
+
+/* a record's key and where it came from */
+typedef struct {
+    int64_t key;
+    size_t index;
+} entry_t;
+
+#define AT(a, i) ((a) + (size_t)(i) * s->size)
+
+static inline int compare(const sorter_t *s, const char *x, const char *y) {
+    if (s->indirect)
+        return s->compar(*(const void *const *)x, *(const void *const *)y);
+    return s->compar(x, y);
+}
+
+static inline void swapBytes(char *x, char *y, size_t size) {
+    size_t k = 0;
+    for (; k + 8 <= size; k += 8) {
+        uint64_t t;
+        memcpy(&t, x + k, 8);
+        memcpy(x + k, y + k, 8);
+        memcpy(y + k, &t, 8);
+    }
+    for (; k < size; k++) {
+        char t = x[k];
+        x[k] = y[k];
+        y[k] = t;
+    }
+}
+
+static inline void sort2(char *a, size_t i, size_t j, const sorter_t *s) {
+    if (compare(s, AT(a, j), AT(a, i)) < 0)
+        swapBytes(AT(a, i), AT(a, j), s->size);
+}
+
+static inline void sort3(char *a, size_t i, size_t j, size_t k, const sorter_t *s) {
+    sort2(a, i, j, s);
+    sort2(a, j, k, s);
+    sort2(a, i, j, s);
+}
+
+static void insertionSort(char *a, size_t n, const sorter_t *s) {
+    for (size_t i = 1; i < n; i++)
+        for (size_t j = i; j > 0 && compare(s, AT(a, j), AT(a, j - 1)) < 0; j--)
+            swapBytes(AT(a, j), AT(a, j - 1), s->size);
+}
+
+static void siftDown(char *a, size_t n, size_t i, const sorter_t *s) {
+    while (2 * i + 1 < n) {
+        size_t child = 2 * i + 1;
+        if (child + 1 < n && compare(s, AT(a, child), AT(a, child + 1)) < 0)
+            child++;
+        if (compare(s, AT(a, child), AT(a, i)) <= 0)
+            return;
+        swapBytes(AT(a, i), AT(a, child), s->size);
+        i = child;
+    }
+}
+
+/* O(n log n) whatever the input, used once splits keep coming out bad */
+static void heapSort(char *a, size_t n, const sorter_t *s) {
+    for (size_t i = n / 2; i-- > 0;)
+        siftDown(a, n, i, s);
+    for (size_t end = n - 1; end > 0; end--) {
+        swapBytes(a, AT(a, end), s->size);
+        siftDown(a, end, 0, s);
+    }
+}
+
+/* median of 3, or the ninther of 9 spread samples, moved to a[0] */
+static void choosePivot(char *a, size_t n, const sorter_t *s) {
+    size_t mid = n / 2;
+    if (n >= NINTHER_MIN) {
+        sort3(a, 0, mid, n - 1, s);
+        sort3(a, 1, mid - 1, n - 2, s);
+        sort3(a, 2, mid + 1, n - 3, s);
+        sort3(a, mid - 1, mid, mid + 1, s);
+    } else {
+        sort3(a, 0, mid, n - 1, s);
+    }
+    swapBytes(a, AT(a, mid), s->size);
+}
+
+/* moves the samples of a range that split badly to its quarter points,
+   so a pattern cannot keep the pivots bad */
+static void breakPatterns(char *a, size_t n, const sorter_t *s) {
+    if (n <= CUTOFF)
+        return;
+    swapBytes(a, AT(a, n / 4), s->size);
+    swapBytes(AT(a, n / 2), AT(a, n / 2 + n / 4), s->size);
+    swapBytes(AT(a, n - 1), AT(a, n - n / 4), s->size);
+}
+
+/* Hoare split around the pivot in a[0]. both scans stop at keys equal to
+   the pivot, so many copies of a key split evenly instead of piling up
+   on one side. returns the final position of the pivot */
+static size_t partition(char *a, size_t n, const sorter_t *s) {
+    size_t i = 0, j = n;
+    while (true) {
+        do i++; while (i < n && compare(s, AT(a, i), a) < 0);
+        do j--; while (compare(s, AT(a, j), a) > 0);
+        if (i >= j)
+            break;
+        swapBytes(AT(a, i), AT(a, j), s->size);
+    }
+    swapBytes(a, AT(a, j), s->size);
+    return j;
+}
+
+/* quicksort of a[0..n). with parallel set the left side of every split
+   becomes a task */
+static void quickSort(char *a, size_t n, int badAllowed, bool parallel, const sorter_t *s) {
+    while (n > CUTOFF) {
+        choosePivot(a, n, s);
+        size_t p = partition(a, n, s);
+        size_t leftN = p, rightN = n - p - 1;
+        if (leftN < n / 8 || rightN < n / 8) {
+            if (--badAllowed == 0) {
+                heapSort(a, n, s);
+                n = 0;
+                break;
+            }
+            breakPatterns(a, leftN, s);
+            breakPatterns(AT(a, p + 1), rightN, s);
+        }
+        if (parallel) {
+            #pragma omp task firstprivate(a, leftN, badAllowed) if(leftN > TASK_CUTOFF)
+            quickSort(a, leftN, badAllowed, leftN > TASK_CUTOFF, s);
+            a = AT(a, p + 1);
+            n = rightN;
+            parallel = n > TASK_CUTOFF;
+        } else if (leftN < rightN) {
+            /* recurse on the smaller side for a log n stack */
+            quickSort(a, leftN, badAllowed, false, s);
+            a = AT(a, p + 1);
+            n = rightN;
+        } else {
+            quickSort(AT(a, p + 1), rightN, badAllowed, false, s);
+            n = leftN;
+        }
+    }
+    insertionSort(a, n, s);
+    #pragma omp taskwait
+}
+
+static int log2Floor(size_t n) {
+    int log = 0;
+    while (n >>= 1)
+        log++;
+    return log;
+}
+
+static void sortElements(char *a, size_t n, const sorter_t *s, int threads) {
+    if (n < 2)
+        return;
+    if (threads == 1) {
+        quickSort(a, n, log2Floor(n) + 1, false, s);
+        return;
+    }
+    #pragma omp parallel num_threads(threads)
+    {
+        #pragma omp single
+        quickSort(a, n, log2Floor(n) + 1, true, s);
+    }
+}
+
+/* puts record from[i] of base at position i, moving every record once:
+   to its place in a scratch copy, which is copied back, or without the
+   memory for one along the cycles of the permutation */
+static void permute(char *base, size_t n, size_t size, size_t *from, int threads) {
+    char *scratch = malloc(n * size);
+    if (scratch != NULL) {
+        #pragma omp parallel for num_threads(threads) if(threads > 1)
+        for (size_t i = 0; i < n; i++)
+            memcpy(scratch + i * size, base + from[i] * size, size);
+        #pragma omp parallel for num_threads(threads) if(threads > 1)
+        for (size_t i = 0; i < n; i++)
+            memcpy(base + i * size, scratch + i * size, size);
+        free(scratch);
+        return;
+    }
+    char held[REC_DIRECT_MAX];
+    for (size_t start = 0; start < n; start++) {
+        if (from[start] == start)
+            continue;
+        /* the record at start waits, chunk by chunk, while the cycle moves up */
+        for (size_t k = 0; k < size; k += sizeof(held)) {
+            size_t len = size - k < sizeof(held) ? size - k : sizeof(held);
+            memcpy(held, base + start * size + k, len);
+            size_t i = start;
+            while (from[i] != start) {
+                memcpy(base + i * size + k, base + from[i] * size + k, len);
+                i = from[i];
+            }
+            memcpy(base + i * size + k, held, len);
+        }
+        /* mark the cycle done */
+        size_t i = start;
+        while (from[i] != start) {
+            size_t next = from[i];
+            from[i] = i;
+            i = next;
+        }
+        from[i] = i;
+    }
+}
+
+int rec_sort(void *base, size_t nmemb, size_t size, rec_compare_t compar, int threads) {
+    if (threads <= 0)
+        threads = omp_get_max_threads();
+    sorter_t s = { size, compar, false };
+    if (size <= REC_DIRECT_MAX || nmemb < 2) {
+        sortElements(base, nmemb, &s, threads);
+        return 0;
+    }
+    /* large records: sort pointers, then move each record once */
+    char **ptrs = malloc(nmemb * sizeof(char *));
+    size_t *from = malloc(nmemb * sizeof(size_t));
+    if (ptrs == NULL || from == NULL) {
+        free(ptrs);
+        free(from);
+        sortElements(base, nmemb, &s, threads);
+        errno = ENOMEM;
+        return -1;
+    }
+    #pragma omp parallel for num_threads(threads) if(threads > 1)
+    for (size_t i = 0; i < nmemb; i++)
+        ptrs[i] = (char *)base + i * size;
+    sorter_t p = { sizeof(char *), compar, true };
+    sortElements((char *)ptrs, nmemb, &p, threads);
+    #pragma omp parallel for num_threads(threads) if(threads > 1)
+    for (size_t i = 0; i < nmemb; i++)
+        from[i] = (size_t)(ptrs[i] - (char *)base) / size;
+    free(ptrs);
+    permute(base, nmemb, size, from, threads);
+    free(from);
+    return 0;
+}
+
+void rec_qsort(void *base, size_t nmemb, size_t size, rec_compare_t compar) {
+    rec_sort(base, nmemb, size, compar, 0);
+}
+
+/* MERGE SORT */
+
+/* how many of the first k elements of the merge of x and y come from x.
+   elements of x win ties, which keeps the merge stable */
+static size_t coRank(size_t k, const char *x, size_t nx, const char *y, size_t ny, const sorter_t *s) {
+    size_t lo = k > ny ? k - ny : 0, hi = k < nx ? k : nx;
+    while (lo < hi) {
+        size_t i = lo + (hi - lo) / 2;
+        if (compare(s, AT(x, i), AT(y, k - i - 1)) <= 0)
+            lo = i + 1;
+        else
+            hi = i;
+    }
+    return lo;
+}
+
+static void mergeSeq(const char *x, size_t nx, const char *y, size_t ny, char *out, const sorter_t *s) {
+    size_t i = 0, j = 0;
+    while (i < nx && j < ny) {
+        if (compare(s, AT(y, j), AT(x, i)) < 0)
+            memcpy(out, AT(y, j++), s->size);
+        else
+            memcpy(out, AT(x, i++), s->size);
+        out += s->size;
+    }
+    memcpy(out, AT(x, i), (nx - i) * s->size);
+    memcpy(out + (nx - i) * s->size, AT(y, j), (ny - j) * s->size);
+}
+
+/* the output is halved at its middle, whose co-rank a binary search
+   finds, and the first half merged by a task */
+static void mergePar(const char *x, size_t nx, const char *y, size_t ny, char *out, const sorter_t *s) {
+    while (nx + ny > MERGE_CUTOFF) {
+        size_t k = (nx + ny) / 2;
+        size_t i = coRank(k, x, nx, y, ny, s);
+        #pragma omp task firstprivate(x, y, out, i, k)
+        mergePar(x, i, y, k - i, out, s);
+        x = AT(x, i);
+        nx -= i;
+        y = AT(y, k - i);
+        ny -= k - i;
+        out = AT(out, k);
+    }
+    mergeSeq(x, nx, y, ny, out, s);
+    #pragma omp taskwait
+}
+
+/* sorts a[0..n) into a, or into the scratch b[0..n) with toScratch set,
+   by sorting the halves into the other array and merging them back */
+static void mergeSort(char *a, char *b, size_t n, bool toScratch, bool parallel, const sorter_t *s) {
+    if (n <= CUTOFF) {
+        insertionSort(a, n, s);
+        if (toScratch)
+            memcpy(b, a, n * s->size);
+        return;
+    }
+    size_t h = n / 2;
+    #pragma omp task if(parallel && h > TASK_CUTOFF)
+    mergeSort(a, b, h, !toScratch, parallel && h > TASK_CUTOFF, s);
+    mergeSort(AT(a, h), AT(b, h), n - h, !toScratch, parallel && n - h > TASK_CUTOFF, s);
+    #pragma omp taskwait
+    const char *from = toScratch ? a : b;
+    char *to = toScratch ? b : a;
+    if (parallel)
+        mergePar(from, h, AT(from, h), n - h, to, s);
+    else
+        mergeSeq(from, h, AT(from, h), n - h, to, s);
+}
+
+static int stableSortElements(char *a, size_t n, const sorter_t *s, int threads) {
+    char *b = malloc(n * s->size);
+    if (b == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    if (threads == 1) {
+        mergeSort(a, b, n, false, false, s);
+    } else {
+        #pragma omp parallel num_threads(threads)
+        {
+            #pragma omp single
+            mergeSort(a, b, n, false, true, s);
+        }
+    }
+    free(b);
+    return 0;
+}
+
+int rec_stable_sort(void *base, size_t nmemb, size_t size, rec_compare_t compar, int threads) {
+    if (threads <= 0)
+        threads = omp_get_max_threads();
+    if (nmemb < 2)
+        return 0;
+    sorter_t s = { size, compar, false };
+    if (size <= REC_DIRECT_MAX)
+        return stableSortElements(base, nmemb, &s, threads);
+    /* large records: the pointers keep the order of equal records */
+    char **ptrs = malloc(nmemb * sizeof(char *));
+    size_t *from = malloc(nmemb * sizeof(size_t));
+    if (ptrs == NULL || from == NULL) {
+        free(ptrs);
+        free(from);
+        errno = ENOMEM;
+        return -1;
+    }
+    #pragma omp parallel for num_threads(threads) if(threads > 1)
+    for (size_t i = 0; i < nmemb; i++)
+        ptrs[i] = (char *)base + i * size;
+    sorter_t p = { sizeof(char *), compar, true };
+    if (stableSortElements((char *)ptrs, nmemb, &p, threads) < 0) {
+        free(ptrs);
+        free(from);
+        return -1;
+    }
+    #pragma omp parallel for num_threads(threads) if(threads > 1)
+    for (size_t i = 0; i < nmemb; i++)
+        from[i] = (size_t)(ptrs[i] - (char *)base) / size;
+    free(ptrs);
+    permute(base, nmemb, size, from, threads);
+    free(from);
+    return 0;
+}
+
+/* KEYS */
+
+static int compareEntry(const void *x, const void *y) {
+    const entry_t *a = x, *b = y;
+    if (a->key != b->key)
+        return a->key < b->key ? -1 : 1;
+    return (a->index > b->index) - (a->index < b->index);
+}
+
+static int bitsFor(uint64_t v) {
+    return v == 0 ? 0 : 64 - __builtin_clzll(v);
+}
+
+/* sorts the entries by key, equal keys by index. when key - min and the
+   index fit in one 64-bit word together the words are radix sorted */
+static void sortEntries(entry_t *e, size_t n, int threads) {
+    if (n < 2)
+        return;
+    int64_t min = e[0].key, max = e[0].key;
+    #pragma omp parallel for num_threads(threads) if(threads > 1) reduction(min:min) reduction(max:max)
+    for (size_t i = 1; i < n; i++) {
+        min = e[i].key < min ? e[i].key : min;
+        max = e[i].key > max ? e[i].key : max;
+    }
+    int indexBits = bitsFor(n - 1);
+    int keyBits = bitsFor((uint64_t)max - (uint64_t)min);
+    uint64_t *words = keyBits + indexBits <= 64 && indexBits < 64 ? malloc(n * sizeof(uint64_t)) : NULL;
+    if (words != NULL) {
+        #pragma omp parallel for num_threads(threads) if(threads > 1)
+        for (size_t i = 0; i < n; i++)
+            words[i] = ((uint64_t)e[i].key - (uint64_t)min) << indexBits | e[i].index;
+        if (rs_sort_u64(words, (long)n, threads) == 0) {
+            uint64_t mask = (1ULL << indexBits) - 1;
+            #pragma omp parallel for num_threads(threads) if(threads > 1)
+            for (size_t i = 0; i < n; i++) {
+                e[i].key = (int64_t)((uint64_t)min + (words[i] >> indexBits));
+                e[i].index = words[i] & mask;
+            }
+            free(words);
+            return;
+        }
+        free(words);
+    }
+    sorter_t s = { sizeof(entry_t), compareEntry, false };
+    sortElements((char *)e, n, &s, threads);
+}
+
+int rec_sort_by_key(void *base, size_t nmemb, size_t size, int64_t (*key)(const void *), int threads) {
+    if (threads <= 0)
+        threads = omp_get_max_threads();
+    entry_t *e = malloc(nmemb * sizeof(entry_t));
+    if (e == NULL && nmemb > 0) {
+        errno = ENOMEM;
+        return -1;
+    }
+    #pragma omp parallel for num_threads(threads) if(threads > 1)
+    for (size_t i = 0; i < nmemb; i++) {
+        e[i].key = key((char *)base + i * size);
+        e[i].index = i;
+    }
+    sortEntries(e, nmemb, threads);
+    /* the indices, in sorted order, are where each position takes its record
+       from. from[i] overwrites the key of e[i / 2] or the index of
+       e[(i - 1) / 2], both already read */
+    size_t *from = (size_t *)e;
+    for (size_t i = 0; i < nmemb; i++)
+        from[i] = e[i].index;
+    permute(base, nmemb, size, from, threads);
+    free(e);
+    return 0;
+}
+
+int rec_sort_pairs(int64_t *keys, const void *values, void *sortedValues, size_t valueSize, size_t n,
+                   int threads) {
+    if (threads <= 0)
+        threads = omp_get_max_threads();
+    entry_t *e = malloc(n * sizeof(entry_t));
+    if (e == NULL && n > 0) {
+        errno = ENOMEM;
+        return -1;
+    }
+    #pragma omp parallel for num_threads(threads) if(threads > 1)
+    for (size_t i = 0; i < n; i++) {
+        e[i].key = keys[i];
+        e[i].index = i;
+    }
+    sortEntries(e, n, threads);
+    #pragma omp parallel for num_threads(threads) if(threads > 1)
+    for (size_t i = 0; i < n; i++) {
+        keys[i] = e[i].key;
+        memcpy((char *)sortedValues + i * valueSize, (const char *)values + e[i].index * valueSize, valueSize);
+    }
+    free(e);
+    return 0;
+}
@@ -0,0 +1,72 @@
+/* parallel sorts of records
+
+   lib/parallelSort.h sorts bare ints; this sorts arrays of any fixed-size
+   element: structs, key-value pairs, pointers to strings.
+
+   rec_qsort() has the signature of qsort(3) and sorts with the OpenMP
+   default team, rec_sort() takes the team size. Both run a quicksort on
+   OpenMP tasks with ninther pivots, a split whose scans stop at keys equal
+   to the pivot (so duplicates divide evenly), insertion sorted leaves and
+   a heapsort fallback after log n bad splits. Records of up to REC_DIRECT_MAX bytes are moved in place;
+   larger ones are sorted as an array of pointers and then moved once, to
+   their final position in a scratch copy, and copied back (or, without
+   memory for the copy, along the cycles of the permutation).
+   rec_stable_sort() keeps equal records in their order with the merge
+   sort of lib/parallelSort.h, which needs a scratch copy of the elements.
+
+   rec_sort_by_key() calls a key extractor once per record instead of a
+   comparator O(log n) times. The (key, index) pairs are radix sorted
+   (lib/radixSort.h) when key - min and the index fit in 64 bits together,
+   and quicksorted otherwise; either way records with equal keys keep their
+   order. rec_sort_pairs() sorts keys in place and writes each payload once
+   straight to its sorted position in a second array.
+
+   recordSort.hpp has the same sorts as C++ templates, whose comparators
+   and key extractors are inlined instead of called through pointers.
+
+   build:
+     gcc -O2 -fopenmp -c recordSort.c radixSort.c
+*/
+#ifndef RECORD_SORT_H
+#define RECORD_SORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define REC_DIRECT_MAX 32   /* larger records are sorted through pointers */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int (*rec_compare_t)(const void *, const void *);
+
+/* qsort(3) with the OpenMP default number of threads */
+void rec_qsort(void *base, size_t nmemb, size_t size, rec_compare_t compar);
+/* the same with a team of threads, 0 for the OpenMP default and 1 for no
+   team. 0 on success, -1 with errno ENOMEM when records larger than
+   REC_DIRECT_MAX find no room for their pointers, in which case they are
+   sorted in place, more slowly */
+int rec_sort(void *base, size_t nmemb, size_t size, rec_compare_t compar, int threads);
+
+/* rec_sort, stable: a merge sort on tasks whose merges are split among
+   tasks by co-ranking, with a scratch copy of the elements. 0 on success,
+   -1 with errno ENOMEM and the records unchanged */
+int rec_stable_sort(void *base, size_t nmemb, size_t size, rec_compare_t compar, int threads);
+
+/* sorts the records by key(record) ascending, stable. 0 on success, -1
+   with errno ENOMEM and the records unchanged */
+int rec_sort_by_key(void *base, size_t nmemb, size_t size, int64_t (*key)(const void *), int threads);
+
+/* sorts keys[0..n) ascending, stable, and writes values[i] (valueSize
+   bytes each) to the position in sortedValues that keys[i] moved to.
+   values and sortedValues must not overlap. 0 on success, -1 with errno
+   ENOMEM and nothing changed */
+int rec_sort_pairs(int64_t *keys, const void *values, void *sortedValues, size_t valueSize, size_t n,
+                   int threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
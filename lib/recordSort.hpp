@@ -0,0 +1,323 @@
+// parallel sorts of records, C++ templates
+//
+// The sorts of recordSort.h with the comparator or key extractor a template
+// parameter, so the compiler inlines it into the loops instead of calling
+// through a pointer for every comparison. rec::sort() is the same task
+// parallel quicksort as rec_sort() and swaps whole elements with std::swap,
+// so it also sorts types that are not trivially copyable, and
+// rec::stable_sort() is rec_stable_sort()'s merge sort. rec::sort_by_key()
+// extracts every key once and hands them to rec_sort_pairs(), which radix
+// sorts the (key, index) pairs and writes each record straight to its
+// place in a scratch copy, so it is stable and copies each record twice.
+//
+// build:
+//   g++ -O2 -fopenmp -c yourProgram.cpp && gcc -O2 -fopenmp -c recordSort.c radixSort.c
+#ifndef RECORD_SORT_HPP
+#define RECORD_SORT_HPP
+
+#include "recordSort.h"
+
+#include <omp.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace rec {
+
+namespace detail {
+
+const size_t CUTOFF = 16;           // ranges up to this size are insertion sorted
+const size_t NINTHER_MIN = 128;     // from this size the pivot is a median of medians
+const size_t TASK_CUTOFF = 1000;    // smaller ranges are sorted without new tasks
+
+template <class T, class Less>
+inline void sort2(T *a, size_t i, size_t j, Less &less) {
+    if (less(a[j], a[i]))
+        std::swap(a[i], a[j]);
+}
+
+template <class T, class Less>
+inline void sort3(T *a, size_t i, size_t j, size_t k, Less &less) {
+    sort2(a, i, j, less);
+    sort2(a, j, k, less);
+    sort2(a, i, j, less);
+}
+
+template <class T, class Less>
+void insertionSort(T *a, size_t n, Less &less) {
+    for (size_t i = 1; i < n; i++) {
+        if (!less(a[i], a[i - 1]))
+            continue;
+        T v = std::move(a[i]);
+        size_t j = i;
+        do {
+            a[j] = std::move(a[j - 1]);
+            j--;
+        } while (j > 0 && less(v, a[j - 1]));
+        a[j] = std::move(v);
+    }
+}
+
+template <class T, class Less>
+void siftDown(T *a, size_t n, size_t i, Less &less) {
+    while (2 * i + 1 < n) {
+        size_t child = 2 * i + 1;
+        if (child + 1 < n && less(a[child], a[child + 1]))
+            child++;
+        if (!less(a[i], a[child]))
+            return;
+        std::swap(a[i], a[child]);
+        i = child;
+    }
+}
+
+template <class T, class Less>
+void heapSort(T *a, size_t n, Less &less) {
+    for (size_t i = n / 2; i-- > 0;)
+        siftDown(a, n, i, less);
+    for (size_t end = n - 1; end > 0; end--) {
+        std::swap(a[0], a[end]);
+        siftDown(a, end, 0, less);
+    }
+}
+
+// median of 3, or the ninther of 9 spread samples, moved to a[0]
+template <class T, class Less>
+void choosePivot(T *a, size_t n, Less &less) {
+    size_t mid = n / 2;
+    if (n >= NINTHER_MIN) {
+        sort3(a, 0, mid, n - 1, less);
+        sort3(a, 1, mid - 1, n - 2, less);
+        sort3(a, 2, mid + 1, n - 3, less);
+        sort3(a, mid - 1, mid, mid + 1, less);
+    } else {
+        sort3(a, 0, mid, n - 1, less);
+    }
+    std::swap(a[0], a[mid]);
+}
+
+template <class T>
+void breakPatterns(T *a, size_t n) {
+    if (n <= CUTOFF)
+        return;
+    std::swap(a[0], a[n / 4]);
+    std::swap(a[n / 2], a[n / 2 + n / 4]);
+    std::swap(a[n - 1], a[n - n / 4]);
+}
+
+// Hoare split around the pivot in a[0], both scans stopping at equal keys.
+// returns the final position of the pivot
+template <class T, class Less>
+size_t partition(T *a, size_t n, Less &less) {
+    size_t i = 0, j = n;
+    while (true) {
+        do i++; while (i < n && less(a[i], a[0]));
+        do j--; while (less(a[0], a[j]));
+        if (i >= j)
+            break;
+        std::swap(a[i], a[j]);
+    }
+    std::swap(a[0], a[j]);
+    return j;
+}
+
+template <class T, class Less>
+void quickSort(T *a, size_t n, int badAllowed, bool parallel, Less &less) {
+    while (n > CUTOFF) {
+        choosePivot(a, n, less);
+        size_t p = partition(a, n, less);
+        size_t leftN = p, rightN = n - p - 1;
+        if (leftN < n / 8 || rightN < n / 8) {
+            if (--badAllowed == 0) {
+                heapSort(a, n, less);
+                n = 0;
+                break;
+            }
+            breakPatterns(a, leftN);
+            breakPatterns(a + p + 1, rightN);
+        }
+        if (parallel) {
+            #pragma omp task firstprivate(a, leftN, badAllowed) if(leftN > TASK_CUTOFF)
+            quickSort(a, leftN, badAllowed, leftN > TASK_CUTOFF, less);
+            a += p + 1;
+            n = rightN;
+            parallel = n > TASK_CUTOFF;
+        } else if (leftN < rightN) {
+            quickSort(a, leftN, badAllowed, false, less);
+            a += p + 1;
+            n = rightN;
+        } else {
+            quickSort(a + p + 1, rightN, badAllowed, false, less);
+            n = leftN;
+        }
+    }
+    insertionSort(a, n, less);
+    #pragma omp taskwait
+}
+
+const size_t MERGE_CUTOFF = 8192;  // smaller merges are not split among tasks
+
+// how many of the first k elements of the merge of x and y come from x,
+// elements of x winning ties
+template <class T, class Less>
+size_t coRank(size_t k, const T *x, size_t nx, const T *y, size_t ny, Less &less) {
+    size_t lo = k > ny ? k - ny : 0, hi = k < nx ? k : nx;
+    while (lo < hi) {
+        size_t i = lo + (hi - lo) / 2;
+        if (!less(y[k - i - 1], x[i]))
+            lo = i + 1;
+        else
+            hi = i;
+    }
+    return lo;
+}
+
+template <class T, class Less>
+void mergeSeq(T *x, size_t nx, T *y, size_t ny, T *out, Less &less) {
+    size_t i = 0, j = 0;
+    while (i < nx && j < ny)
+        *out++ = less(y[j], x[i]) ? std::move(y[j++]) : std::move(x[i++]);
+    out = std::move(x + i, x + nx, out);
+    std::move(y + j, y + ny, out);
+}
+
+template <class T, class Less>
+void mergePar(T *x, size_t nx, T *y, size_t ny, T *out, Less &less) {
+    while (nx + ny > MERGE_CUTOFF) {
+        size_t k = (nx + ny) / 2;
+        size_t i = coRank(k, x, nx, y, ny, less);
+        #pragma omp task firstprivate(x, y, out, i, k)
+        mergePar(x, i, y, k - i, out, less);
+        x += i;
+        nx -= i;
+        y += k - i;
+        ny -= k - i;
+        out += k;
+    }
+    mergeSeq(x, nx, y, ny, out, less);
+    #pragma omp taskwait
+}
+
+// sorts a[0..n) into a, or into b[0..n) with toScratch set
+template <class T, class Less>
+void mergeSort(T *a, T *b, size_t n, bool toScratch, bool parallel, Less &less) {
+    if (n <= CUTOFF) {
+        insertionSort(a, n, less);
+        if (toScratch)
+            std::move(a, a + n, b);
+        return;
+    }
+    size_t h = n / 2;
+    #pragma omp task if(parallel && h > TASK_CUTOFF)
+    mergeSort(a, b, h, !toScratch, parallel && h > TASK_CUTOFF, less);
+    mergeSort(a + h, b + h, n - h, !toScratch, parallel && n - h > TASK_CUTOFF, less);
+    #pragma omp taskwait
+    T *from = toScratch ? a : b;
+    T *to = toScratch ? b : a;
+    if (parallel)
+        mergePar(from, h, from + h, n - h, to, less);
+    else
+        mergeSeq(from, h, from + h, n - h, to, less);
+}
+
+inline int log2Floor(size_t n) {
+    int log = 0;
+    while (n >>= 1)
+        log++;
+    return log;
+}
+
+}  // namespace detail
+
+// sorts a[0..n) so that less(a[i + 1], a[i]) is false everywhere, with a
+// team of threads, 0 for the OpenMP default and 1 for no team
+template <class T, class Less = std::less<T>>
+void sort(T *a, size_t n, Less less = Less(), int threads = 0) {
+    if (n < 2)
+        return;
+    if (threads <= 0)
+        threads = omp_get_max_threads();
+    if (threads == 1) {
+        detail::quickSort(a, n, detail::log2Floor(n) + 1, false, less);
+        return;
+    }
+    #pragma omp parallel num_threads(threads)
+    {
+        #pragma omp single
+        detail::quickSort(a, n, detail::log2Floor(n) + 1, true, less);
+    }
+}
+
+// sort, stable: a merge sort with a scratch copy of the array
+template <class T, class Less = std::less<T>>
+void stable_sort(T *a, size_t n, Less less = Less(), int threads = 0) {
+    if (n < 2)
+        return;
+    if (threads <= 0)
+        threads = omp_get_max_threads();
+    std::vector<T> scratch(a, a + n);
+    if (threads == 1) {
+        detail::mergeSort(a, scratch.data(), n, false, false, less);
+        return;
+    }
+    #pragma omp parallel num_threads(threads)
+    {
+        #pragma omp single
+        detail::mergeSort(a, scratch.data(), n, false, true, less);
+    }
+}
+
+// sorts a[0..n) by key(a[i]), any integer type up to 64 bits, stable.
+// 0 on success, -1 with errno ENOMEM and the records unchanged
+template <class T, class Key>
+int sort_by_key(T *a, size_t n, Key key, int threads = 0) {
+    static_assert(std::is_trivially_copyable<T>::value, "records are moved with memcpy");
+    typedef typename std::decay<decltype(key(*a))>::type K;
+    static_assert(std::is_integral<K>::value && sizeof(K) <= 8, "keys are integers of up to 64 bits");
+    // rec_sort_pairs orders signed keys, so unsigned 64-bit keys trade
+    // their top bit for the sign bit: 2^63 and up stay above the rest
+    const uint64_t flip = std::is_unsigned<K>::value && sizeof(K) == 8 ? 1ULL << 63 : 0;
+    if (n < 2)
+        return 0;
+    if (threads <= 0)
+        threads = omp_get_max_threads();
+    int64_t *keys = static_cast<int64_t *>(std::malloc(n * sizeof(int64_t)));
+    T *sorted = static_cast<T *>(std::malloc(n * sizeof(T)));
+    if (keys == nullptr || sorted == nullptr) {
+        std::free(keys);
+        std::free(sorted);
+        errno = ENOMEM;
+        return -1;
+    }
+    #pragma omp parallel for num_threads(threads) if(threads > 1)
+    for (size_t i = 0; i < n; i++)
+        keys[i] = static_cast<int64_t>(static_cast<uint64_t>(key(a[i])) ^ flip);
+    int status = rec_sort_pairs(keys, a, sorted, sizeof(T), n, threads);
+    if (status == 0) {
+        #pragma omp parallel for num_threads(threads) if(threads > 1)
+        for (size_t i = 0; i < n; i++)
+            a[i] = sorted[i];
+    }
+    std::free(keys);
+    std::free(sorted);
+    return status;
+}
+
+template <class T, class Less = std::less<T>>
+void sort(std::vector<T> &v, Less less = Less(), int threads = 0) {
+    sort(v.data(), v.size(), less, threads);
+}
+
+template <class T, class Less = std::less<T>>
+void stable_sort(std::vector<T> &v, Less less = Less(), int threads = 0) {
+    stable_sort(v.data(), v.size(), less, threads);
+}
+
+}  // namespace rec
+
+#endif
@@ -0,0 +1,156 @@
+/* test inputs for the sorts, see sortInput.h */
+#include "sortInput.h"
+
+#include <omp.h>
+#include <math.h>
+#include <limits.h>
+#include <string.h>
+
+static const char *distNames[] = { "uniform", "sorted", "reverse", "equal", "few", "organ", "zipf", "saw" };
+
+const char *si_dist_name(si_dist_t d) {
+    return distNames[d];
+}
+
+int si_parse_dist(const char *name) {
+    for (int i = 0; i < SI_DISTS; i++)
+        if (strcmp(name, distNames[i]) == 0)
+            return i;
+    return -1;
+}
+
+/* the splitmix64 finalizer, as in parallelSort.c */
+static inline uint64_t mix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+/* draw k of value i, uniform in [0, 1) */
+static inline double uniform(uint64_t seed, long i, int k) {
+    return (double)(mix64((seed ^ mix64((uint64_t)i)) + (uint64_t)k) >> 11) * 0x1.0p-53;
+}
+
+/* i of m ascending positions spread over the whole int range */
+static inline int spread(long i, long m) {
+    return (int)((int64_t)INT_MIN + (int64_t)(((unsigned __int128)i << 32) / (uint64_t)m));
+}
+
+/* ZIPF
+   rejection-inversion sampling of ranks 1..SI_ZIPF_VALUES: invert the
+   integral of the density 1 / x^e and accept the rank the draw falls on
+   with the ratio of its probability to the area under the hat. about one
+   draw per value whatever the exponent. the helpers keep log1p(x) / x and
+   expm1(x) / x exact near 0, where exponent 1 puts them */
+
+static double helper1(double x) {
+    return fabs(x) > 1e-8 ? log1p(x) / x : 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+}
+
+static double helper2(double x) {
+    return fabs(x) > 1e-8 ? expm1(x) / x : 1 + x * 0.5 * (1 + x / 3 * (1 + 0.25 * x));
+}
+
+static double hIntegral(double x) {
+    double logX = log(x);
+    return helper2((1 - SI_ZIPF_EXPONENT) * logX) * logX;
+}
+
+static double h(double x) {
+    return exp(-SI_ZIPF_EXPONENT * log(x));
+}
+
+static double hIntegralInverse(double x) {
+    double t = x * (1 - SI_ZIPF_EXPONENT);
+    if (t < -1)
+        t = -1;
+    return exp(helper1(t) * x);
+}
+
+/* the bounds of the hat and the ranks accepted without a test */
+typedef struct {
+    double first, last, squeeze;
+} zipf_t;
+
+static zipf_t zipfInit(void) {
+    zipf_t z;
+    z.first = hIntegral(1.5) - 1;
+    z.last = hIntegral(SI_ZIPF_VALUES + 0.5);
+    z.squeeze = 2 - hIntegralInverse(hIntegral(2.5) - h(2));
+    return z;
+}
+
+static int zipf(const zipf_t *z, uint64_t seed, long i) {
+    for (int k = 0;; k++) {
+        double u = z->last + uniform(seed, i, k) * (z->first - z->last);
+        double x = hIntegralInverse(u);
+        long rank = (long)(x + 0.5);
+        if (rank < 1)
+            rank = 1;
+        else if (rank > SI_ZIPF_VALUES)
+            rank = SI_ZIPF_VALUES;
+        if (rank - x <= z->squeeze || u >= hIntegral(rank + 0.5) - h(rank))
+            return (int)rank;
+    }
+}
+
+void si_fill(int *a, long n, si_dist_t d, uint64_t seed, int threads) {
+    if (threads <= 0)
+        threads = omp_get_max_threads();
+    seed = mix64(seed);
+    int equal = (int)mix64(seed);
+    zipf_t z = zipfInit();
+    long tooth = (n + SI_SAW_TEETH - 1) / SI_SAW_TEETH;
+    if (tooth < 1)
+        tooth = 1;
+    #pragma omp parallel for schedule(static) num_threads(threads)
+    for (long i = 0; i < n; i++) {
+        switch (d) {
+        case SI_UNIFORM:
+            a[i] = (int)mix64(seed ^ (uint64_t)i);
+            break;
+        case SI_SORTED:
+            a[i] = spread(i, n);
+            break;
+        case SI_REVERSE:
+            a[i] = spread(n - 1 - i, n);
+            break;
+        case SI_EQUAL:
+            a[i] = equal;
+            break;
+        case SI_FEW:
+            a[i] = (int)mix64(seed + mix64((uint64_t)i) % SI_FEW_VALUES);
+            break;
+        case SI_ORGAN:
+            a[i] = i < n / 2 ? spread(i, n / 2) : spread(n - 1 - i, n - n / 2);
+            break;
+        case SI_ZIPF:
+            a[i] = zipf(&z, seed, i);
+            break;
+        case SI_SAW:
+            a[i] = spread(i % tooth, tooth);
+            break;
+        }
+    }
+}
+
+uint64_t si_checksum(const int *a, long n, int threads) {
+    if (threads <= 0)
+        threads = omp_get_max_threads();
+    uint64_t sum = 0;
+    #pragma omp parallel for reduction(+:sum) schedule(static) num_threads(threads)
+    for (long i = 0; i < n; i++)
+        sum += mix64((uint32_t)a[i]);
+    return sum;
+}
+
+bool si_sorted(const int *a, long n, int threads) {
+    if (threads <= 0)
+        threads = omp_get_max_threads();
+    long bad = 0;
+    #pragma omp parallel for reduction(+:bad) schedule(static) num_threads(threads)
+    for (long i = 1; i < n; i++)
+        bad += a[i - 1] > a[i];
+    return bad == 0;
+}
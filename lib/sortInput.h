@@ -0,0 +1,58 @@
+/* test inputs for the sorts
+
+   Fills int arrays with the key distributions that decide how the sorts
+   of lib/parallelSort.h behave, and checks their output:
+
+     uniform   independent values over the whole int range
+     sorted    ascending, spread over the int range
+     reverse   descending
+     equal     one value n times
+     few       SI_FEW_VALUES distinct random values
+     organ     organ pipe: ascending to the middle, then descending
+     zipf      ranks 1..SI_ZIPF_VALUES with probability proportional to
+               1 / rank^SI_ZIPF_EXPONENT, so a few keys make up most of
+               the input, as with the ids of real traffic
+     saw       SI_SAW_TEETH ascending runs one after the other
+
+   Value i of an input is a function of the seed and of i alone (a
+   splitmix64 counter; zipf draws by rejection-inversion, Hormann and
+   Derflinger 1996), so the threads fill it in parallel, each first
+   touching its own part, and the same seed gives the same input whatever
+   the number of threads.
+
+   si_checksum() sums a 64-bit hash of every value, which does not depend
+   on the order: a sort that lost, duplicated or changed a value almost
+   surely changes it, while any permutation keeps it. With si_sorted() it
+   verifies a sort in two parallel passes without a copy of the input.
+
+   build:
+     gcc -O2 -fopenmp -c sortInput.c -lm
+*/
+#ifndef SORT_INPUT_H
+#define SORT_INPUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SI_FEW_VALUES 16
+#define SI_ZIPF_VALUES (1 << 20)
+#define SI_ZIPF_EXPONENT 1.0
+#define SI_SAW_TEETH 100
+
+typedef enum { SI_UNIFORM, SI_SORTED, SI_REVERSE, SI_EQUAL, SI_FEW, SI_ORGAN, SI_ZIPF, SI_SAW } si_dist_t;
+
+#define SI_DISTS 8
+
+const char *si_dist_name(si_dist_t d);
+/* -1 if the name is unknown */
+int si_parse_dist(const char *name);
+
+/* fills a[0..n) with distribution d with a team of threads, 0 for the
+   OpenMP default */
+void si_fill(int *a, long n, si_dist_t d, uint64_t seed, int threads);
+/* the order-independent hash of the values of a[0..n) */
+uint64_t si_checksum(const int *a, long n, int threads);
+/* whether a[0..n) ascends */
+bool si_sorted(const int *a, long n, int threads);
+
+#endif
@@ -0,0 +1,227 @@
+/* summed-area table with block min/max summaries, see summedArea.h */
+#include "summedArea.h"
+
+#include <omp.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+
+#define DEFAULT_BLOCK 64
+#define TILE_COLS 256   /* column band of the vertical pass, 2KB of sums per row */
+
+#define SAT(t, i, j) ((t)->sat[(size_t)(i) * ((t)->v.cols + 1) + (j)])
+
+/* cell (bi, bj) of sparse table level (a, b) */
+static size_t cellIndex(const sa_table_t *t, int a, int b, int bi, int bj) {
+    return (((size_t)a * t->levCols + b) * t->brows + bi) * t->bcols + bj;
+}
+
+static int log2floor(int n) {
+    int k = 0;
+    while ((2 << k) <= n)
+        k++;
+    return k;
+}
+
+/* ties keep the first position in row-major order, as in mr_reduce() */
+static bool before(const sa_cell_t *a, const sa_cell_t *b) {
+    return a->row < b->row || (a->row == b->row && a->col < b->col);
+}
+static void keepMin(sa_cell_t *into, const sa_cell_t *c) {
+    if (c->val < into->val || (c->val == into->val && before(c, into)))
+        *into = *c;
+}
+static void keepMax(sa_cell_t *into, const sa_cell_t *c) {
+    if (c->val > into->val || (c->val == into->val && before(c, into)))
+        *into = *c;
+}
+
+/* scan a rectangle directly, rows in order so strict comparisons keep the
+   first occurrence */
+static void scanRect(const mr_view_t *v, int row, int col, int rows, int cols, sa_cell_t *mn, sa_cell_t *mx) {
+    for (int i = row; i < row + rows; i++) {
+        const int *r = v->data + (size_t)i * v->stride;
+        for (int j = col; j < col + cols; j++) {
+            int val = r[j];
+            if (val < mn->val || (val == mn->val && (i < mn->row || (i == mn->row && j < mn->col)))) {
+                mn->val = val; mn->row = i; mn->col = j;
+            }
+            if (val > mx->val || (val == mx->val && (i < mx->row || (i == mx->row && j < mx->col)))) {
+                mx->val = val; mx->row = i; mx->col = j;
+            }
+        }
+    }
+}
+
+int sa_build(sa_table_t *t, mr_view_t v, int blockSize, int threads) {
+    if (v.data == NULL || v.rows < 1 || v.cols < 1 || v.stride < (size_t)v.cols) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (threads < 1) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    memset(t, 0, sizeof(*t));
+    t->v = v;
+    t->blockSize = blockSize > 0 ? blockSize : DEFAULT_BLOCK;
+    t->brows = (v.rows + t->blockSize - 1) / t->blockSize;
+    t->bcols = (v.cols + t->blockSize - 1) / t->blockSize;
+    t->levRows = log2floor(t->brows) + 1;
+    t->levCols = log2floor(t->bcols) + 1;
+
+    size_t cells = (size_t)t->levRows * t->levCols * t->brows * t->bcols;
+    t->sat = malloc((size_t)(v.rows + 1) * (v.cols + 1) * sizeof(long long));
+    t->mins = malloc(cells * sizeof(sa_cell_t));
+    t->maxs = malloc(cells * sizeof(sa_cell_t));
+    if (t->sat == NULL || t->mins == NULL || t->maxs == NULL) {
+        sa_free(t);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    int cols = v.cols;
+    #pragma omp parallel num_threads(threads)
+    {
+        /* row pass: each row becomes its own prefix sum */
+        #pragma omp for schedule(static)
+        for (int i = 0; i <= v.rows; i++) {
+            long long *out = &SAT(t, i, 0);
+            out[0] = 0;
+            if (i == 0) {
+                memset(out, 0, (cols + 1) * sizeof(long long));
+                continue;
+            }
+            const int *in = v.data + (size_t)(i - 1) * v.stride;
+            long long run = 0;
+            for (int j = 0; j < cols; j++) {
+                run += in[j];
+                out[j + 1] = run;
+            }
+        }
+        /* column pass: each thread walks down a band of TILE_COLS columns so
+           the previous row of the band stays in cache */
+        #pragma omp for schedule(dynamic, 1)
+        for (int band = 1; band <= cols; band += TILE_COLS) {
+            int end = band + TILE_COLS <= cols + 1 ? band + TILE_COLS : cols + 1;
+            for (int i = 1; i <= v.rows; i++) {
+                long long *cur = &SAT(t, i, 0), *prev = &SAT(t, i - 1, 0);
+                for (int j = band; j < end; j++)
+                    cur[j] += prev[j];
+            }
+        }
+
+        /* level (0,0): min and max of every block */
+        #pragma omp for collapse(2) schedule(static)
+        for (int bi = 0; bi < t->brows; bi++) {
+            for (int bj = 0; bj < t->bcols; bj++) {
+                int row = bi * t->blockSize, col = bj * t->blockSize;
+                int rows = row + t->blockSize <= v.rows ? t->blockSize : v.rows - row;
+                int cs = col + t->blockSize <= cols ? t->blockSize : cols - col;
+                sa_cell_t mn = { INT_MAX, INT_MAX, INT_MAX }, mx = { INT_MIN, INT_MAX, INT_MAX };
+                scanRect(&t->v, row, col, rows, cs, &mn, &mx);
+                t->mins[cellIndex(t, 0, 0, bi, bj)] = mn;
+                t->maxs[cellIndex(t, 0, 0, bi, bj)] = mx;
+            }
+        }
+
+        /* level (0,b) from (0,b-1), then (a,b) from (a-1,b). the implicit
+           barrier of each loop orders the levels */
+        for (int b = 1; b < t->levCols; b++) {
+            int half = 1 << (b - 1);
+            #pragma omp for schedule(static)
+            for (int bi = 0; bi < t->brows; bi++) {
+                for (int bj = 0; bj + 2 * half <= t->bcols; bj++) {
+                    sa_cell_t mn = t->mins[cellIndex(t, 0, b - 1, bi, bj)];
+                    sa_cell_t mx = t->maxs[cellIndex(t, 0, b - 1, bi, bj)];
+                    keepMin(&mn, &t->mins[cellIndex(t, 0, b - 1, bi, bj + half)]);
+                    keepMax(&mx, &t->maxs[cellIndex(t, 0, b - 1, bi, bj + half)]);
+                    t->mins[cellIndex(t, 0, b, bi, bj)] = mn;
+                    t->maxs[cellIndex(t, 0, b, bi, bj)] = mx;
+                }
+            }
+        }
+        for (int a = 1; a < t->levRows; a++) {
+            int half = 1 << (a - 1);
+            #pragma omp for collapse(2) schedule(static)
+            for (int b = 0; b < t->levCols; b++) {
+                for (int bi = 0; bi < t->brows; bi++) {
+                    if (bi + 2 * half > t->brows)
+                        continue;
+                    for (int bj = 0; bj + (1 << b) <= t->bcols; bj++) {
+                        sa_cell_t mn = t->mins[cellIndex(t, a - 1, b, bi, bj)];
+                        sa_cell_t mx = t->maxs[cellIndex(t, a - 1, b, bi, bj)];
+                        keepMin(&mn, &t->mins[cellIndex(t, a - 1, b, bi + half, bj)]);
+                        keepMax(&mx, &t->maxs[cellIndex(t, a - 1, b, bi + half, bj)]);
+                        t->mins[cellIndex(t, a, b, bi, bj)] = mn;
+                        t->maxs[cellIndex(t, a, b, bi, bj)] = mx;
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+void sa_free(sa_table_t *t) {
+    free(t->sat);
+    free(t->mins);
+    free(t->maxs);
+    t->sat = NULL;
+    t->mins = t->maxs = NULL;
+}
+
+long long sa_sum(const sa_table_t *t, int row, int col, int rows, int cols) {
+    int r1 = row + rows, c1 = col + cols;
+    return SAT(t, r1, c1) - SAT(t, row, c1) - SAT(t, r1, col) + SAT(t, row, col);
+}
+
+/* min and max of the whole blocks [a0,a1) x [b0,b1) from four overlapping
+   power-of-two ranges */
+static void blockRange(const sa_table_t *t, int a0, int a1, int b0, int b1, sa_cell_t *mn, sa_cell_t *mx) {
+    int ka = log2floor(a1 - a0), kb = log2floor(b1 - b0);
+    int ai[2] = { a0, a1 - (1 << ka) }, bj[2] = { b0, b1 - (1 << kb) };
+    for (int x = 0; x < 2; x++) {
+        for (int y = 0; y < 2; y++) {
+            keepMin(mn, &t->mins[cellIndex(t, ka, kb, ai[x], bj[y])]);
+            keepMax(mx, &t->maxs[cellIndex(t, ka, kb, ai[x], bj[y])]);
+        }
+    }
+}
+
+int sa_query(const sa_table_t *t, int row, int col, int rows, int cols, unsigned ops, mr_result_t *res) {
+    if (rows < 1 || cols < 1 || row < 0 || col < 0 || row + rows > t->v.rows || col + cols > t->v.cols ||
+        (ops & MR_ALL) == 0 || (ops & ~MR_ALL) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    memset(res, 0, sizeof(*res));
+    if (ops & MR_SUM)
+        res->sum = sa_sum(t, row, col, rows, cols);
+    if ((ops & (MR_MIN | MR_MAX)) == 0)
+        return 0;
+
+    sa_cell_t mn = { INT_MAX, INT_MAX, INT_MAX }, mx = { INT_MIN, INT_MAX, INT_MAX };
+    int bs = t->blockSize;
+    int r1 = row + rows, c1 = col + cols;
+    int a0 = (row + bs - 1) / bs, a1 = r1 / bs;   /* whole block rows */
+    int b0 = (col + bs - 1) / bs, b1 = c1 / bs;   /* whole block cols */
+    if (a0 < a1 && b0 < b1) {
+        blockRange(t, a0, a1, b0, b1, &mn, &mx);
+        /* border strips: above, below, then left and right of the blocks */
+        scanRect(&t->v, row, col, a0 * bs - row, cols, &mn, &mx);
+        scanRect(&t->v, a1 * bs, col, r1 - a1 * bs, cols, &mn, &mx);
+        scanRect(&t->v, a0 * bs, col, (a1 - a0) * bs, b0 * bs - col, &mn, &mx);
+        scanRect(&t->v, a0 * bs, b1 * bs, (a1 - a0) * bs, c1 - b1 * bs, &mn, &mx);
+    } else {
+        scanRect(&t->v, row, col, rows, cols, &mn, &mx);
+    }
+    if (ops & MR_MIN) {
+        res->min = mn.val; res->minRow = mn.row; res->minCol = mn.col;
+    }
+    if (ops & MR_MAX) {
+        res->max = mx.val; res->maxRow = mx.row; res->maxCol = mx.col;
+    }
+    return 0;
+}
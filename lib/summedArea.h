@@ -0,0 +1,45 @@
+/* summed-area table with block min/max summaries
+
+   After one parallel build over a matrix view, the sum of any rectangle is
+   four lookups in a 2D prefix-sum table. Min and max come from a 2D sparse
+   table over blockSize x blockSize block summaries for the whole blocks
+   inside the rectangle, plus a direct scan of the partial blocks on its
+   border. The table keeps a pointer to the view, so the data must outlive
+   it and must not change after sa_build().
+
+   build:
+     gcc -O2 -fopenmp -c summedArea.c matrixReduce.c topology.c
+*/
+#ifndef SUMMED_AREA_H
+#define SUMMED_AREA_H
+
+#include "matrixReduce.h"
+
+/* value and first position of a block range minimum or maximum */
+typedef struct {
+    int val, row, col;
+} sa_cell_t;
+
+typedef struct {
+    mr_view_t v;
+    long long *sat;         /* (rows+1) x (cols+1), sat[i][j] = sum of [0,i) x [0,j) */
+    int blockSize;
+    int brows, bcols;       /* whole and partial blocks per dimension */
+    int levRows, levCols;   /* sparse table levels per dimension */
+    sa_cell_t *mins, *maxs; /* levRows x levCols levels of brows x bcols cells */
+} sa_table_t;
+
+/* builds the tables with threads OpenMP threads (0: one per cpu) and blocks
+   of blockSize (0: 64). returns 0, or -1 with errno set */
+int sa_build(sa_table_t *t, mr_view_t v, int blockSize, int threads);
+void sa_free(sa_table_t *t);
+
+/* sum of rows [row, row+rows) x cols [col, col+cols) */
+long long sa_sum(const sa_table_t *t, int row, int col, int rows, int cols);
+
+/* answers the operations in ops for a rectangle like mr_reduce() would for
+   the matching subview, positions are in view coordinates. returns 0, or
+   -1 with errno set to EINVAL when the rectangle is empty or out of range */
+int sa_query(const sa_table_t *t, int row, int col, int rows, int cols, unsigned ops, mr_result_t *res);
+
+#endif
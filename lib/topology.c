@@ -0,0 +1,259 @@
+/* cpu topology and thread placement, see topology.h */
+#ifndef _REENTRANT
+#define _REENTRANT
+#endif
+#include "topology.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+
+#define SYSCPU "/sys/devices/system/cpu"
+#define SYSNODE "/sys/devices/system/node"
+#define MAXNODES 1024
+
+static const char *policyNames[] = { "default", "none", "compact", "scatter", "core", "numa" };
+
+static topo_t topo;
+static int *scatterOrder;   /* indexes into topo.cpus, scatter order */
+static int *coreOrder;      /* first hardware thread of every core */
+static int *nodeIds;        /* distinct node numbers, ascending */
+static pthread_once_t topoOnce = PTHREAD_ONCE_INIT;
+
+/* reads a single int from a sysfs file, def if it can't */
+static int readInt(const char *path, int def) {
+    FILE *f = fopen(path, "r");
+    int x;
+    if (f == NULL)
+        return def;
+    if (fscanf(f, "%d", &x) != 1)
+        x = def;
+    fclose(f);
+    return x;
+}
+
+/* marks the cpus of a list like "0-3,8,10-11" read from path with node */
+static void readNodeList(const char *path, int node, int *nodeOf, int maxCpu) {
+    FILE *f = fopen(path, "r");
+    int lo, hi;
+    if (f == NULL)
+        return;
+    while (fscanf(f, "%d", &lo) == 1) {
+        hi = lo;
+        int c = fgetc(f);
+        if (c == '-') {
+            if (fscanf(f, "%d", &hi) != 1)
+                break;
+            c = fgetc(f);
+        }
+        for (int i = lo; i <= hi && i < maxCpu; i++)
+            if (i >= 0)
+                nodeOf[i] = node;
+        if (c != ',')
+            break;
+    }
+    fclose(f);
+}
+
+static int cmpCompact(const void *a, const void *b) {
+    const topo_cpu_t *x = a, *y = b;
+    if (x->package != y->package) return x->package - y->package;
+    if (x->core != y->core) return x->core - y->core;
+    return x->cpu - y->cpu;
+}
+
+/* sort keys of the scatter order, filled before sorting */
+static int *scatterKey;
+static int cmpScatter(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    if (scatterKey[x] != scatterKey[y])
+        return scatterKey[x] < scatterKey[y] ? -1 : 1;
+    return x - y;
+}
+
+static int cmpInt(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+static void readTopology(void) {
+    cpu_set_t allowed;
+    char path[256];
+    int maxCpu = CPU_SETSIZE;
+    int *nodeOf;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        CPU_ZERO(&allowed);
+        CPU_SET(0, &allowed);
+    }
+    /* every array up front: without memory the topology stays unknown,
+       with no cpus, and nothing is pinned */
+    int count = CPU_COUNT(&allowed);
+    topo.cpus = malloc(sizeof(topo_cpu_t) * count);
+    nodeOf = calloc(maxCpu, sizeof(int));
+    int *coreRank = malloc(sizeof(int) * count);
+    coreOrder = malloc(sizeof(int) * count);
+    scatterOrder = malloc(sizeof(int) * count);
+    scatterKey = malloc(sizeof(int) * count);
+    nodeIds = malloc(sizeof(int) * count);
+    if (topo.cpus == NULL || nodeOf == NULL || coreRank == NULL || coreOrder == NULL || scatterOrder == NULL ||
+        scatterKey == NULL || nodeIds == NULL) {
+        free(topo.cpus);
+        free(nodeOf);
+        free(coreRank);
+        free(coreOrder);
+        free(scatterOrder);
+        free(scatterKey);
+        free(nodeIds);
+        topo.cpus = NULL;
+        coreOrder = scatterOrder = scatterKey = nodeIds = NULL;
+        return;
+    }
+
+    for (int node = 0; node < MAXNODES; node++) {
+        snprintf(path, sizeof(path), SYSNODE "/node%d/cpulist", node);
+        readNodeList(path, node, nodeOf, maxCpu);
+    }
+
+    /* one entry per usable cpu; without sysfs every cpu is its own core */
+    for (int i = 0; i < maxCpu; i++) {
+        if (!CPU_ISSET(i, &allowed))
+            continue;
+        topo_cpu_t *c = &topo.cpus[topo.numCpus++];
+        c->cpu = i;
+        snprintf(path, sizeof(path), SYSCPU "/cpu%d/topology/physical_package_id", i);
+        c->package = readInt(path, 0);
+        snprintf(path, sizeof(path), SYSCPU "/cpu%d/topology/core_id", i);
+        c->core = readInt(path, i);
+        c->node = nodeOf[i];
+    }
+    free(nodeOf);
+    qsort(topo.cpus, topo.numCpus, sizeof(topo_cpu_t), cmpCompact);
+
+    /* hardware thread ranks, and rank of each core within its package */
+    int rank = -1;
+    topo.numCores = 0;
+    topo.numPackages = 0;
+    for (int i = 0; i < topo.numCpus; i++) {
+        topo_cpu_t *c = &topo.cpus[i];
+        int sameCore = i > 0 && c->package == c[-1].package && c->core == c[-1].core;
+        int samePackage = i > 0 && c->package == c[-1].package;
+        c->smt = sameCore ? c[-1].smt + 1 : 0;
+        if (!samePackage) {
+            topo.numPackages++;
+            rank = -1;
+        }
+        if (!sameCore) {
+            topo.numCores++;
+            rank++;
+        }
+        coreRank[i] = rank;
+    }
+
+    for (int i = 0, k = 0; i < topo.numCpus; i++)
+        if (topo.cpus[i].smt == 0)
+            coreOrder[k++] = i;
+
+    /* scatter: second hardware threads last, then alternate packages core by core */
+    int package = 0;
+    for (int i = 0; i < topo.numCpus; i++) {
+        if (i > 0 && topo.cpus[i].package != topo.cpus[i - 1].package)
+            package++;
+        scatterOrder[i] = i;
+        scatterKey[i] = (topo.cpus[i].smt * topo.numCpus + coreRank[i]) * topo.numPackages + package;
+    }
+    qsort(scatterOrder, topo.numCpus, sizeof(int), cmpScatter);
+    free(scatterKey);
+    free(coreRank);
+
+    /* distinct nodes */
+    for (int i = 0; i < topo.numCpus; i++)
+        nodeIds[i] = topo.cpus[i].node;
+    qsort(nodeIds, topo.numCpus, sizeof(int), cmpInt);
+    for (int i = 0; i < topo.numCpus; i++)
+        if (topo.numNodes == 0 || nodeIds[topo.numNodes - 1] != nodeIds[i])
+            nodeIds[topo.numNodes++] = nodeIds[i];
+}
+
+const topo_t *topo_get(void) {
+    pthread_once(&topoOnce, readTopology);
+    return &topo;
+}
+
+const char *topo_policy_name(topo_policy_t p) {
+    return policyNames[p];
+}
+
+int topo_parse_policy(const char *name) {
+    for (int i = 0; i < (int)(sizeof(policyNames) / sizeof(policyNames[0])); i++)
+        if (strcasecmp(name, policyNames[i]) == 0)
+            return i;
+    return -1;
+}
+
+topo_policy_t topo_resolve(topo_policy_t p) {
+    if (p == TOPO_DEFAULT) {
+        const char *env = getenv("AFFINITY");
+        int q = env == NULL ? -1 : topo_parse_policy(env);
+        p = q <= TOPO_DEFAULT ? TOPO_NONE : (topo_policy_t)q;
+    }
+    return p;
+}
+
+int topo_place(topo_policy_t p, int worker, cpu_set_t *set) {
+    const topo_t *t;
+
+    p = topo_resolve(p);
+    if (p == TOPO_NONE)
+        return 0;
+    t = topo_get();
+    if (t->numCpus == 0)
+        return 0;
+    if (worker < 0)
+        worker = -worker;
+    CPU_ZERO(set);
+    switch (p) {
+    case TOPO_COMPACT:
+        CPU_SET(t->cpus[worker % t->numCpus].cpu, set);
+        break;
+    case TOPO_SCATTER:
+        CPU_SET(t->cpus[scatterOrder[worker % t->numCpus]].cpu, set);
+        break;
+    case TOPO_CORE:
+        CPU_SET(t->cpus[coreOrder[worker % t->numCores]].cpu, set);
+        break;
+    case TOPO_NUMA: {
+        int node = nodeIds[worker % t->numNodes];
+        for (int i = 0; i < t->numCpus; i++)
+            if (t->cpus[i].node == node)
+                CPU_SET(t->cpus[i].cpu, set);
+        break;
+    }
+    default:
+        return 0;
+    }
+    return 1;
+}
+
+int topo_pin(topo_policy_t p, int worker, cpu_set_t *saved) {
+    cpu_set_t set;
+    int err;
+
+    if (!topo_place(p, worker, &set))
+        return 0;
+    if (saved != NULL && (err = pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), saved)) != 0) {
+        errno = err;
+        return -1;
+    }
+    if ((err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set)) != 0) {
+        errno = err;
+        return -1;
+    }
+    return 1;
+}
+
+void topo_restore(const cpu_set_t *saved) {
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), saved);
+}
@@ -0,0 +1,81 @@
+/* cpu topology and thread placement
+
+   Reads the packages, cores, hardware threads and NUMA nodes of the cpus
+   this process may run on from /sys/devices/system, and pins worker
+   threads by one of these policies:
+
+     compact   fill the hardware threads of a core, then the cores of a
+               package, then the next package
+     scatter   spread consecutive workers over packages first, then cores,
+               and use second hardware threads last
+     core      one worker per physical core, second hardware threads unused
+     numa      worker i may run on any cpu of NUMA node i mod nodes
+
+   Worker i is pinned to the i-th place of the policy, wrapping around when
+   there are more workers than places. TOPO_DEFAULT takes the policy from
+   the AFFINITY environment variable and means no pinning when it is unset,
+   so programs behave as before unless asked, e.g. AFFINITY=scatter ./a.out.
+   Workers that first touch their own strip of a matrix after being pinned
+   get its pages on their own NUMA node.
+
+   build:
+     gcc -O2 -c topology.c        (pthread programs)
+     topo_pin_omp_team() is inline and needs -fopenmp in the caller
+*/
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
+
+typedef enum { TOPO_DEFAULT, TOPO_NONE, TOPO_COMPACT, TOPO_SCATTER, TOPO_CORE, TOPO_NUMA } topo_policy_t;
+
+typedef struct {
+    int cpu;        /* logical cpu number */
+    int package;    /* physical package (socket) */
+    int core;       /* core id within the package */
+    int smt;        /* rank among the hardware threads of the core */
+    int node;       /* NUMA node, 0 without NUMA information */
+} topo_cpu_t;
+
+typedef struct {
+    int numCpus, numCores, numPackages, numNodes;
+    topo_cpu_t *cpus;   /* the usable cpus in compact order */
+} topo_t;
+
+/* topology of the cpus in this process's affinity mask, read once. with
+   no memory to read it numCpus is 0 and no policy pins anything */
+const topo_t *topo_get(void);
+
+const char *topo_policy_name(topo_policy_t p);
+/* -1 if the name is unknown */
+int topo_parse_policy(const char *name);
+/* TOPO_DEFAULT resolved through $AFFINITY */
+topo_policy_t topo_resolve(topo_policy_t p);
+
+/* cpus worker may run on under policy p, returns 0 when p means no pinning */
+int topo_place(topo_policy_t p, int worker, cpu_set_t *set);
+
+/* pins the calling thread as worker, saving its previous mask in saved
+   when saved is not NULL. returns 1 if pinned, 0 if the policy means no
+   pinning, -1 with errno set on failure */
+int topo_pin(topo_policy_t p, int worker, cpu_set_t *saved);
+/* puts back a mask saved by topo_pin() */
+void topo_restore(const cpu_set_t *saved);
+
+#ifdef _OPENMP
+#include <omp.h>
+/* pins every thread of an OpenMP team of numThreads by its thread number.
+   libgomp keeps its pool threads for later regions of the same or smaller
+   size, so calling this once at startup places them for the whole run */
+static inline void topo_pin_omp_team(topo_policy_t p, int numThreads) {
+    if (topo_resolve(p) == TOPO_NONE)
+        return;
+    #pragma omp parallel num_threads(numThreads)
+    topo_pin(p, omp_get_thread_num(), NULL);
+}
+#endif
+
+#endif
@@ -0,0 +1,473 @@
+/* work-stealing task pool, see workSteal.h */
+#ifndef _REENTRANT
+#define _REENTRANT
+#endif
+#include "workSteal.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+static const char *victimNames[] = { "random", "round", "near" };
+
+/* the counters of ws_stats_t, written by their worker and read by
+   ws_get_stats() from any thread */
+#define COUNT(counter) __atomic_add_fetch(&(counter), 1, __ATOMIC_RELAXED)
+
+/* a spawned task, and the free lists they are recycled through */
+typedef struct task {
+    ws_fn_t fn;
+    void *arg;
+    ws_join_t *join;
+    struct task *next;
+} task_t;
+
+/* the circular array of a deque, size a power of two */
+typedef struct ring {
+    long size;
+    struct ring *retired;   /* the smaller array this one replaced */
+    task_t *slot[];
+} ring_t;
+
+/* top is written by thieves and bottom by the owner only, so they get
+   cache lines of their own, and the struct is padded to whole lines so
+   the workers of the array keep them */
+typedef struct __attribute__((aligned(64))) {
+    long top;
+    char pad1[56];
+    long bottom;
+    ring_t *ring;
+    char pad2[48];
+    ws_pool_t *pool;
+    int id;
+    unsigned seed;          /* of the random victims */
+    int lastVictim;
+    ws_join_t *current;     /* join of the task running on this worker */
+    task_t *free;
+    long tasks, steals, failedSteals, sleeps;
+    pthread_t thread;
+} worker_t;
+
+_Static_assert(sizeof(worker_t) % 64 == 0, "workers must fill whole cache lines");
+
+struct ws_pool {
+    int threads;
+    ws_victim_t victim;
+    int spins;
+    topo_policy_t affinity;
+    worker_t *workers;
+    int started;            /* worker threads created */
+    int sleepers;
+    bool stop;
+    pthread_mutex_t lock;   /* guards sleeping and stopping */
+    pthread_cond_t wake;
+    pthread_mutex_t runLock; /* one run from outside the pool at a time */
+};
+
+/* the worker this thread is, NULL outside a pool */
+static __thread worker_t *self = NULL;
+
+const char *ws_victim_name(ws_victim_t v) {
+    return victimNames[v];
+}
+
+int ws_parse_victim(const char *name) {
+    for (int i = 0; i < 3; i++)
+        if (strcmp(name, victimNames[i]) == 0)
+            return i;
+    return -1;
+}
+
+/* DEQUE
+   Chase-Lev with the memory orders of Le, Pop, Cohen and Zappa Nardelli,
+   "Correct and efficient work-stealing for weak memory models" (PPoPP 13) */
+
+static ring_t *newRing(long size) {
+    ring_t *r = malloc(sizeof(ring_t) + size * sizeof(task_t *));
+    if (r != NULL) {
+        r->size = size;
+        r->retired = NULL;
+    }
+    return r;
+}
+
+/* doubles the ring of w, copying the tasks in [t, b). NULL without memory */
+static ring_t *grow(worker_t *w, ring_t *r, long t, long b) {
+    ring_t *bigger = newRing(2 * r->size);
+    if (bigger == NULL)
+        return NULL;
+    for (long i = t; i < b; i++)
+        bigger->slot[i & (bigger->size - 1)] = __atomic_load_n(&r->slot[i & (r->size - 1)], __ATOMIC_RELAXED);
+    bigger->retired = r;
+    __atomic_store_n(&w->ring, bigger, __ATOMIC_RELEASE);
+    return bigger;
+}
+
+/* returns false when the deque is full and cannot grow */
+static bool push(worker_t *w, task_t *task) {
+    long b = __atomic_load_n(&w->bottom, __ATOMIC_RELAXED);
+    long t = __atomic_load_n(&w->top, __ATOMIC_ACQUIRE);
+    ring_t *r = __atomic_load_n(&w->ring, __ATOMIC_RELAXED);
+    if (b - t > r->size - 1 && (r = grow(w, r, t, b)) == NULL)
+        return false;
+    __atomic_store_n(&r->slot[b & (r->size - 1)], task, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&w->bottom, b + 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+/* the newest task of the owner's deque, NULL if empty */
+static task_t *take(worker_t *w) {
+    long b = __atomic_load_n(&w->bottom, __ATOMIC_RELAXED) - 1;
+    ring_t *r = __atomic_load_n(&w->ring, __ATOMIC_RELAXED);
+    __atomic_store_n(&w->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    long t = __atomic_load_n(&w->top, __ATOMIC_RELAXED);
+    task_t *task = NULL;
+    if (t <= b) {
+        task = __atomic_load_n(&r->slot[b & (r->size - 1)], __ATOMIC_RELAXED);
+        if (t == b) {
+            /* the last task, which a thief may be taking too */
+            if (!__atomic_compare_exchange_n(&w->top, &t, t + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+                task = NULL;
+            __atomic_store_n(&w->bottom, b + 1, __ATOMIC_RELAXED);
+        }
+    } else {
+        __atomic_store_n(&w->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+    return task;
+}
+
+/* the oldest task of another worker's deque, NULL if it was empty or
+   another thread got it first */
+static task_t *steal(worker_t *victim) {
+    long t = __atomic_load_n(&victim->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    long b = __atomic_load_n(&victim->bottom, __ATOMIC_ACQUIRE);
+    if (t >= b)
+        return NULL;
+    ring_t *r = __atomic_load_n(&victim->ring, __ATOMIC_ACQUIRE);
+    task_t *task = __atomic_load_n(&r->slot[t & (r->size - 1)], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&victim->top, &t, t + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        return NULL;
+    return task;
+}
+
+static bool hasWork(const worker_t *w) {
+    return __atomic_load_n(&w->bottom, __ATOMIC_SEQ_CST) > __atomic_load_n(&w->top, __ATOMIC_SEQ_CST);
+}
+
+/* TASKS */
+
+static task_t *newTask(worker_t *w) {
+    task_t *task = w->free;
+    if (task != NULL) {
+        w->free = task->next;
+        return task;
+    }
+    return malloc(sizeof(task_t));
+}
+
+/* a task goes to the free list of the worker that ran it, which is the
+   one spawning next on a worker that is busy */
+static void freeTask(worker_t *w, task_t *task) {
+    task->next = w->free;
+    w->free = task;
+}
+
+static void call(worker_t *w, ws_fn_t fn, void *arg, ws_join_t *join) {
+    ws_join_t *saved = w->current;
+    w->current = join;
+    fn(arg);
+    w->current = saved;
+    COUNT(w->tasks);
+}
+
+/* drops one share of join. the thread that drops the last one runs the
+   continuation, which held a share of the parent join, and then drops
+   that, and so on up */
+static void release(worker_t *w, ws_join_t *join) {
+    while (join != NULL) {
+        /* once pending is 0 the join may be gone, so read it before */
+        ws_fn_t fn = join->fn;
+        void *arg = join->arg;
+        ws_join_t *parent = join->parent;
+        if (__atomic_sub_fetch(&join->pending, 1, __ATOMIC_ACQ_REL) != 0)
+            return;
+        if (fn != NULL)
+            call(w, fn, arg, parent);
+        join = parent;
+    }
+}
+
+static void execute(worker_t *w, task_t *task) {
+    ws_fn_t fn = task->fn;
+    void *arg = task->arg;
+    ws_join_t *join = task->join;
+    freeTask(w, task);
+    call(w, fn, arg, join);
+    release(w, join);
+}
+
+/* SCHEDULING */
+
+/* the i-th victim of a steal round of w */
+static worker_t *victim(worker_t *w, int i) {
+    ws_pool_t *pool = w->pool;
+    int n = pool->threads, v;
+    switch (pool->victim) {
+    case WS_VICTIM_ROUND:
+        v = (w->lastVictim + i) % n;
+        break;
+    case WS_VICTIM_NEAR:
+        /* w + 1, w - 1, w + 2, w - 2, ... */
+        v = w->id + (i % 2 == 0 ? i / 2 + 1 : -(i / 2 + 1));
+        v = ((v % n) + n) % n;
+        break;
+    default:
+        v = (int)(rand_r(&w->seed) % (unsigned)n);
+        break;
+    }
+    return &pool->workers[v];
+}
+
+/* the newest task of w, or the oldest of one of the others */
+static task_t *findTask(worker_t *w) {
+    task_t *task = take(w);
+    if (task != NULL)
+        return task;
+    for (int i = 0; i < w->pool->threads - 1; i++) {
+        worker_t *v = victim(w, i);
+        if (v == w)
+            continue;
+        if ((task = steal(v)) != NULL) {
+            COUNT(w->steals);
+            w->lastVictim = v->id;
+            return task;
+        }
+        COUNT(w->failedSteals);
+    }
+    return NULL;
+}
+
+static bool anyWork(const ws_pool_t *pool) {
+    for (int i = 0; i < pool->threads; i++)
+        if (hasWork(&pool->workers[i]))
+            return true;
+    return false;
+}
+
+/* sleeps until a push or the end of the pool. the sleeper counts itself
+   and then looks for work, the pusher publishes its task and then looks
+   for sleepers, with full fences between, so one of them sees the other */
+static void sleepUntilWork(worker_t *w) {
+    ws_pool_t *pool = w->pool;
+    pthread_mutex_lock(&pool->lock);
+    __atomic_add_fetch(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+    if (!pool->stop && !anyWork(pool)) {
+        COUNT(w->sleeps);
+        pthread_cond_wait(&pool->wake, &pool->lock);
+    }
+    __atomic_sub_fetch(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void wakeOne(ws_pool_t *pool) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&pool->sleepers, __ATOMIC_SEQ_CST) == 0)
+        return;
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void *workerMain(void *arg) {
+    worker_t *w = arg;
+    ws_pool_t *pool = w->pool;
+    self = w;
+    topo_pin(pool->affinity, w->id, NULL);
+    int idle = 0;
+    while (!__atomic_load_n(&pool->stop, __ATOMIC_ACQUIRE)) {
+        task_t *task = findTask(w);
+        if (task != NULL) {
+            execute(w, task);
+            idle = 0;
+        } else if (++idle < pool->spins) {
+            sched_yield();
+        } else {
+            sleepUntilWork(w);
+            idle = 0;
+        }
+    }
+    return NULL;
+}
+
+/* POOL */
+
+static int onlineCpus(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n < 1 ? 1 : (int)n;
+}
+
+static void freeWorkers(ws_pool_t *pool) {
+    for (int i = 0; i < pool->threads; i++) {
+        worker_t *w = &pool->workers[i];
+        for (ring_t *r = w->ring, *next; r != NULL; r = next) {
+            next = r->retired;
+            free(r);
+        }
+        for (task_t *t = w->free, *next; t != NULL; t = next) {
+            next = t->next;
+            free(t);
+        }
+    }
+    free(pool->workers);
+}
+
+ws_pool_t *ws_create(const ws_config_t *c) {
+    ws_config_t defaults = { 0, WS_VICTIM_RANDOM, 0, TOPO_DEFAULT };
+    if (c == NULL)
+        c = &defaults;
+    ws_pool_t *pool = calloc(1, sizeof(ws_pool_t));
+    if (pool == NULL)
+        return NULL;
+    pool->threads = c->threads > 0 ? c->threads : onlineCpus();
+    pool->victim = c->victim;
+    pool->spins = c->spins > 0 ? c->spins : WS_SPINS;
+    pool->affinity = c->affinity;
+    pool->workers = aligned_alloc(64, pool->threads * sizeof(worker_t));
+    if (pool->workers == NULL) {
+        free(pool);
+        return NULL;
+    }
+    memset(pool->workers, 0, pool->threads * sizeof(worker_t));
+    for (int i = 0; i < pool->threads; i++) {
+        worker_t *w = &pool->workers[i];
+        w->pool = pool;
+        w->id = i;
+        w->seed = 0x9E3779B9u * (unsigned)(i + 1);
+        w->lastVictim = (i + 1) % pool->threads;
+        if ((w->ring = newRing(WS_DEQUE_MIN)) == NULL) {
+            freeWorkers(pool);
+            free(pool);
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_mutex_init(&pool->runLock, NULL);
+    /* worker 0 is whoever calls ws_run */
+    pool->started = 1;
+    for (; pool->started < pool->threads; pool->started++) {
+        worker_t *w = &pool->workers[pool->started];
+        int err = pthread_create(&w->thread, NULL, workerMain, w);
+        if (err != 0) {
+            ws_destroy(pool);
+            errno = err;
+            return NULL;
+        }
+    }
+    return pool;
+}
+
+void ws_destroy(ws_pool_t *pool) {
+    if (pool == NULL)
+        return;
+    pthread_mutex_lock(&pool->lock);
+    __atomic_store_n(&pool->stop, true, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 1; i < pool->started; i++)
+        pthread_join(pool->workers[i].thread, NULL);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->runLock);
+    freeWorkers(pool);
+    free(pool);
+}
+
+int ws_threads(const ws_pool_t *pool) {
+    return pool->threads;
+}
+
+void ws_get_stats(const ws_pool_t *pool, ws_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (int i = 0; i < pool->threads; i++) {
+        const worker_t *w = &pool->workers[i];
+        stats->tasks += __atomic_load_n(&w->tasks, __ATOMIC_RELAXED);
+        stats->steals += __atomic_load_n(&w->steals, __ATOMIC_RELAXED);
+        stats->failedSteals += __atomic_load_n(&w->failedSteals, __ATOMIC_RELAXED);
+        stats->sleeps += __atomic_load_n(&w->sleeps, __ATOMIC_RELAXED);
+    }
+}
+
+int ws_worker(void) {
+    return self != NULL ? self->id : -1;
+}
+
+/* runs the root on w and works until it and its descendants are done */
+static void runRoot(worker_t *w, ws_fn_t fn, void *arg) {
+    ws_join_t root = { 1, NULL, NULL, NULL };
+    call(w, fn, arg, &root);
+    release(w, &root);
+    while (__atomic_load_n(&root.pending, __ATOMIC_ACQUIRE) != 0) {
+        task_t *task = findTask(w);
+        if (task != NULL)
+            execute(w, task);
+        else
+            sched_yield();
+    }
+}
+
+void ws_run(ws_pool_t *pool, ws_fn_t fn, void *arg) {
+    if (self != NULL && self->pool == pool) {
+        runRoot(self, fn, arg);
+        return;
+    }
+    pthread_mutex_lock(&pool->runLock);
+    worker_t *saved = self;
+    cpu_set_t mask;
+    bool pinned = topo_pin(pool->affinity, 0, &mask) == 1;
+    self = &pool->workers[0];
+    runRoot(self, fn, arg);
+    self = saved;
+    if (pinned)
+        topo_restore(&mask);
+    pthread_mutex_unlock(&pool->runLock);
+}
+
+void ws_join_init(ws_join_t *j, ws_fn_t fn, void *arg) {
+    j->pending = 1;     /* the creator's, until it closes the join */
+    j->fn = fn;
+    j->arg = arg;
+    j->parent = self->current;
+    __atomic_add_fetch(&j->parent->pending, 1, __ATOMIC_RELAXED);
+}
+
+void ws_spawn(ws_join_t *j, ws_fn_t fn, void *arg) {
+    worker_t *w = self;
+    if (j == NULL)
+        j = w->current;
+    __atomic_add_fetch(&j->pending, 1, __ATOMIC_RELAXED);
+    task_t *task = newTask(w);
+    if (task != NULL) {
+        task->fn = fn;
+        task->arg = arg;
+        task->join = j;
+        if (push(w, task)) {
+            wakeOne(w->pool);
+            return;
+        }
+        freeTask(w, task);
+    }
+    call(w, fn, arg, j);
+    release(w, j);
+}
+
+void ws_join_close(ws_join_t *j) {
+    release(self, j);
+}
@@ -0,0 +1,111 @@
+/* work-stealing task pool
+
+   A pthread runtime for recursive parallelism that does not depend on the
+   OpenMP task scheduler, so the stealing policy can be chosen and programs
+   run the same whatever OpenMP runtime they were built with.
+
+   Every worker owns a Chase-Lev deque: it pushes and pops tasks at the
+   bottom without locks, taking its newest task first while that is still
+   hot in its cache, and idle workers steal the oldest task from the top of
+   another's deque, usually the largest piece of a recursion, with one
+   compare-and-swap. The deque grows by doubling; the arrays it outgrows are
+   kept until the pool is destroyed because a thief may still read them.
+   A worker that finds nothing in a round over all victims yields, and
+   after ws_config_t.spins rounds sleeps until a task is pushed.
+
+   Victims are tried in the order of ws_victim_t: random, round robin from
+   the last victim that had work, or nearest worker number first, which
+   under a compact affinity policy (see topology.h) steals from the cores
+   that share a cache first.
+
+   Joins are continuations, not blocking waits. A task that wants to run
+   code after its children creates a ws_join_t holding that continuation,
+   spawns the children into it and closes it; whichever thread finishes
+   the last of them, or closes the join after they finished, runs the
+   continuation right there. No thread ever blocks in the middle of a task,
+   so there are no stacks of suspended frames and no waits that have to
+   help with unrelated work. Tasks spawned into no join count toward the
+   join of the task that spawned them, and a continuation counts toward
+   the join of the task that created it, so ws_run() returns once the
+   root task and everything that descends from it are done.
+
+   build:
+     gcc -O2 -c workSteal.c topology.c -lpthread
+*/
+#ifndef WORK_STEAL_H
+#define WORK_STEAL_H
+
+#include "topology.h"
+
+#define WS_DEQUE_MIN 256    /* tasks a deque holds before it first grows */
+#define WS_SPINS 64         /* default failed steal rounds before a worker sleeps */
+
+typedef enum { WS_VICTIM_RANDOM, WS_VICTIM_ROUND, WS_VICTIM_NEAR } ws_victim_t;
+
+typedef struct {
+    int threads;            /* workers with the caller of ws_run, 0 for one per online cpu */
+    ws_victim_t victim;
+    int spins;              /* 0 for WS_SPINS */
+    topo_policy_t affinity; /* TOPO_DEFAULT (0) takes $AFFINITY */
+} ws_config_t;
+
+/* what the workers did since the pool was created. idle workers keep
+   counting failed steals and sleeps between runs, until they fall asleep,
+   so the difference of two snapshots describes a run only when they are
+   taken right before and after it, and a snapshot taken during a run is
+   no more than a lower bound */
+typedef struct {
+    long tasks;             /* tasks and continuations run */
+    long steals;            /* tasks taken from another worker */
+    long failedSteals;      /* victims found empty or lost to another thief */
+    long sleeps;
+} ws_stats_t;
+
+typedef void (*ws_fn_t)(void *arg);
+
+typedef struct ws_pool ws_pool_t;
+
+/* children still running and, until it is closed, the creator. lives in
+   memory of the caller's choosing, at least until the continuation runs */
+typedef struct ws_join {
+    long pending;
+    ws_fn_t fn;                 /* the continuation, NULL for none */
+    void *arg;
+    struct ws_join *parent;     /* the join the continuation counts toward */
+} ws_join_t;
+
+const char *ws_victim_name(ws_victim_t v);
+/* -1 if the name is unknown */
+int ws_parse_victim(const char *name);
+
+/* starts threads - 1 workers, c NULL for the defaults. NULL with errno set
+   on failure */
+ws_pool_t *ws_create(const ws_config_t *c);
+/* stops the workers, which must have no run in progress */
+void ws_destroy(ws_pool_t *pool);
+int ws_threads(const ws_pool_t *pool);
+void ws_get_stats(const ws_pool_t *pool, ws_stats_t *stats);
+
+/* runs fn(arg) as the root task, the calling thread taking part as worker
+   0, and returns when it and all it spawned have finished. runs from
+   other threads wait for each other; a task of the pool may also call it,
+   and then works on other tasks until its own are done */
+void ws_run(ws_pool_t *pool, ws_fn_t fn, void *arg);
+
+/* the worker number of the calling thread in the pool running it, -1
+   outside any pool */
+int ws_worker(void);
+
+/* the functions below may only be called from tasks of a pool */
+
+/* prepares j to run fn(arg) once the tasks spawned into it have finished
+   and it has been closed */
+void ws_join_init(ws_join_t *j, ws_fn_t fn, void *arg);
+/* makes fn(arg) a task that j waits for, j NULL for the join of the
+   calling task. runs it at once when there is no memory for the task */
+void ws_spawn(ws_join_t *j, ws_fn_t fn, void *arg);
+/* ends the spawns into j. when its tasks are done already the
+   continuation runs before this returns */
+void ws_join_close(ws_join_t *j);
+
+#endif